@@ -16,14 +16,34 @@
 */
 /**************************************************************************/
 
+#include <signal.h>
 #include "childInterface.h"
 
+// Signal handlers: SIGUSR1 writes a checkpoint after the current storm;
+// SIGTERM and SIGINT write one and stop the run (see
+// childInterface::RequestCheckpoint)
+static void CheckpointHandler( int )
+{
+	childInterface::RequestCheckpoint( false );
+}
+
+static void StopHandler( int )
+{
+	childInterface::RequestCheckpoint( true );
+}
+
 int main( int argc, char **argv )
 {
 	childInterface myChildInterface;
 	
 	myChildInterface.Initialize( argc, argv );
 
+#ifdef SIGUSR1
+	signal( SIGUSR1, CheckpointHandler );
+#endif
+	signal( SIGTERM, StopHandler );
+	signal( SIGINT, StopHandler );
+
 	if(1) // make this zero to use "example 2" below
 	{
 		// Example 1: using "Run" method, and setting run duration to zero so model reads duration from input file
@@ -17,12 +17,19 @@
  */
 /**************************************************************************/
 
+#include <math.h>
+#include <signal.h>
 #include "childInterface.h"
+#include "../tThreadPool/tThreadPool.h"
 
 using namespace std;
 
 Predicates predicate;
 
+// checkpoint requests, set by RequestCheckpoint (from a signal handler)
+static volatile sig_atomic_t checkpointRequested = 0;
+static volatile sig_atomic_t stopRequested = 0;
+
 /**************************************************************************/
 /**
  **  Default constructor for childInterface
@@ -36,6 +43,12 @@ element_set_description( "Element set interface for CHILD's voronoi nodes" ),
 version(0)
 {
 	initialized = false;
+	optReorderMesh = false;
+	reorderMeshInterval = 0;
+	stormsSinceReorder = 0;
+	optCheckpoint = false;
+	checkpointInterval = 0.;
+	nextCheckpointTime = 0.;
 	
 	rand = NULL;
 	mesh  = NULL;
@@ -143,6 +156,14 @@ void childInterface::Initialize_Copy( const childInterface& orig )
   optChemicalWeathering = orig.optChemicalWeathering;
   optPhysicalWeathering = orig.optPhysicalWeathering;
   optStreamLineBoundary = orig.optStreamLineBoundary;
+  optReorderMesh = orig.optReorderMesh;
+  reorderMeshInterval = orig.reorderMeshInterval;
+  stormsSinceReorder = orig.stormsSinceReorder;
+  // the copy does not overwrite the checkpoints of the original
+  optCheckpoint = false;
+  checkpointInterval = orig.checkpointInterval;
+  nextCheckpointTime = orig.nextCheckpointTime;
+  checkpointFile = orig.checkpointFile;
   
   if( orig.rand )
     rand = new tRand( *orig.rand );
@@ -240,6 +261,11 @@ Initialize( std::string argument_string )
    **      Run timer
    **    Write output for initial state
    **    Get options for erosion type, meandering, etc.
+   **
+   **  A run restarted from a checkpoint (option --restart) creates the
+   **  objects in the same way, except for the mesh, which is rebuilt from
+   **  the checkpoint; the state of the objects is then restored from the
+   **  checkpoint (see tCheckpoint.h) instead of writing the initial output.
    \**********************************************************************/
   
   // Check command-line arguments
@@ -273,6 +299,39 @@ Initialize( std::string argument_string )
   optPhysicalWeathering = inputFile.ReadBool( "PRODUCTION_LAW", false );
   optTrackWaterSedTimeSeries = 
   inputFile.ReadBool( "OPT_TRACK_WATER_SED_TIMESERIES", false );
+  optReorderMesh = inputFile.ReadBool( "OPT_REORDER_MESH", false );
+  if( optReorderMesh )
+  {
+    reorderMeshInterval = inputFile.ReadInt( "REORDER_MESH_INTERVAL", false );
+    if( reorderMeshInterval < 0 )
+      ReportFatalError( "REORDER_MESH_INTERVAL must be zero or positive." );
+  }
+  optCheckpoint = inputFile.ReadBool( "OPT_CHECKPOINT", false );
+  if( optCheckpoint )
+  {
+    checkpointInterval = inputFile.ReadDouble( "CHECKPOINT_INTERVAL" );
+    if( checkpointInterval <= 0. )
+      ReportFatalError( "CHECKPOINT_INTERVAL must be positive." );
+  }
+  checkpointFile = inputFile.ReadString( "OUTFILENAME" ) + SCHECKPOINT;
+  
+  // Number of threads for the loops over the mesh (see tThreadPool.h)
+  tThreadPool::SetNumThreads( inputFile.ReadInt( "NUM_THREADS", false ) );
+  
+  // Open the checkpoint to restart from, if any; the output files are
+  // continued from their sizes at the checkpoint
+  tCheckpointReader *checkpoint = 0;
+  if( option.restartFile != 0 )
+  {
+    if( optStratGrid )
+      ReportFatalError( "Restarting from a checkpoint is not supported with "
+                        "OPTSTRATGRID." );
+    if( !option.silent_mode )
+      std::cout << "Restarting from checkpoint " << option.restartFile
+                << "...\n";
+    checkpoint = new tCheckpointReader( option.restartFile );
+    checkpoint->ResumeOutputFiles();
+  }
   
   
   // Create a random number generator for the simulation itself
@@ -283,10 +342,16 @@ Initialize( std::string argument_string )
   // Create (or read) model mesh
   if( !option.silent_mode )
     std::cout << "Creating mesh...\n";
-  mesh = new tMesh<tLNode>( inputFile, option.checkMeshConsistency );
+  if( checkpoint )
+    mesh = new tMesh<tLNode>( inputFile, *checkpoint,
+                              option.checkMeshConsistency );
+  else
+    mesh = new tMesh<tLNode>( inputFile, option.checkMeshConsistency );
   
-  // Initialize the lithology manager
-  lithology_manager_.InitializeFromInputFile( inputFile, mesh );
+  // Initialize the lithology manager (the layers of a restarted run are
+  // those of the checkpoint)
+  if( !checkpoint )
+    lithology_manager_.InitializeFromInputFile( inputFile, mesh );
   
   // Create and initialize output object
   if( !option.no_write_mode )
@@ -305,8 +370,9 @@ Initialize( std::string argument_string )
   strmNet = new tStreamNet( *mesh, *storm, inputFile );
   optStreamLineBoundary = inputFile.ReadBool( "OPTSTREAMLINEBNDY", false );
   // option to convert streamlines from specified points along streamlines
-  // into open boundary nodes; requires flow edges be set:
-  if( optStreamLineBoundary )
+  // into open boundary nodes; requires flow edges be set (the mesh of a
+  // restarted run has been converted already):
+  if( optStreamLineBoundary && !checkpoint )
   {
     tPtrList< tLNode > streamList;
     strmNet->FindStreamLines( inputFile, streamList );
@@ -397,11 +463,36 @@ Initialize( std::string argument_string )
     erosion->ActivateSedVolumeTracking( &water_sed_tracker_ );
   }
   
-  // Write output for time zero
-  if( !option.silent_mode )
-    std::cout << "Writing data for time zero...\n";
-  if( output )
-    output->WriteOutput( 0. );
+  if( checkpoint )
+  {
+    // Restore the state of the run; the mesh first, as the stream network
+    // refers to its nodes
+    mesh->ReadCheckpoint( *checkpoint );
+    rand->ReadCheckpoint( *checkpoint, "rand" );
+    storm->ReadCheckpoint( *checkpoint );
+    strmNet->ReadCheckpoint( *checkpoint );
+    erosion->ReadCheckpoint( *checkpoint );
+    if( uplift )
+      uplift->ReadCheckpoint( *checkpoint );
+    time->ReadCheckpoint( *checkpoint );
+    if( vegetation )
+      vegetation->ReadCheckpoint( *checkpoint );
+    if( output )
+      output->ReadCheckpoint( *checkpoint );
+    stormsSinceReorder = checkpoint->ReadInt( "reorder" );
+    delete checkpoint;
+  }
+  else
+  {
+    // Write output for time zero
+    if( !option.silent_mode )
+      std::cout << "Writing data for time zero...\n";
+    if( output )
+      output->WriteOutput( 0. );
+  }
+  if( optCheckpoint )
+    nextCheckpointTime = ( floor( time->getCurrentTime() / checkpointInterval )
+                           + 1. ) * checkpointInterval;
   
   // Finish up initialization
   initialized = true;
@@ -617,6 +708,7 @@ RunOneStorm()
    **      Mesh densification (if applicable)
    **      Eolian (loess) deposition (if applicable)
    **      Uplift (or baselevel change)
+   **    Reorder mesh for locality (if applicable)
    **********************************************************************/
   if(0) //debug
     std::cout << "         " << std::endl;
@@ -857,6 +949,16 @@ RunOneStorm()
     water_sed_tracker_.WriteAndResetWaterSedTimeseriesData( time->getCurrentTime(),
                                                            stormPlusDryDuration );
   
+  //----------------MESH ORDER---------------------------------
+  // Restore the order of the mesh lists (laid out along a Hilbert curve by
+  // the mesh), which densification and meandering wear down
+  if( optReorderMesh && reorderMeshInterval > 0 &&
+      ++stormsSinceReorder >= reorderMeshInterval )
+  {
+    mesh->ReorderForLocality();
+    stormsSinceReorder = 0;
+  }
+  
   time->Advance( stormPlusDryDuration );
 	
   if( output != nullptr && time->CheckOutputTime() )
@@ -864,6 +966,18 @@ RunOneStorm()
 	
   if( output != nullptr && output->OptTSOutput() ) output->WriteTSOutput();
   
+  //----------------CHECKPOINT---------------------------------
+  // Write a checkpoint at the checkpoint interval, or when asked to
+  if( checkpointRequested ||
+      ( optCheckpoint && time->getCurrentTime() >= nextCheckpointTime ) )
+  {
+    checkpointRequested = 0;
+    WriteCheckpoint( checkpointFile );
+    if( optCheckpoint )
+      nextCheckpointTime = ( floor( time->getCurrentTime() / checkpointInterval )
+                             + 1. ) * checkpointInterval;
+  }
+  
   return( time->getCurrentTime() );
 }
 
@@ -888,12 +1002,68 @@ Run( double run_duration )
 	if( run_duration>0.0 )
 		time->Start( time->getCurrentTime(), time->getCurrentTime()+run_duration );
   
-  while( !time->IsFinished() )
+  while( !time->IsFinished() && !stopRequested )
 		RunOneStorm();
+  if( stopRequested )
+    std::cout << "Run stopped at time " << time->getCurrentTime()
+              << "; restart it with --restart=" << checkpointFile << std::endl;
   
 }
 
 
+/**************************************************************************/
+/**
+ **  WriteCheckpoint
+ **
+ **  Writes the complete state of the run to a checkpoint file, from which
+ **  it can be restarted (see tCheckpoint.h). The output is flushed first,
+ **  so that the checkpoint records the sizes of complete output files.
+ **
+ **  RequestCheckpoint asks for a checkpoint to be written to the
+ **  checkpoint file (OUTFILENAME.ckp) after the current storm, and
+ **  optionally for Run to stop after it. It only sets flags, and may be
+ **  called from a signal handler (see childDriver.cpp).
+ */
+/**************************************************************************/
+
+void childInterface::
+WriteCheckpoint( const string &fileName )
+{
+  if( initialized==false )
+    ReportFatalError( "childInterface must be initialized before a checkpoint is written." );
+  if( optStratGrid )
+    ReportFatalError( "Checkpoints are not supported with OPTSTRATGRID." );
+  std::cout << "Writing checkpoint " << fileName << " at time "
+            << time->getCurrentTime() << std::endl;
+  if( output )
+    output->Flush();
+  tCheckpointWriter checkpoint( fileName, time->getCurrentTime() );
+  mesh->WriteCheckpoint( checkpoint );
+  rand->WriteCheckpoint( checkpoint, "rand" );
+  storm->WriteCheckpoint( checkpoint );
+  strmNet->WriteCheckpoint( checkpoint );
+  erosion->WriteCheckpoint( checkpoint );
+  if( uplift )
+    uplift->WriteCheckpoint( checkpoint );
+  time->WriteCheckpoint( checkpoint );
+  if( vegetation )
+    vegetation->WriteCheckpoint( checkpoint );
+  if( output )
+    output->WriteCheckpoint( checkpoint );
+  checkpoint.Write( "reorder", static_cast<long>( stormsSinceReorder ) );
+  checkpoint.WriteOutputFiles();
+  checkpoint.Commit();
+}
+
+void childInterface::
+RequestCheckpoint( bool stop )
+{
+  checkpointRequested = 1;
+  if( stop )
+    stopRequested = 1;
+}
+
+
 /**************************************************************************/
 /**
  **  CleanUp
@@ -38,6 +38,7 @@
 #include "../tWaterSedTracker/tWaterSedTracker.h"
 #include "../tMeshList/tMeshList.h"
 #include "../tLithologyManager/tLithologyManager.h"
+#include "../tCheckpoint/tCheckpoint.h"
 
 using namespace std;
 
@@ -114,6 +115,11 @@ public:
 				 bool yesVary = true ); 
   double RunOneStorm();
   void Run( double run_duration );
+  // writes the complete state of the run to a checkpoint file
+  void WriteCheckpoint( const string &fileName );
+  // asks for a checkpoint after the current storm, and to stop the run
+  // after it if stop is set (safe to call from a signal handler)
+  static void RequestCheckpoint( bool stop );
   void CleanUp();
   ~childInterface();
   void ExternalErosionAndDeposition( vector<double> dz );
@@ -193,6 +199,13 @@ private:
     optChemicalWeathering, // Option for chemical weathering
     optPhysicalWeathering; // Option for physical weathering
   bool optStreamLineBoundary; // Option for converting streamlines to open boundaries
+  bool optReorderMesh;   // Option for reordering the mesh for locality
+  int reorderMeshInterval; // No. of storms between reorderings (0=only at start)
+  int stormsSinceReorder;  // No. of storms since the mesh was last reordered
+  bool optCheckpoint;      // Option for writing checkpoints periodically
+  double checkpointInterval; // Model time between checkpoints
+  double nextCheckpointTime; // Model time of the next checkpoint
+  string checkpointFile;   // Name of the checkpoint file
   tRand *rand;             // -> random number generator
   tMesh<tLNode> *mesh;        // -> mesh object
   tLOutput<tLNode> *output;   // -> output handler
@@ -39,8 +39,11 @@ class tEquilibCheck;
 class tSedTransPwrLaw;
 class tBedErodePwrLaw;
 class tStreamNet;
+class tNetOrderIter;
 class tStreamMeander;
 class tStorm;
 class tRunTimer;
+class tCheckpointWriter;
+class tCheckpointReader;
 
 #endif
@@ -88,9 +88,14 @@
 # include <iomanip>
 #include <vector>  // first added for DiffuseNonlinear()
 #include <queue> // first added for Landslides()
+#include <algorithm>
 using namespace std;   // also added for DiffuseNonlinear() to use vector class from STL
 //#include <string>
 #include "erosion.h"
+#include "../tOutput/tBinaryOutput.h"
+#include "../tCheckpoint/tCheckpoint.h"
+#include "../tSparseMatrix/tSparseMatrix.h"
+#include "../tThreadPool/tThreadPool.h"
 
 // Here follows a table for transport, detachment, and physical and chemical
 // weathering laws, which are chosen at run time via "X()" trick in 
@@ -469,6 +474,93 @@ double tEquilibCheck::FindLongTermChngRate( double newtime )
 
 
 
+/***************************************************************************\
+ **  tBedErode::DetachRate
+ **
+ **  Default for detachment laws that do not (yet) support the implicit
+ **  detachment-limited solver (tErosion::ErodeDetachLimImplicit).
+ \***************************************************************************/
+double tBedErode::DetachRate( tLNode *, double, double & )
+{
+  ReportFatalError( "The implicit detachment-limited solver "
+                    "(OPT_IMPLICIT_DETACHMENT) is not available for this "
+                    "detachment law." );
+}
+
+/***************************************************************************\
+ **  FUNCTIONS FOR CLASS tLawBatch
+ \***************************************************************************/
+
+/***************************************************************************\
+ **  tLawBatch::Start, GatherFlow, GatherTexture, GatherBed
+ **
+ **  The Gather functions copy the values of the items' nodes and layers
+ **  into the arrays. The values of a node are looked up once for all of
+ **  its (consecutive) items. GatherBed needs the flood status, and only
+ **  looks up the erodibility of the layers of the nodes not flooded.
+ \***************************************************************************/
+void tLawBatch::Start( size_t numg )
+{
+  const size_t n = node.size();
+  tau.assign( n, 0.0 );
+  cap.assign( n, 0.0 );
+  capg.assign( n*numg, 0.0 );
+}
+
+void tLawBatch::GatherFlow()
+{
+  const size_t n = node.size();
+  Q.resize( n );
+  S.resize( n );
+  W.resize( n );
+  wet.resize( n );
+  for( size_t k=0; k<n; ++k )
+  {
+    if( k>0 && node[k]==node[k-1] )
+    {
+      Q[k] = Q[k-1];
+      S[k] = S[k-1];
+      W[k] = W[k-1];
+      wet[k] = wet[k-1];
+      continue;
+    }
+    tLNode *nd = node[k];
+    Q[k] = nd->getQ();
+    S[k] = nd->calcSlope();
+    W[k] = nd->getHydrWidth();
+    wet[k] = ( nd->getFloodStatus() == tLNode::kNotFlooded );
+  }
+}
+
+void tLawBatch::GatherTexture( size_t numg )
+{
+  const size_t n = node.size();
+  frac.resize( n*numg );
+  for( size_t k=0; k<n; ++k )
+  {
+    const int lyr = ( layer[k]<0 ) ? 0 : layer[k];
+    assert( node[k]->getLayerDepth(lyr) > 0.0 );
+    for( size_t g=0; g<numg; ++g )
+      frac[k*numg+g] =
+        node[k]->getLayerDgrade(lyr,g) / node[k]->getLayerDepth(lyr);
+  }
+}
+
+void tLawBatch::GatherBed()
+{
+  const size_t n = node.size();
+  assert( wet.size() == n );
+  tauc.resize( n );
+  erody.resize( n );
+  for( size_t k=0; k<n; ++k )
+  {
+    tauc[k] = node[k]->getTauCrit();
+    erody[k] = wet[k] ?
+      node[k]->getLayerErody( ( layer[k]<0 ) ? 0 : layer[k] ) : 0.0;
+  }
+}
+
+
 /***************************************************************************\
  **  FUNCTIONS FOR CLASS tBedErodePwrLaw
  \***************************************************************************/
@@ -689,6 +781,62 @@ double tBedErodePwrLaw::DetachCapacity( tLNode * n, int i )
 }
 
 
+/***************************************************************************\
+ **  tBedErodePwrLaw::DetachCapacity (batch version)
+ **
+ **  Computes the rates of all items of b as DetachCapacity( n, i ) does
+ **  (DetachCapacity( n ) for items without a layer, i.e., layer 0), then
+ **  sets the shear stress and drdt of the nodes not flooded.
+ **
+ **  The rates are computed in one loop over the arrays of b (RateKernel).
+ **  The flooded items are computed with Q = W = S = 1, so that the loop
+ **  has no branches and evaluates nothing that the node by node version
+ **  would not, and their results are dropped.
+ \***************************************************************************/
+bool tBedErodePwrLaw::DetachCapacity( tLawBatch &b )
+{
+  const size_t n = b.getSize();
+  if( n==0 ) return true;
+  b.Start( 0 );
+  b.GatherFlow();
+  b.GatherBed();
+  for( size_t k=0; k<n; ++k )
+    if( b.wet[k] && b.S[k] < 0.0 )
+      ReportFatalError("neg. slope in tBedErodePwrLaw::DetachCapacity(tLNode*)");
+
+  RateKernel( b );
+
+  for( size_t k=0; k<n; ++k )
+    if( b.wet[k] )
+    {
+      b.node[k]->setTau( b.tau[k] );
+      b.node[k]->setDrDt( -b.cap[k] );
+    }
+  return true;
+}
+
+void tBedErodePwrLaw::RateKernel( tLawBatch &b ) const
+{
+  const size_t n = b.getSize();
+  const double * const Q = &b.Q[0], * const S = &b.S[0], * const W = &b.W[0];
+  const double * const tauc = &b.tauc[0], * const erody = &b.erody[0];
+  const char * const wet = &b.wet[0];
+  double * const tau = &b.tau[0], * const cap = &b.cap[0];
+  for( size_t k=0; k<n; ++k )
+  {
+    const double q = wet[k] ? Q[k] : 1.0,
+      w = wet[k] ? W[k] : 1.0,
+      s = wet[k] ? S[k] : 1.0;
+    const double t = kt*pow( q / w, mb )*pow( s, nb );
+    double erorate = t - tauc[k];
+    erorate = (erorate>0.0) ? erorate : 0.0;
+    erorate = erody[k]*pow( erorate, pb );
+    tau[k] = wet[k] ? t : 0.0;
+    cap[k] = wet[k] ? erorate : 0.0;
+  }
+}
+
+
 
 /***************************************************************************\
  **  tBedErode::SetTimeStep
@@ -722,6 +870,33 @@ double tBedErodePwrLaw::SetTimeStep( tLNode * n )
   
 }
 
+/***************************************************************************\
+ **  tBedErodePwrLaw::DetachRate
+ **
+ **  Computes the rate of erosion = kb ( tau - taucrit )^pb, with
+ **  tau = kt (Q/W)^mb S^nb, for a trial slope S rather than the node's
+ **  current slope, along with its derivative with respect to S. Used by
+ **  tErosion::ErodeDetachLimImplicit.
+ **
+ **  Input: n -- node at which to compute detachment rate
+ **         slp -- slope
+ **  Output: dRdS -- derivative of the rate with respect to slope
+ **  Returns: the detachment rate
+ \***************************************************************************/
+double tBedErodePwrLaw::DetachRate( tLNode * n, double slp, double &dRdS )
+{
+  dRdS = 0.0;
+  if( n->getFloodStatus() != tLNode::kNotFlooded) return 0.0;
+  if( slp < 0.0 ) slp = 0.0;
+  const double tau = kt*pow( n->getQ() / n->getHydrWidth(), mb )*pow( slp, nb );
+  n->setTau( tau );
+  const double tauex = tau - n->getTauCrit();
+  if( tauex <= 0.0 || slp == 0.0 ) return 0.0;
+  const double erorate = n->getLayerErody(0)*pow( tauex, pb );
+  dRdS = pb * erorate / tauex * nb * tau / slp;
+  return erorate;
+}
+
 /***************************************************************************\
  **  FUNCTIONS FOR CLASS tBedErodePwrLaw2
  \***************************************************************************/
@@ -924,6 +1099,34 @@ double tBedErodePwrLaw2::SetTimeStep( tLNode * n )
   
 }
 
+/***************************************************************************\
+ **  tBedErodePwrLaw2::DetachRate
+ **
+ **  Computes the rate of erosion = kb ( tau^pb - taucrit^pb ), with
+ **  tau = kt (Q/W)^mb S^nb, for a trial slope S rather than the node's
+ **  current slope, along with its derivative with respect to S. Used by
+ **  tErosion::ErodeDetachLimImplicit.
+ **
+ **  Input: n -- node at which to compute detachment rate
+ **         slp -- slope
+ **  Output: dRdS -- derivative of the rate with respect to slope
+ **  Returns: the detachment rate
+ \***************************************************************************/
+double tBedErodePwrLaw2::DetachRate( tLNode * n, double slp, double &dRdS )
+{
+  dRdS = 0.0;
+  if( n->getFloodStatus() != tLNode::kNotFlooded) return 0.0;
+  if( slp < 0.0 ) slp = 0.0;
+  const double tau = kt*pow( n->getQ() / n->getHydrWidth(), mb )*pow( slp, nb );
+  n->setTau( tau );
+  const double taupb = pow( tau, pb );
+  const double erorate = taupb - pow( n->getTauCrit(), pb );
+  if( erorate <= 0.0 || slp == 0.0 ) return 0.0;
+  const double erody = n->getLayerErody(0);
+  dRdS = erody * pb * taupb * nb / slp;
+  return erody*erorate;
+}
+
 /***************************************************************************\
  **  FUNCTIONS FOR CLASS tBedErodeAParabolic1
  \***************************************************************************/
@@ -1370,6 +1573,36 @@ double tBedErodeGeneralFQS::SetTimeStep( tLNode * nd )
 }
 
 
+/***************************************************************************\
+ **  tBedErodeGeneralFQS::DetachRate
+ **
+ **  Computes the rate of erosion = K Qs/W (1 - Qs/Qc) A^m (sin alpha)^n
+ **  for a trial slope tan alpha rather than the node's current slope,
+ **  along with its derivative with respect to that slope. As in
+ **  DetachCapacity, the rate is made arbitrarily large if Qs>=Qc. Used by
+ **  tErosion::ErodeDetachLimImplicit.
+ **
+ **  Input: nd -- node at which to compute detachment rate
+ **         slp -- slope (tan alpha)
+ **  Output: dRdS -- derivative of the rate with respect to slope
+ **  Returns: the detachment rate [L/T]
+ \***************************************************************************/
+double tBedErodeGeneralFQS::DetachRate( tLNode * nd, double slp, double &dRdS )
+{
+  dRdS = 0.0;
+  if( nd->getFloodStatus() != tLNode::kNotFlooded) return 0.0;
+  const double Qs = beta * (nd->getQsin()+nd->getQsdin()); //sediment load
+  const double Qc = nd->getQs(); //transport rate
+  if( Qs <= 0 || slp <= 0.0 ) return 0.0;
+  if( Qs >= Qc ) return 999999999;
+  const double sina = slp / sqrt( 1.0 + slp*slp );
+  const double erorate =
+    K*(Qs/nd->getHydrWidth())*(1-(Qs/Qc))*pow(nd->getQ(),m)*pow(sina,n);
+  // d(sin alpha)/d(tan alpha) = cos^3 alpha
+  dRdS = n * erorate / sina * pow( 1.0 + slp*slp, -1.5 );
+  return erorate;
+}
+
 /***************************************************************************\
  **  FUNCTIONS FOR CLASS tSedTransPwrLaw
  \***************************************************************************/
@@ -1498,6 +1731,77 @@ double tSedTransPwrLaw::TransCapacity( tLNode *node, int lyr, double weight )
 }
 
 
+/***************************************************************************\
+ **  tSedTransPwrLaw::TransCapacity (batch version)
+ **
+ **  Computes the capacities of all items of b as TransCapacity( n, i,
+ **  weight ) does (TransCapacity( n ) for items without a layer), then
+ **  makes the same changes to the nodes, item by item: shear stress,
+ **  qs of each size (items with a layer) and total qs.
+ **
+ **  The capacities are computed in one loop over the arrays of b
+ **  (CapacityKernel, one version for each kind of item). The flooded
+ **  items are computed with Q = W = S = 1, and their results dropped.
+ \***************************************************************************/
+bool tSedTransPwrLaw::TransCapacity( tLawBatch &b )
+{
+  const size_t n = b.getSize();
+  if( n==0 ) return true;
+  const bool weighted = ( b.layer[0] >= 0 );
+  b.Start( 0 );
+  b.GatherFlow();
+  for( size_t k=0; k<n; ++k )
+  {
+    assert( ( b.layer[k] >= 0 ) == weighted );
+    if( b.S[k] < 0.0 )
+      ReportFatalError("neg. slope in tSedTransPwrLaw::TransCapacity(tLNode*)");
+  }
+
+  if( weighted )
+    CapacityKernel< true >( b );
+  else
+    CapacityKernel< false >( b );
+
+  for( size_t k=0; k<n; ++k )
+  {
+    tLNode * const node = b.node[k];
+    const double cap = b.cap[k];
+    if( b.wet[k] ) node->setTau( b.tau[k] );
+    if( weighted )
+    {
+      const int lyr = b.layer[k];
+      for(size_t i=0; i<node->getNumg(); i++)
+        node->addQs(i, cap*node->getLayerDgrade(lyr,i)/node->getLayerDepth(lyr));
+    }
+    node->setQs( cap );
+  }
+  return true;
+}
+
+template< bool kWeighted >
+void tSedTransPwrLaw::CapacityKernel( tLawBatch &b ) const
+{
+  const size_t n = b.getSize();
+  const double * const Q = &b.Q[0], * const S = &b.S[0], * const W = &b.W[0];
+  const double * const weight = &b.weight[0];
+  const char * const wet = &b.wet[0];
+  double * const tau = &b.tau[0], * const cap = &b.cap[0];
+  for( size_t k=0; k<n; ++k )
+  {
+    const double q = wet[k] ? Q[k] : 1.0,
+      w = wet[k] ? W[k] : 1.0,
+      s = wet[k] ? S[k] : 1.0;
+    const double t = kt * pow( q/w, mf ) * pow( s, nf );
+    double tauex = t - tauc;
+    tauex = (tauex>0.0) ? tauex : 0.0;
+    const double c = kWeighted ?
+      weight[k] * kf * w * pow( tauex, pf ) : kf * w * pow( tauex, pf );
+    tau[k] = wet[k] ? t : 0.0;
+    cap[k] = wet[k] ? c : 0.0;
+  }
+}
+
+
 /***************************************************************************\
  **  FUNCTIONS FOR CLASS tSedTransPwrLaw2
  \***************************************************************************/
@@ -1948,7 +2252,7 @@ double tSedTransPwrLawMulti::TransCapacity( tLNode *node, int lyr, double weight
   double d50 = 0.0,   // Mean grain size
   tau,              // Shear stress
   tauex;            // Excess shear stress
-  tArray<double> frac( miNumgrnsizes );
+  tGrainArray frac( miNumgrnsizes );
   int i;
   
   // Compute D50 and fraction of each size
@@ -2012,6 +2316,84 @@ double tSedTransPwrLawMulti::TransCapacity( tLNode * /* node */ )
 }
 
 
+/***************************************************************************\
+ **  tSedTransPwrLawMulti::TransCapacity (batch version)
+ **
+ **  Computes the capacities of all items of b as TransCapacity( n, lyr,
+ **  weight ) does, then sets the shear stress, the qs of each size and
+ **  the total qs of the nodes, item by item. Items without a layer have
+ **  no capacity, as with TransCapacity( n ).
+ **
+ **  The capacities are computed in one loop over the arrays of b
+ **  (CapacityKernel). The flooded items have no shear stress, and their
+ **  Q, W and S are not used.
+ \***************************************************************************/
+bool tSedTransPwrLawMulti::TransCapacity( tLawBatch &b )
+{
+  const size_t n = b.getSize();
+  if( n==0 ) return true;
+  const size_t numg = miNumgrnsizes;
+  b.Start( numg );
+  if( b.layer[0] < 0 ) return true;
+  b.GatherFlow();
+  b.GatherTexture( numg );
+  for( size_t k=0; k<n; ++k )
+  {
+    assert( b.layer[k] >= 0 );
+    if( b.S[k] < 0.0 )
+      ReportFatalError("neg. slope in tSedTransPwrLaw::TransCapacity(tLNode*)");
+  }
+
+  CapacityKernel( b );
+
+  for( size_t k=0; k<n; ++k )
+  {
+    tLNode * const node = b.node[k];
+    node->setTau( b.tau[k] );
+    for( size_t i=0; i<numg; i++ )
+      node->addQs( i, b.capg[k*numg+i] );
+    node->setQs( b.cap[k] );
+  }
+  return true;
+}
+
+void tSedTransPwrLawMulti::CapacityKernel( tLawBatch &b ) const
+{
+  const size_t n = b.getSize(), numg = miNumgrnsizes;
+  const double * const Q = &b.Q[0], * const S = &b.S[0], * const W = &b.W[0];
+  const double * const weight = &b.weight[0], * const frac = &b.frac[0];
+  const char * const wet = &b.wet[0];
+  const double * const grndiam = mdGrndiam.getArrayPtr();
+  const double * const taucg = mdTauc.getArrayPtr();
+  double * const tau = &b.tau[0], * const cap = &b.cap[0];
+  double * const capg = &b.capg[0];
+  for( size_t k=0; k<n; ++k )
+  {
+    const double * const f = frac + k*numg;
+    double d50 = 0.0;
+    for( size_t i=0; i<numg; i++ )
+      d50 += f[i] * grndiam[i];
+    const double q = wet[k] ? Q[k] : 1.0,
+      w = wet[k] ? W[k] : 1.0,
+      s = wet[k] ? S[k] : 1.0;
+    const double tf = kt * pow( q/w, mf ) * pow( s, nf );
+    const double t = wet[k] ? tf : 0.0;
+    double totalcap = 0.0;
+    for( size_t i=0; i<numg; i++ )
+    {
+      const double tauc = taucg[i] * pow( grndiam[i] / d50, -mdHidingexp );
+      double tauex = t - tauc;
+      tauex = (tauex>0.0) ? tauex : 0.0;
+      const double c = f[i] * weight[k] * kf * W[k] * pow( tauex, pf );
+      totalcap += c;
+      capg[k*numg+i] = c;
+    }
+    tau[k] = t;
+    cap[k] = totalcap;
+  }
+}
+
+
 /*************************************************************************\
  **  FUNCTIONS FOR CLASS tSedTransWilcock
  \**************************************************************************/
@@ -2257,6 +2639,97 @@ double tSedTransWilcock::TransCapacity( tLNode *nd, int i, double weight )
   
 }
 
+
+/***********************************************************************\
+ **  tSedTransWilcock::TransCapacity (batch version)
+ **
+ **  Computes the capacities of all items of b as TransCapacity( nd, i,
+ **  weight ) does, then adds the sand and gravel capacities to the qs of
+ **  the nodes, item by item. Returns false if the items have no layer
+ **  (TransCapacity( nd ) has no batch version).
+ **
+ **  The capacities are computed in one loop over the arrays of b
+ **  (CapacityKernel, one version for sand only and one for sand and
+ **  gravel). The loop computes the rates of the sizes below their
+ **  critical shear stress with a zero ratio taucrit/tau, and drops them.
+ \***********************************************************************/
+bool tSedTransWilcock::TransCapacity( tLawBatch &b )
+{
+  const size_t n = b.getSize();
+  if( n==0 ) return true;
+  if( b.layer[0] < 0 ) return false;
+  const size_t numg = b.node[0]->getNumg();
+  b.Start( 2 );
+  b.GatherFlow();
+  b.GatherTexture( numg );
+
+  if( numg==2 )
+    CapacityKernel< true >( b, numg );
+  else
+    CapacityKernel< false >( b, numg );
+
+  for( size_t k=0; k<n; ++k )
+  {
+    tLNode * const nd = b.node[k];
+    assert( b.layer[k] >= 0 );
+    if( b.S[k] < 0 )
+    {
+      nd->setQs(0, 0.);
+      if(nd->getNumg()==2)
+        nd->setQs(1, 0.);
+      nd->setQs(0.);
+      b.cap[k] = 0.0;
+      continue;
+    }
+    // (a size below its critical shear stress has no capacity, and
+    // adds nothing)
+    if( b.capg[2*k] != 0.0 ) nd->addQs(0, b.capg[2*k]);
+    if( b.capg[2*k+1] != 0.0 ) nd->addQs(1, b.capg[2*k+1]);
+  }
+  return true;
+}
+
+template< bool kTwoSizes >
+void tSedTransWilcock::CapacityKernel( tLawBatch &b, size_t numg ) const
+{
+  const size_t n = b.getSize();
+  const double * const Q = &b.Q[0], * const S = &b.S[0], * const W = &b.W[0];
+  const double * const weight = &b.weight[0], * const frac = &b.frac[0];
+  double * const cap = &b.cap[0], * const capg = &b.capg[0];
+  const double taucoef = taudim*pow(0.03, 0.6);
+  for( size_t k=0; k<n; ++k )
+  {
+    const double persand = frac[k*numg];
+    const double slp = ( S[k] < 0 ) ? 0.0 : S[k];
+    const double tau = taucoef*pow(Q[k]/SECPERYEAR, 0.3)*pow( slp, 0.7);
+
+    // Sand
+    double taucrit = (persand<.10) ? lowtaucs :
+      ( (persand<=.40) ? ((sands*persand)+sandb) : hightaucs );
+    bool moving = ( tau>taucrit );
+    double ratio = ( moving ? taucrit : 0.0 ) / ( moving ? tau : 1.0 );
+    double q = (0.058/RHOSED)*weight[k]*W[k]*SECPERYEAR*persand*pow(tau,1.5)*pow((1-sqrt(ratio)),4.5);
+    const double qss = moving ? q : 0.0;
+
+    // Gravel
+    double qsg = 0.;
+    if( kTwoSizes )
+    {
+      taucrit = (persand<.10) ? lowtaucg :
+        ( (persand<=.40) ? ((gravs*persand)+gravb) : hightaucg );
+      moving = ( tau>taucrit );
+      ratio = ( moving ? taucrit : 0.0 ) / ( moving ? tau : 1.0 );
+      q = (0.058*SECPERYEAR*weight[k]*W[k]/(RHOSED))*
+        (1-persand)*pow(tau,1.5)*pow((1-ratio),4.5);
+      qsg = moving ? q : 0.0;
+    }
+
+    capg[2*k] = qss;
+    capg[2*k+1] = qsg;
+    cap[k] = qsg+qss;
+  }
+}
+
 /*************************************************************************\
  **  FUNCTIONS FOR CLASS tSedTransMineTailings
  \**************************************************************************/
@@ -3556,12 +4029,15 @@ tErosion::tErosion( tMesh<tLNode> *mptr, const tInputFile &infile,
 		    bool no_write_mode /* = false */ ) :
 meshPtr(mptr),
 bedErode(0), sedTrans(0), physWeath(0), chemWeath(0), 
-runout(0), scour(0), deposit(0), DF_fsPtr(0), DF_Hyd_fsPtr(0),
+runout(0), scour(0), deposit(0), DF_fsPtr(0), DF_Hyd_fsPtr(0), ImpDif_fsPtr(0),
+DtSub_fsPtr(0),
 track_sed_flux_at_nodes_( false ), water_sed_tracker_ptr_(NULL),
 soilBulkDensity(kDefaultSoilBulkDensity),
 rockBulkDensity(kDefaultRockBulkDensity),
 wetBulkDensity(kDefaultWetBulkDensity), 
 woodDensity(450.0), fricSlope(1.0), num_grain_sizes_(1),
+optImplicitDetachLim(false), optImplicitDiffusion(false),
+optParallelBasins(false),
 debris_flow_sed_bucket(0), debris_flow_wood_bucket(0)
 {
   assert( mptr!=0 );
@@ -3575,6 +4051,21 @@ debris_flow_sed_bucket(0), debris_flow_wood_bucket(0)
   bool optNonlinearDiffusion = infile.ReadBool( "OPT_NONLINEAR_DIFFUSION", false );
   if( optNonlinearDiffusion )
     mdSc = infile.ReadItem( mdSc, "CRITICAL_SLOPE" );
+  optImplicitDiffusion = infile.ReadBool( "OPT_IMPLICIT_DIFFUSION", false );
+  // If implicit diffusion, create file for writing solver iterations
+  if( optImplicitDiffusion && !no_write_mode )
+  {
+    ImpDif_fsPtr = new std::ofstream();
+    char fname[87];
+#define THEEXT ".difit"
+    infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
+    strcat( fname, THEEXT );
+#undef THEEXT
+    tOutputFiles::Open( *ImpDif_fsPtr, fname );
+    if( !ImpDif_fsPtr->good() )
+      std::cerr << "Warning: unable to create implicit diffusion iteration file '"
+                << fname << "'\n";
+  }
   beta=infile.ReadItem( beta, "BETA"); //For Sediment-Flux Detach Rules
   bool optDepthDependentDiffusion = 
   infile.ReadBool( "OPT_DEPTH_DEPENDENT_DIFFUSION", false );
@@ -3616,6 +4107,30 @@ break;
   
   std::cout << "DETACHMENT OPTION: "
   << DetachmentLaw[optBedErosionLaw] << std::endl;
+
+  // option for the implicit detachment-limited solver:
+  optImplicitDetachLim = infile.ReadBool( "OPT_IMPLICIT_DETACHMENT", false );
+  if( optImplicitDetachLim && optBedErosionLaw == DetachAParabolic1 )
+    ReportFatalError( "OPT_IMPLICIT_DETACHMENT is not available for the "
+                      "detachment law 'Almost Parabolic Law'.\n" );
+  
+  // option for eroding each drainage basin with its own time steps, and
+  // the basins in parallel (see DetachErode)
+  optParallelBasins = infile.ReadBool( "OPT_PARALLEL_BASINS", false );
+  // If so, create file for writing the time steps of the basins
+  if( optParallelBasins && !no_write_mode )
+  {
+    DtSub_fsPtr = new std::ofstream();
+    char fname[87];
+#define THEEXT ".dtsub"
+    infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
+    strcat( fname, THEEXT );
+#undef THEEXT
+    tOutputFiles::Open( *DtSub_fsPtr, fname );
+    if( !DtSub_fsPtr->good() )
+      std::cerr << "Warning: unable to create basin time step file '"
+                << fname << "'\n";
+  }
   
   // set sediment transport law:
   optSedTransLaw = infile.ReadItem( optSedTransLaw,
@@ -3798,7 +4313,7 @@ break;
 	    infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
 	    strcat( fname, THEEXT );
 #undef THEEXT
-	    DF_fsPtr->open( fname );
+	    tOutputFiles::Open( *DF_fsPtr, fname );
 	    if( !DF_fsPtr->good() )
 	      std::cerr << "Warning: unable to create debris flow data file '"
 			<< fname << "'\n";
@@ -3810,7 +4325,7 @@ break;
 	    infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
 	    strcat( fname, THEEXT );
 #undef THEEXT
-	    DF_Hyd_fsPtr->open( fname );
+	    tOutputFiles::Open( *DF_Hyd_fsPtr, fname );
 	    if( !DF_Hyd_fsPtr->good() )
 	      std::cerr << "Warning: unable to create debris flow hydrograph file '"
 			<< fname << "'\n";
@@ -3823,7 +4338,8 @@ break;
 // copy constructor for copying to new mesh:
 tErosion::tErosion( const tErosion& orig, tMesh<tLNode>* Ptr )
   : meshPtr(Ptr), bedErode(0), sedTrans(0), physWeath(0), chemWeath(0), runout(0),
-    scour(0), deposit(0), DF_fsPtr(0), DF_Hyd_fsPtr(0),
+    scour(0), deposit(0), DF_fsPtr(0), DF_Hyd_fsPtr(0), ImpDif_fsPtr(0),
+    DtSub_fsPtr(0),
     kd(orig.kd),                 // Hillslope transport (diffusion) coef
     kd_ts(orig.kd_ts),
     difThresh(orig.difThresh),   // Diffusion occurs only at areas < difThresh
@@ -3839,6 +4355,9 @@ tErosion::tErosion( const tErosion& orig, tMesh<tLNode>* Ptr )
     woodDensity(orig.woodDensity), // density of wood (kg/m3)
     fricSlope(orig.fricSlope), // tangent of angle of repose for soil (unitless)
     num_grain_sizes_(orig.num_grain_sizes_), // # grain size classes
+    optImplicitDetachLim(orig.optImplicitDetachLim),
+    optImplicitDiffusion(orig.optImplicitDiffusion),
+    optParallelBasins(orig.optParallelBasins),
     debris_flow_sed_bucket(0.0), // tally of debris flow sed. volume
     debris_flow_wood_bucket(0.0), // tally of debris flow wood volume
     landslideAreas(),
@@ -3957,6 +4476,8 @@ tErosion::~tErosion(){
   if( deposit != nullptr ) delete deposit;
   if( DF_fsPtr != nullptr ) delete DF_fsPtr;
   if( DF_Hyd_fsPtr != nullptr ) delete DF_Hyd_fsPtr;
+  if( ImpDif_fsPtr != nullptr ) delete ImpDif_fsPtr;
+  if( DtSub_fsPtr != nullptr ) delete DtSub_fsPtr;
 }
 
 /**************************************************************************\
@@ -3980,7 +4501,7 @@ void tErosion::TurnOnOutput( const tInputFile& infile )
       infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
       strcat( fname, THEEXT );
 #undef THEEXT
-      DF_fsPtr->open( fname );
+      tOutputFiles::Open( *DF_fsPtr, fname );
       if( !DF_fsPtr->good() )
         std::cerr << "Warning: unable to create debris flow data file '"
 		    << fname << "'\n";
@@ -3992,7 +4513,7 @@ void tErosion::TurnOnOutput( const tInputFile& infile )
       infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
       strcat( fname, THEEXT );
 #undef THEEXT
-      DF_Hyd_fsPtr->open( fname );
+      tOutputFiles::Open( *DF_Hyd_fsPtr, fname );
       if( !DF_Hyd_fsPtr->good() )
         std::cerr << "Warning: unable to create debris flow hydrograph file '"
 		    << fname << "'\n";
@@ -4014,6 +4535,52 @@ void tErosion::TurnOffOutput()
 }
 
 
+/**************************************************************************\
+**
+**  tErosion::WriteCheckpoint, ReadCheckpoint
+**
+**  Save and restore the parameters that may be changed during a run
+**  (through the set functions), and the debris-flow tallies and list of
+**  landslide areas.
+**
+\**************************************************************************/
+void tErosion::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  std::vector<double> d(6);
+  d[0] = kd;
+  d[1] = diffusionH;
+  d[2] = soilBulkDensity;
+  d[3] = fricSlope;
+  d[4] = debris_flow_sed_bucket;
+  d[5] = debris_flow_wood_bucket;
+  ckp.Write( "ero", d );
+  std::vector<double> areas;
+  tListIter<double> ai( const_cast< tList<double> & >( landslideAreas ) );
+  for( double *a = ai.FirstP(); !ai.AtEnd(); a = ai.NextP() )
+    areas.push_back( *a );
+  ckp.Write( "ero.slides", areas );
+}
+
+void tErosion::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  std::vector<double> d;
+  ckp.Read( "ero", d );
+  if( d.size() != 6 )
+    ReportFatalError( "tErosion: bad erosion state in checkpoint." );
+  kd = d[0];
+  diffusionH = d[1];
+  setSoilBulkDensity( d[2] );
+  fricSlope = d[3];
+  debris_flow_sed_bucket = d[4];
+  debris_flow_wood_bucket = d[5];
+  std::vector<double> areas;
+  ckp.Read( "ero.slides", areas );
+  landslideAreas.Flush();
+  for( size_t i=0; i<areas.size(); ++i )
+    landslideAreas.insertAtBack( areas[i] );
+}
+
+
 /*****************************************************************************\
  **
  **  tErosion::ErodeDetachLim
@@ -4044,10 +4611,16 @@ void tErosion::TurnOffOutput()
  **   - added calls to compute channel width (& depth etc) before computing
  **     erosion. This is done because the detachment capacity functions now
  **     require a defined channel width. (GT 2/01)
+ **   - hands over to ErodeDetachLimImplicit if OPT_IMPLICIT_DETACHMENT is set
  \*****************************************************************************/
 void tErosion::ErodeDetachLim( double dtg, tStreamNet *strmNet,
                               tVegetation * /*pVegetation*/ )
 {
+  if( optImplicitDetachLim )
+  {
+    ErodeDetachLimImplicit( dtg, strmNet );
+    return;
+  }
   if(0) //DEBUG
     std::cout<<"ErodeDetachLim...";
   double dt,
@@ -4132,6 +4705,11 @@ void tErosion::ErodeDetachLim( double dtg, tStreamNet *strmNet,
  \*****************************************************************************/
 void tErosion::ErodeDetachLim( double dtg, tStreamNet *strmNet, tUplift const *UPtr )
 {
+  if( optImplicitDetachLim )
+  {
+    ErodeDetachLimImplicit( dtg, strmNet );
+    return;
+  }
   double dt,
   dtmax; // time increment
   double frac = 0.1; //fraction of time to zero slope
@@ -4214,6 +4792,95 @@ void tErosion::ErodeDetachLim( double dtg, tStreamNet *strmNet, tUplift const *U
 }//end tErosion::ErodeDetachLim( double dtg, tUplift *UPtr )
 
 
+/*****************************************************************************\
+ **
+ **  tErosion::ErodeDetachLimImplicit
+ **
+ **  Implicit alternative to ErodeDetachLim, selected with the option
+ **  OPT_IMPLICIT_DETACHMENT. The detachment-limited erosion equation is
+ **  solved with a single backward-Euler step over the whole interval dtg,
+ **  which is unconditionally stable, so no sub-steps are needed. Because
+ **  the slope at a node depends only on its own elevation and that of its
+ **  downstream neighbor, the nodes can be solved one at a time from
+ **  downstream to upstream, each using the updated elevation of its
+ **  downstream neighbor (Braun and Willett, 2013). At each node,
+ **
+ **    z = z0 - dtg E( (z - zd) / L )
+ **
+ **  where z0 is the old elevation, zd the new elevation downstream, L the
+ **  flow edge length, and E the detachment rate as a function of slope
+ **  (tBedErode::DetachRate). E never decreases with slope, so there is one
+ **  root between zd and z0; it is found with Newton's method, falling back
+ **  on bisection when a step leaves the bracket. When E is linear in slope
+ **  (nb=pb=1, no threshold) the first Newton step is the exact solution.
+ **
+ **  Unlike ErodeDetachLim, erodibility, discharge and width are held at
+ **  their values at the start of the interval, and the slope of meandering
+ **  nodes is taken along the flow edge only.
+ **
+ **  Reference: Braun, J., and Willett, S.D., 2013, A very efficient O(n),
+ **    implicit and parallel method to solve the stream power equation
+ **    governing fluvial incision and landscape evolution: Geomorphology,
+ **    v. 180-181, p. 170-179.
+ **
+ \*****************************************************************************/
+void tErosion::ErodeDetachLimImplicit( double dtg, tStreamNet *strmNet )
+{
+  if(0) //DEBUG
+    std::cout<<"ErodeDetachLimImplicit...";
+  const int kMaxIter = 100;  // max. Newton/bisection iterations per node
+  const double kTol = 1e-10; // convergence tolerance, as fraction of z0-zd
+
+  if( dtg <= 0.0 ) return;
+
+  strmNet->SortNodesByNetOrder();
+  strmNet->FindChanGeom();
+  strmNet->FindHydrGeom();
+
+  tArray<double> valgrd(1);
+  //TODO: make it work w/ arbitrary # grain sizes
+
+  // Work from downstream to upstream (reverse of network order), so that
+  // each node's downstream neighbor has already been updated
+  const std::vector< tLNode * > &netOrder = strmNet->getNetOrder();
+  for( std::vector< tLNode * >::const_reverse_iterator it = netOrder.rbegin();
+       it != netOrder.rend(); ++it )
+  {
+    tLNode *cn = *it;
+    const double z0 = cn->getZ();
+    const double zd = cn->getDownstrmNbr()->getZ();
+    double z = z0;
+    if( cn->getFloodStatus() == tLNode::kNotFlooded && z0 > zd )
+    {
+      const double len = cn->getFlowEdg()->getLength();
+      const double tol = kTol * ( z0 - zd );
+      double lo = zd, hi = z0;  // bracket on the root
+      int iter = 0;
+      double dz;
+      do
+      {
+        double dRdS;
+        const double f =
+          z - z0 + dtg * bedErode->DetachRate( cn, ( z - zd ) / len, dRdS );
+        if( f > 0.0 ) hi = z;
+        else lo = z;
+        double znew = z - f / ( 1.0 + dtg * dRdS / len );
+        if( !( znew >= lo && znew <= hi ) ) znew = 0.5 * ( lo + hi );
+        dz = znew - z;
+        z = znew;
+        if( ++iter > kMaxIter )
+          ReportFatalError( "No convergence in ErodeDetachLimImplicit()" );
+      } while( fabs( dz ) > tol );
+      cn->setDrDt( ( z - z0 ) / dtg );
+    }
+    cn->setDzDt( ( z - z0 ) / dtg );
+    valgrd[0] = z - z0;
+    cn->EroDep( 0, valgrd, 0. );
+  }
+
+}//end tErosion::ErodeDetachLimImplicit
+
+
 /*****************************************************************************\
  **
  **  tErosion::StreamErode
@@ -4229,7 +4896,6 @@ void tErosion::StreamErode( double dtg, tStreamNet *strmNet )
   dtmax;         // time increment: initialize to arbitrary large val
   double frac = 0.3; // fraction of time to zero slope
   tLNode * cn, *dn;
-  tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() );
   double ratediff,  // Difference in ero/dep rate btwn node & its downstrm nbr
   cap,          // Transport capacity
   pedr,         // Potential erosion/deposition rate
@@ -4238,28 +4904,38 @@ void tErosion::StreamErode( double dtg, tStreamNet *strmNet )
   dzr;          // Potential depth of bedrock erosion
   bool smallflag=false;
   int smallcount=0;
+  tLawBatch transBatch;  // nodes, for the batch version of the law
   
   std::cout << "tErosion::StreamErode\n";
   
   // Sort so that we always work in upstream to downstream order
   strmNet->SortNodesByNetOrder();
+  tNetOrderIter netIter( *strmNet );
   
   // Compute erosion and/or deposition until all of the elapsed time (dtg)
   // is used up
   do
   {
     // Zero out sed influx
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       cn->setQsin( 0.0 );
     
+    // Transport capacities of all nodes at once, if the law has a batch
+    // version (this also sets the nodes' Qs value)
+    transBatch.Clear();
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
+      transBatch.Add( cn, -1, 1.0 );
+    const bool transBatched = sedTrans->TransCapacity( transBatch );
+    
     // Compute erosion rates: when this block is done, the transport rate
     // (qs), influx (qsin), and deposition/erosion rate (dzdt) values are
     // set for each active node.
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    size_t k = 0;
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP(), ++k )
     {
       // Transport capacity and potential erosion/deposition rate
       // (this also sets the node's Qs value)
-      cap = sedTrans->TransCapacity( cn );
+      cap = transBatched ? transBatch.cap[k] : sedTrans->TransCapacity( cn );
       pedr = (cn->getQsin() - cap ) / cn->getVArea();
       //sediment input:
       if( cn == strmNet->getInletNodePtr() )
@@ -4284,7 +4960,7 @@ void tErosion::StreamErode( double dtg, tStreamNet *strmNet )
     //   for performance reasons: we avoid having to multiply every dt value
     //   by frac)
     dtmax = dtg/frac;
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
     {
       dn = cn->getDownstrmNbr();
       ratediff = dn->getDzDt() - cn->getDzDt(); // Are the pts converging?
@@ -4322,7 +4998,7 @@ void tErosion::StreamErode( double dtg, tStreamNet *strmNet )
     
     // Zero out sed influx again, because depending on bedrock-alluvial
     // interaction it may be modified; if inlet, give it strmNet->inlet.inSedLoad
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       cn->setQsin( 0.0 );
     //sediment input:
     if(strmNet->getInletNodePtrNC() != NULL)
@@ -4363,7 +5039,7 @@ void tErosion::StreamErode( double dtg, tStreamNet *strmNet )
     // to last very long.
     
     // Now do erosion/deposition by integrating rates over dtmax
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
     {
       // Depth of potential erosion due to excess transport capacity
       // Note: for multiple sizes, dz could be an array (1..NUMG),
@@ -4464,6 +5140,7 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
   
   // Sort so that we always work in upstream to downstream order
   strmNet->SortNodesByNetOrder();
+  tNetOrderIter netIter( *strmNet );
   strmNet->FindChanGeom();
   strmNet->FindHydrGeom();
   
@@ -4474,7 +5151,7 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
   {
     //std::cout<<"AT BEGINNING!"<<std::endl;
     // Zero out sed influx of all sizes
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() ){
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() ){
       //if(cn->getID()==93)
       //  std::cout<<"93 is active"<<std::endl;
       cn->setQsin(0.0); //totals are for ts calculation
@@ -4490,7 +5167,7 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
     // Compute erosion rates: when this block is done, the transport rates
     // (qsm), influx (qsinm), and deposition/erosion rate (dzdt) values are
     // set for each active node.
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
     {
       // Transport capacity and potential erosion/deposition rate
       // (this also sets the node's Qs value)
@@ -4577,7 +5254,7 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
     //   for performance reasons: we avoid having to multiply every dt value
     //   by frac)
     dtmax = dtg/frac;
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
     {
       dn = cn->getDownstrmNbr();
       ratediff = dn->getDzDt() - cn->getDzDt(); // Are the pts converging?
@@ -4606,7 +5283,7 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
     
     // Zero out sed influx again, because depending on bedrock-alluvial
     // interaction it may be modified; if inlet, give it strmNet->inlet.inSedLoad
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() ){
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() ){
       cn->setQsin(0.0);
       cn->setQsin( sedzero );
     }
@@ -4652,7 +5329,7 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
     
     timegb += dtmax;
     // Now do erosion/deposition by integrating rates over dtmax
-    for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+    for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
     {
       // Depth of potential erosion due to excess transport capacity
       dzt=0.;
@@ -4759,6 +5436,23 @@ void tErosion::StreamErodeMulti( double dtg, tStreamNet *strmNet, double time )
  **  if the stream has the capacity to carry it. Handles multiple grain
  **  sizes. Replaces StreamErode and StreamErodeMulti.
  **
+ **  The nodes are taken in upstream to downstream order, with time steps
+ **  limited by the time to flattening of the steepest converging pair of
+ **  nodes (see DetachErodeNodes). With OPT_PARALLEL_BASINS, each drainage
+ **  basin (see tStreamNet::SortNodesByBasin) is done separately, with its
+ **  own time steps, and the basins are shared out among the threads (see
+ **  tThreadPool.h). Basins do not exchange sediment, so a basin comes out
+ **  the same as it would in a run on that basin alone, whatever the number
+ **  of threads. (This is not done when sediment is tracked at nodes, as
+ **  the tracker adds up volumes over the whole mesh at each time step.)
+ **  The basins only meet again at the end of the storm, where the outflux
+ **  of each outlet is its mean over the storm. A line is then written to
+ **  the .dtsub file with the time, dtg, the number of basins, the largest
+ **  number of time steps taken in a basin, the volume sent to the
+ **  outlets, the mass balance error (the sum over the basins, except the
+ **  one with the inlet, of |change in volume + volume out|), and the
+ **  number of nodes whose basins took 1, 2-3, 4-7, 8-15, ... steps.
+ **
  \************************************************************************/
 
 void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
@@ -4767,6 +5461,118 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
     //Added 4/00, if there is no runoff, this would crash, so check
   if(strmNet->getRainRate()-strmNet->getInfilt()>0){
     
+    // Sort so that we always work in upstream to downstream order
+    strmNet->SortNodesByNetOrder();
+    strmNet->FindChanGeom();
+    strmNet->FindHydrGeom();
+    
+    if( optParallelBasins && !track_sed_flux_at_nodes_ )
+    {
+      // Start with the largest basins, so that the threads finish together
+      strmNet->SortNodesByBasin();
+      std::vector< int > basins( strmNet->getNumBasins() );
+      for( size_t b=0; b<basins.size(); ++b )
+        basins[b] = static_cast<int>(b);
+      std::stable_sort( basins.begin(), basins.end(),
+                        [strmNet]( int a, int b ) {
+        return strmNet->getBasinStart( a+1 ) - strmNet->getBasinStart( a )
+        > strmNet->getBasinStart( b+1 ) - strmNet->getBasinStart( b );
+      } );
+      
+      // The outlets collect the mean outflux over the storm
+      const tArray< double > sedzero( num_grain_sizes_ );
+      tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() );
+      for( tLNode *cn=ni.FirstBoundaryP(); !( ni.AtEnd() ); cn=ni.NextP() )
+      {
+        cn->setQsin( 0.0 );
+        cn->setQsin( sedzero );
+      }
+      
+      // Volume of a basin above datum; tells whether it has the inlet,
+      // where the elevation is set rather than eroded
+      const tLNode *inletNode = strmNet->getInletNodePtrNC();
+      auto BasinVolume = [inletNode]( tNetOrderIter &netIter, bool &inlet ) {
+        double vol = 0.0;
+        inlet = false;
+        for( tLNode *cn = netIter.FirstP(); netIter.IsActive();
+             cn = netIter.NextP() )
+        {
+          vol += cn->getZ() * cn->getVArea();
+          if( cn==inletNode ) inlet = true;
+        }
+        return vol;
+      };
+      
+      const int nbasins = strmNet->getNumBasins();
+      std::vector< int > nSteps( nbasins );
+      std::vector< double > outVolume( nbasins, 0.0 ), volError( nbasins );
+      tThreadPool::ParallelFor( basins.size(), [&]( long k ) {
+        const int b = basins[k];
+        tNetOrderIter netIter( *strmNet, b );
+        bool inlet;
+        const double vol0 = BasinVolume( netIter, inlet );
+        nSteps[b] = DetachErodeNodes( dtg, strmNet, time, netIter,
+                                      &outVolume[b] );
+        volError[b] = inlet ? 0.0 :
+          fabs( BasinVolume( netIter, inlet ) - vol0 + outVolume[b] );
+      }, 1 );
+      
+      if( DtSub_fsPtr )
+      {
+        int maxSteps = 0;
+        double totalOut = 0.0, totalError = 0.0;
+        std::vector< int > nNodes;  // no. of nodes by log2( steps )
+        for( int b=0; b<nbasins; ++b )
+        {
+          maxSteps = std::max( maxSteps, nSteps[b] );
+          totalOut += outVolume[b];
+          totalError += volError[b];
+          size_t c = 0;
+          for( int n=nSteps[b]; n>1; n/=2 ) ++c;
+          if( nNodes.size()<=c ) nNodes.resize( c+1, 0 );
+          nNodes[c] += strmNet->getBasinStart( b+1 ) - strmNet->getBasinStart( b );
+        }
+        *DtSub_fsPtr << time << " " << dtg << " " << nbasins << " "
+                     << maxSteps << " " << totalOut << " " << totalError;
+        for( size_t c=0; c<nNodes.size(); ++c )
+          *DtSub_fsPtr << " " << nNodes[c];
+        *DtSub_fsPtr << std::endl;
+      }
+    }
+    else
+    {
+      tNetOrderIter netIter( *strmNet );
+      DetachErodeNodes( dtg, strmNet, time, netIter );
+    }
+  }//end if rainrate-infilt>0
+  
+  
+  if(0) std::cout<<"ending detach erode\n"<<std::flush;
+  
+}// End erosion algorithm
+
+
+/***********************************************************************\
+ **
+ **  tErosion::DetachErodeNodes
+ **
+ **  The erosion and deposition of DetachErode over the nodes visited by
+ **  netIter (upstream to downstream), for the time interval dtg. The
+ **  nodes must include every node they drain to: either all the active
+ **  nodes, or a drainage basin. Returns the number of time steps taken.
+ **
+ **  If outVolume is given, the Qsin of the boundary nodes that the nodes
+ **  drain to (which must be zero on entry) is set to the mean outflux
+ **  over dtg, rather than the sum of the rates of all the time steps, and
+ **  the volume sent to them is added to *outVolume.
+ **
+ \************************************************************************/
+
+int tErosion::DetachErodeNodes( double dtg, tStreamNet *strmNet,
+                                double time, tNetOrderIter &netIter,
+                                double *outVolume )
+{
+    const double dtgTotal = dtg;
     double dtmax;       // time increment: initialize to arbitrary large val
     double frac = 0.3;  //fraction of time to zero slope
     double timegb=time; //time gone by - for layering time purposes
@@ -4783,11 +5589,12 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
     tLNode * inletNode = strmNet->getInletNodePtrNC();
     double insedloadtotal = strmNet->getInSedLoad();
     int debugCount = 0;
+    tLawBatch transBatch, detachBatch;  // items of the laws, see below
     
     cn = ni.FirstP();
     
-    tArray <double> ret( cn->getNumg() ); //amt actually ero'd/dep'd
-    tArray <double> erolist( cn->getNumg() );
+    tGrainArray ret( cn->getNumg() ); //amt actually ero'd/dep'd
+    tGrainArray erolist( cn->getNumg() );
     const tArray <double> sedzero( cn->getNumg() );
     tArray <double> insed( strmNet->getInSedLoadm() );
     tArray <double> inletBedSizeFraction( strmNet->getInletSedSizeFraction() );  // TEMP 6/06: stores desired bed sed proportions at inlet
@@ -4807,11 +5614,6 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
     // Modify code to set erodibility of inlet node to zero, and compute sed influx before loop using call to 
     // TransCapacity. Assign these fluxes to insed ... etc.
     
-    // Sort so that we always work in upstream to downstream order
-    strmNet->SortNodesByNetOrder();
-    strmNet->FindChanGeom();
-    strmNet->FindHydrGeom();
-    
     // Compute erosion and/or deposition until all of the elapsed time (dtg)
     // is used up
     do
@@ -4819,7 +5621,7 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
       if(0) std::cout << "DetachErode: top of do loop\n" << std::flush;
       
       // Zero out sed influx of all sizes
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         if(0 && cn==inletNode ) std::cout<<"top loop ID="<<cn->getID()<<std::endl;
         cn->setQs(0.0);
@@ -4916,11 +5718,16 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
       // totals for time-step calculations, however transport
       // rates for each size are also set within the function call.
       if(0) std::cout << "DetachErode: estimating rates\n" << std::flush;
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      // Items of the transport law (each layer within the channel depth,
+      // and its weight) and of the detachment law (the layer on which
+      // detachment is based) at each node, for the batch versions of the
+      // laws.
+      transBatch.Clear();
+      detachBatch.Clear();
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         depck=0.;
         int i=0;
-        qs=0.;
         
         assert(cn->getChanDepth()<1000);
         
@@ -4930,30 +5737,33 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
           // of the transport capacity calculated from each
           // layer within the channel depth.
           // sediment and bedrock treated the same
-          // units on qs are l^3/t
-          if((depck+cn->getLayerDepth(i))<=cn->getChanDepth()){
-            //TransportCapacity function should keep running
-            //sum of qs of each grain size.
-            //qs returned is in m^3/yr; qs stored in tLNode has same units
-            qs += 
-            sedTrans->TransCapacity(cn,i,cn->getLayerDepth(i)
-                                    /cn->getChanDepth());
-            if(0&&cn==inletNode) 
-              std::cout<<"1depck="<<depck<<" qs="<<qs
-              <<"wt="<<cn->getLayerDepth(i)/cn->getChanDepth()
-              <<" qs/wt="<<qs/(cn->getLayerDepth(i)/cn->getChanDepth())
-              <<std::endl;
-          }
-          else{
-            qs += sedTrans->TransCapacity(cn,i,1-(depck/cn->getChanDepth()));
-            if(0&&cn==inletNode) 
-              std::cout<<"2depck="<<depck<<" qs="<<qs
-              <<" wt="<< 1-(depck/cn->getChanDepth())
-              << " qs/wt="<<qs/(depck/cn->getChanDepth())<<std::endl;
-          }
+          if((depck+cn->getLayerDepth(i))<=cn->getChanDepth())
+            transBatch.Add( cn, i, cn->getLayerDepth(i)/cn->getChanDepth() );
+          else
+            transBatch.Add( cn, i, 1-(depck/cn->getChanDepth()) );
           depck+=cn->getLayerDepth(i); //need to keep this here for qs calc
           i++;
 	      }
+        //which layer are you basing detach on?
+        detachBatch.Add( cn, (depck>cn->getChanDepth()) ? i-1 : i, 1.0 );
+      }
+      // Capacities and rates of all items at once, if the laws have a
+      // batch version (the rates after the capacities, as both set the
+      // nodes' shear stress); else node by node below.
+      const bool transBatched = sedTrans->TransCapacity( transBatch );
+      const bool detachBatched =
+        transBatched && bedErode->DetachCapacity( detachBatch );
+      size_t kc = 0, kd = 0;
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP(), ++kd )
+      {
+        qs=0.;
+        //TransportCapacity function should keep running
+        //sum of qs of each grain size.
+        //qs returned is in m^3/yr; qs stored in tLNode has same units
+        for( ; kc<transBatch.getSize() && transBatch.node[kc]==cn; ++kc )
+          qs += transBatched ? transBatch.cap[kc] :
+            sedTrans->TransCapacity( cn, transBatch.layer[kc],
+                                     transBatch.weight[kc] );
         
         //NIC this detachcapacity returns the correct thing, but
         //it also sets within the layer the drdt of each size.
@@ -4961,10 +5771,8 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
         //I don't think that will affect anything, just be careful of
         //using those values!!!
         
-        if(depck>cn->getChanDepth()) //which layer are you basing detach on?
-          drdt=-bedErode->DetachCapacity( cn, i-1 );
-        else
-          drdt=-bedErode->DetachCapacity( cn, i );//[m^3/yr]
+        drdt = -( detachBatched ? detachBatch.cap[kd] :
+                  bedErode->DetachCapacity( cn, detachBatch.layer[kd] ) );//[m^3/yr]
         
         //if( cn==inletNode ) drdt = -1e6;  // TEMP TEST
         
@@ -4979,7 +5787,10 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
         if( -drdt > excap ){
           cn->setDzDt(-excap);
         }
-        cn->getDownstrmNbr()->addQsin(cn->getQsin()-cn->getDzDt()*cn->getVArea());
+        // (with outVolume, outlets only get the actual outflux, below)
+        if( outVolume==0
+            || cn->getDownstrmNbr()->getBoundaryFlag()==kNonBoundary )
+          cn->getDownstrmNbr()->addQsin(cn->getQsin()-cn->getDzDt()*cn->getVArea());
         
         //std::cout << "*** EROSION ***\n";
         if( 0 && cn==inletNode ) {
@@ -4988,12 +5799,12 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
           //cn->TellAll();
         }
         
-      }//ends for( cn = ni.FirstP...
+      }//ends for( cn = netIter.FirstP...
       
       //Find local time-step based on dzdt
       if(0) std::cout << "DetachErode: finding time step size\n" << std::flush;
       dtmax = dtg/frac;
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         //Not for time step calculations, just utilizing loop
         if( cn!=inletNode )
@@ -5042,7 +5853,7 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
             }
           }
 	      }
-      }// End for( cn = ni.FirstP()..
+      }// End for( cn = netIter.FirstP()..
       dtmax *= frac;  // Take a fraction of time-to-flattening
       timegb+=dtmax;
       
@@ -5050,11 +5861,20 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
       
       // Do erosion/deposition
       if(0) std::cout << "DetachErode: eroding\n" << std::flush;
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         //need to recalculate cause qsin may change due to time step calc
         excap=(cn->getQs() - cn->getQsin())/cn->getVArea();
         
+        // With outVolume, the flux rates to an outlet are weighted by
+        // dtmax/dtg, so that the outlet's Qsin comes out as the mean
+        // outflux over the whole interval
+        dn = cn->getDownstrmNbr();
+        const bool toOutlet =
+          outVolume!=0 && dn->getBoundaryFlag()!=kNonBoundary;
+        const double outScale = toOutlet ? dtmax/dtgTotal : 1.0;
+        const double dnQsin0 = dn->getQsin();
+        
         //std::cout<<"actual erosion excap = "<<excap<<std::endl;
         //std::cout<<"drdt is "<<cn->getDrDt()<<std::endl;
         //again, excap pos if eroding, neg if depositing
@@ -5074,7 +5894,7 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
         }
         
         for(size_t i=0; i<cn->getNumg(); i++)
-          cn->getDownstrmNbr()->addQsin(i,cn->getQsin(i));
+          dn->addQsin(i,cn->getQsin(i)*outScale);
         //What goes downstream will be what comes in + what gets ero'd/dep'd
         //This should always be negative or zero since max amt
         //to deposit is what goes in.
@@ -5118,9 +5938,10 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
                 if( 0 && cn==inletNode ) std::cout<<"NO ero "<<dz<<" from lyr "<<i<<std::endl;
                 if( cn!=inletNode )  //TEMP 6/06
                 { 
-                  ret=cn->EroDep(i,erolist,timegb); //ORIGINAL
+                  ret=erolist; //ORIGINAL
+                  cn->EroDep(i,ret.getArrayPtr(),timegb); //ORIGINAL
                   for(size_t j=0;j<cn->getNumg();j++){ //ORIGINAL
-                    cn->getDownstrmNbr()->addQsin(j,-ret[j]*cn->getVArea()/dtmax); //ORIGINAL
+                    dn->addQsin(j,-ret[j]*cn->getVArea()/dtmax*outScale); //ORIGINAL
                   } //ORIGINAL
                 } //TEMP 6/06
                 dz=0.;
@@ -5145,10 +5966,11 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
                 if( 0 && cn==inletNode ) std::cout<<"NO Ero "<<erolist[0]<<"+"<<erolist[1]<<"="<<erolist[0]+erolist[1]<<" from lyr "<<i<<std::endl;
                 if( cn!=inletNode ) //TEMP 6/06
                 {
-                  ret=cn->EroDep(i,erolist,timegb);
+                  ret=erolist;
+                  cn->EroDep(i,ret.getArrayPtr(),timegb);
                   for(size_t j=0;j<cn->getNumg();j++){
                     //if * operator was overloaded for arrays, no loop necessary
-                    cn->getDownstrmNbr()->addQsin(j,-ret[j]*cn->getVArea()/dtmax);
+                    dn->addQsin(j,-ret[j]*cn->getVArea()/dtmax*outScale);
                   }
                 }
                 if(flag){
@@ -5173,11 +5995,12 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
               if( 0 && cn==inletNode ) std::cout<<"NO depck="<<depck<<" numLayer="<<flag<<" i="<<i<<std::endl;
               if( cn!=inletNode)  // JUNE 06 TEMP HACK: DON"T ERODE INLET!
               {
-                ret=cn->EroDep(i,erolist,timegb);
+                ret=erolist;
+                cn->EroDep(i,ret.getArrayPtr(),timegb);
                 //if( 1 && cn==inletNode ) std::cout<<"ret0="<<ret[0]<<" ret1="<<ret[1]<<std::endl;
                 double sum=0.;
                 for(size_t j=0;j<cn->getNumg();j++){
-                  cn->getDownstrmNbr()->addQsin(j,-ret[j]*cn->getVArea()/dtmax);
+                  dn->addQsin(j,-ret[j]*cn->getVArea()/dtmax*outScale);
                   erolist[j]-=ret[j];
                   sum+=erolist[j];
                 }
@@ -5199,16 +6022,20 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
           if(0 && cn==inletNode ) std::cout<<"NOT about to erodep inlet\n";
           if( cn!=inletNode ) //CLAUSE ADDED TEMP 6/06 (INTERIOR IS ORIGINAL)
           {
-            ret=cn->EroDep(0,erolist,timegb);
+            ret=erolist;
+            cn->EroDep(0,ret.getArrayPtr(),timegb);
             for(size_t j=0;j<cn->getNumg();j++){
-              cn->getDownstrmNbr()->addQsin(j,-ret[j]*cn->getVArea()/dtmax);
+              dn->addQsin(j,-ret[j]*cn->getVArea()/dtmax*outScale);
             }
           }
 	      }
         
+        if( toOutlet )
+          *outVolume += ( dn->getQsin() - dnQsin0 ) * dtgTotal;
+        
         if( 0 && cn==inletNode ) std::cout<<"end of node FOR loop\n";
         
-      } // Ends for( cn = ni.FirstP()...
+      } // Ends for( cn = netIter.FirstP()...
       
       if( track_sed_flux_at_nodes_ )
       {
@@ -5237,12 +6064,9 @@ void tErosion::DetachErode(double dtg, tStreamNet *strmNet, double time,
       
       //std::cout<<"Time remaining now "<<dtg<<std::endl;
     } while( dtg>1e-6 );  //Keep going until we've used up the whole time intrvl
-  }//end if rainrate-infilt>0
-  
-  
-  if(0) std::cout<<"ending detach erode\n"<<std::flush;
-  
-}// End erosion algorithm
+    
+    return debugCount;
+}
 
 /***********************************************************************\
  **
@@ -5291,13 +6115,14 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
     
     cn = ni.FirstP();
     
-    tArray <double> ret( cn->getNumg() ); //amt actually ero'd/dep'd
-    tArray <double> erolist( cn->getNumg() );
+    tGrainArray ret( cn->getNumg() ); //amt actually ero'd/dep'd
+    tGrainArray erolist( cn->getNumg() );
     const tArray <double> sedzero( cn->getNumg() );
     tArray <double> insed( strmNet->getInSedLoadm() );
     
     // Sort so that we always work in upstream to downstream order
     strmNet->SortNodesByNetOrder();
+    tNetOrderIter netIter( *strmNet );
     strmNet->FindChanGeom();
     strmNet->FindHydrGeom();
     
@@ -5307,7 +6132,7 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
     do
     {
       // Zero out sed influx of all sizes
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         cn->setQs(0.0);
         if( cn!=inletNode )
@@ -5334,7 +6159,7 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
       // NOTE - in this first loop we are only dealing with
       // totals for time-step calculations, however transport
       // rates for each size are also set within the function call.
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         depck=0;
         int i=0;
@@ -5386,11 +6211,11 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
         //cn->getDownstrmNbr()->addQsin(cn->getQsin()-cn->getDzDt()*cn->getVArea());
         cn->getDownstrmNbr()->addQsin(cn->getQsin()+cn->getQsdin()-cn->getDzDt()*cn->getVArea());
         
-      }//ends for( cn = ni.FirstP...
+      }//ends for( cn = netIter.FirstP...
       
       //Find local time-step based on dzdt
       dtmax = dtg/frac;
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         //Not for time step calculations, just utilizing loop
         if( cn!=inletNode )
@@ -5435,14 +6260,14 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
             }
           }
         }
-      }// End for( cn = ni.FirstP()..
+      }// End for( cn = netIter.FirstP()..
       dtmax *= frac;  // Take a fraction of time-to-flattening
       timegb+=dtmax;
       
       //At this point: we have drdt and qs for each node, plus dtmax
       
       // Do erosion/deposition
-      for( cn = ni.FirstP(); ni.IsActive(); cn = ni.NextP() )
+      for( cn = netIter.FirstP(); netIter.IsActive(); cn = netIter.NextP() )
       {
         //need to recalculate cause qsin may change due to time step calc
         //excap=(cn->getQs() - cn->getQsin())/cn->getVArea();
@@ -5490,7 +6315,8 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
                     cn->setQs(j,0.0);
                   }
                 }
-                ret=cn->EroDep(i,erolist,timegb);
+                ret=erolist;
+                cn->EroDep(i,ret.getArrayPtr(),timegb);
                 for(size_t j=0;j<cn->getNumg();j++){
                   cn->getDownstrmNbr()->addQsin(j,-ret[j]*cn->getVArea()/dtmax);
                 }
@@ -5515,7 +6341,8 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
                   }
                   dz-=erolist[j];
                 }
-                ret=cn->EroDep(i,erolist,timegb);
+                ret=erolist;
+                cn->EroDep(i,ret.getArrayPtr(),timegb);
                 for(size_t j=0;j<cn->getNumg();j++){
                   //if * operator was overloaded for arrays, no loop necessary
                   cn->getDownstrmNbr()->addQsin(j,-ret[j]*cn->getVArea()/dtmax);
@@ -5543,7 +6370,8 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
             while(depck<cn->getChanDepth()){
               depck+=cn->getLayerDepth(i);
               flag=cn->getNumLayer();
-              ret=cn->EroDep(i,erolist,timegb);
+              ret=erolist;
+              cn->EroDep(i,ret.getArrayPtr(),timegb);
               double sum=0;
               for(size_t j=0;j<cn->getNumg();j++){
                 //here you are sending downstream the amount that was eroded
@@ -5564,7 +6392,8 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
           //Get texture of stuff to be deposited
           for(size_t j=0;j<cn->getNumg();j++)
             erolist[j]=(beta*(cn->getQsin(j))-cn->getQs(j))*dtmax/cn->getVArea();
-          ret=cn->EroDep(0,erolist,timegb);
+          ret=erolist;
+          cn->EroDep(0,ret.getArrayPtr(),timegb);
           for(size_t j=0;j<cn->getNumg();j++){
             //send upstream material down, minus the amount that was deposited
             cn->getDownstrmNbr()->addQsin(j,cn->getQsin(j)-(ret[j]*cn->getVArea()/dtmax));
@@ -5577,7 +6406,7 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
         //A bit of a cheat since it might be over capacity, but just assume that
         //diffusive amount is relatively small
         //also, no grain size accounting for diffusive material
-      } // Ends for( cn = ni.FirstP()...
+      } // Ends for( cn = netIter.FirstP()...
       
       // Erode vegetation
 #if 0
@@ -5630,12 +6459,25 @@ void tErosion::DetachErode2(double dtg, tStreamNet *strmNet, double time,
  **  Modifies:  node elevations (z); node Qsin (sed influx) is reset and
  **             used in the computations
  **  Notes:  as of 3/98, does not differentiate between rock and sediment
+ **   - hands over to DiffuseImplicit if OPT_IMPLICIT_DIFFUSION is set
+ **   - hands over to DiffuseMeshArrays if OPT_MESH_ARRAYS is set
  **
  \*****************************************************************************/
 //#define kVerySmall 1e-6
 #define kEpsOver2 0.1
 void tErosion::Diffuse( double rt, bool noDepoFlag, double time )
 {
+  if( optImplicitDiffusion )
+  {
+    DiffuseImplicit( rt, noDepoFlag, time );
+    return;
+  }
+  if( meshPtr->getMeshArrays() )
+  {
+    DiffuseMeshArrays( rt, noDepoFlag, time );
+    return;
+  }
+
   tLNode * cn;
   tEdge * ce;
   double volout,  // Sediment volume output from a node (neg=input)
@@ -5763,6 +6605,437 @@ void tErosion::Diffuse( double rt, bool noDepoFlag, double time )
 }
 #undef kEpsOver2
 
+/*****************************************************************************\
+ **
+ **  tErosion::DiffuseMeshArrays
+ **
+ **  Version of Diffuse that sweeps the contiguous copy of the mesh
+ **  geometry (tMeshArrays) rather than the node and edge lists, used when
+ **  the option OPT_MESH_ARRAYS is set. The sub-steps and fluxes are the
+ **  same as in Diffuse, and so are the results; only the per-edge part of
+ **  each sub-step is moved to the arrays, the erosion or deposition at
+ **  each node still going through tLNode::EroDep so that layers are kept.
+ **
+ **  Inputs:  rt -- time duration over which to compute diffusion
+ **           noDepoFlag -- if true, material is only eroded, never
+ **                         deposited
+ **           time -- runtime, for updating layers (needed by EroDep)
+ **  Modifies:  as Diffuse
+ **
+ \*****************************************************************************/
+#define kEpsOver2 0.1
+void tErosion::DiffuseMeshArrays( double rt, bool noDepoFlag, double time )
+{
+  tMeshArrays &ma = *meshPtr->getMeshArrays();
+  const int nNodes = ma.nActiveNodes, nEdges = ma.nActiveEdges;
+  static tArray<double> deposition_depth( 1 );
+
+  kd = kd_ts.calc( time );
+  if( kd==0 ) return;
+
+  ma.LoadZ();
+  for( int i=0; i<nNodes; ++i )
+    static_cast<tLNode *>(ma.node[i])->setQsdin( 0. );
+
+  // Compute maximum stable time-step size based on Courant condition,
+  // and find the edges that carry no flux because their origin is above
+  // the diffusion threshold
+  double dtmax = rt;
+  std::vector<bool> noFlux( nEdges, false );
+  for( int k=0; k<nEdges; k+=2 )
+  {
+    const double delt = kEpsOver2 * ma.length[k]*ma.length[k] / kd;
+    if( delt < dtmax ) dtmax = delt;
+    if( difThresh>0.0 &&
+        static_cast<tLNode *>(ma.node[ma.org[k]])->getDrArea()>difThresh )
+      noFlux[k] = true;
+  }
+
+  // Net sediment input of each node; boundary nodes keep what they had,
+  // as in Diffuse
+  std::vector<double> qsin( ma.getNumNodes() );
+  for( int i=nNodes; i<ma.getNumNodes(); ++i )
+    qsin[i] = static_cast<tLNode *>(ma.node[i])->getQsin();
+
+  // Loop until we've used up the entire time interval rt
+  do
+  {
+    std::fill( qsin.begin(), qsin.begin()+nNodes, 0.0 );
+
+    // Compute sediment volume transfer along each edge
+    for( int k=0; k<nEdges; k+=2 )
+    {
+      ma.slope[k] = ( ma.z[ma.org[k]] - ma.z[ma.dest[k]] ) / ma.length[k];
+      double volout = kd*ma.slope[k]*ma.vedglen[k]*dtmax;
+      if( noFlux[k] ) volout = 0;
+      qsin[ma.org[k]] -= volout;
+      qsin[ma.dest[k]] += volout;
+    }
+
+    // Compute erosion/deposition for each node
+    for( int i=0; i<nNodes; ++i )
+    {
+      tLNode *cn = static_cast<tLNode *>(ma.node[i]);
+      if( noDepoFlag && qsin[i] > 0.0 )
+        qsin[i] = 0.0;
+      cn->setQsin( qsin[i] );
+      deposition_depth[0] = qsin[i] / ma.varea[i];
+      cn->EroDep( 0, deposition_depth, time );  // add or subtract net flux/area
+      ma.z[i] = cn->getZ();
+      cn->getDownstrmNbr()->addQsdin(-1 * qsin[i]/dtmax);
+    }
+
+    rt -= dtmax;
+    if( dtmax>rt ) dtmax=rt;
+  } while( rt>0.0 );
+
+  // Leave the slopes and boundary inputs on the mesh, as Diffuse does
+  for( int k=0; k<nEdges; k+=2 )
+    ma.edge[k]->setSlope( ma.slope[k] );
+  for( int i=nNodes; i<ma.getNumNodes(); ++i )
+    static_cast<tLNode *>(ma.node[i])->setQsin( qsin[i] );
+}
+#undef kEpsOver2
+
+
+/*****************************************************************************\
+ **
+ **  tErosion::DiffuseImplicit
+ **
+ **  Implicit alternative to Diffuse and DiffuseNonlinear, selected with
+ **  the option OPT_IMPLICIT_DIFFUSION. The fluxes are the same as in those
+ **  functions, Fv = Kd * S * Lv across each Voronoi cell face, or
+ **  Fv = Kd * S / ( 1 - (S/Sc)^2 ) * Lv if nonlinear, but the elevation
+ **  change over the whole interval rt is found in a single backward-Euler
+ **  step by DiffuseImplicitSolve, so the Courant-limited sub-steps of the
+ **  explicit functions are not needed. (Backward Euler is used rather than
+ **  Crank-Nicolson because the latter oscillates when rt is much larger
+ **  than the explicit limit.)
+ **
+ **  As in Diffuse, there is no exchange along edges whose origin drains an
+ **  area larger than difThresh. With noDepoFlag, nodes that would gain
+ **  material are held at their old elevation.
+ **
+ **  Inputs:  rt -- time duration over which to compute diffusion
+ **           noDepoFlag -- if true, material is only eroded, never
+ **                             deposited
+ **           nonlinear -- if true, use the nonlinear creep law of
+ **                        DiffuseNonlinear
+ **  Modifies:  node elevations (z); node Qsin is set to the net volume
+ **             gained over rt, and Qsdin of each node's downstream
+ **             neighbor to the corresponding rate
+ **
+ \*****************************************************************************/
+void tErosion::DiffuseImplicit( double rt, bool noDepoFlag, double time,
+                                bool nonlinear )
+{
+  tLNode * cn;
+  tEdge * ce;
+  tMesh< tLNode >::nodeListIter_t nodIter( meshPtr->getNodeList() );
+  tMesh< tLNode >::edgeListIter_t edgIter( meshPtr->getEdgeList() );
+  static tArray<double> deposition_depth( 1 );
+
+  kd = kd_ts.calc( time );
+  if(0) std::cout << "kd = " << kd << std::endl;
+
+  if( kd==0 || rt<=0.0 ) return;
+
+  int maxEdgeID = -1;
+  for( ce=edgIter.FirstP(); !( edgIter.AtEnd() ); ce=edgIter.NextP() )
+    if( ce->getID() > maxEdgeID ) maxEdgeID = ce->getID();
+
+  // Exchange coefficient Kd Lv/Le of each edge, by ID (zero if none)
+  std::vector< double > cond( maxEdgeID+1, 0.0 );
+  for( ce=edgIter.FirstP(); edgIter.IsActive(); ce=edgIter.NextP() )
+  {
+    cn = static_cast<tLNode *>(ce->getOriginPtrNC());
+    const double c = ( difThresh>0.0 && cn->getDrArea()>difThresh ) ?
+      0.0 : kd * ce->getVEdgLen() / ce->getLength();
+    cond[ ce->getID() ] = c;
+    ce = edgIter.NextP();  // complementary edge
+    cond[ ce->getID() ] = c;
+  }
+
+  std::vector< double > dz;
+  DiffuseImplicitSolve( rt, cond, nonlinear, noDepoFlag,
+                        std::vector< double >(), dz, time );
+
+  for( cn=nodIter.FirstP(); nodIter.IsActive(); cn=nodIter.NextP() )
+  {
+    cn->setQsdin( 0. );
+    cn->setQsin( dz[ cn->getID() ] * cn->getVArea() );
+  }
+
+  // Compute erosion/deposition for each node
+  for( cn=nodIter.FirstP(); nodIter.IsActive(); cn=nodIter.NextP() )
+  {
+    deposition_depth[0] = cn->getQsin() / cn->getVArea();
+    cn->EroDep( 0, deposition_depth, time );  // add or subtract net flux/area
+    cn->getDownstrmNbr()->addQsdin( -1 * cn->getQsin()/rt );
+  }
+
+}
+
+
+/*****************************************************************************\
+ **
+ **  tErosion::DiffuseImplicitSolve
+ **
+ **  Finds the elevation change dz of each node over an interval rt of
+ **  hillslope transport by a backward-Euler step, for DiffuseImplicit and
+ **  DiffuseNonlinearDepthDepImplicit. The volume flux from a node i to a
+ **  neighbor j is
+ **
+ **    Q_ij = c_ij ( z_i - z_j )                      (linear), or
+ **    Q_ij = c_ij ( z_i - z_j ) / ( 1 - (S_ij/Sc)^2 ) (nonlinear),
+ **
+ **  where c_ij is the exchange coefficient of the edge (passed in cond, by
+ **  edge ID) and S_ij = ( z_i - z_j )/Le. Where S/Sc is above
+ **  kMaxSlopeRatio, the nonlinear flux is continued along its tangent at
+ **  that ratio. (DiffuseNonlinear instead holds the denominator at its
+ **  value there, but the jump in the derivative that this causes keeps
+ **  Newton's method from converging; the tangent also keeps slopes closer
+ **  to Sc.) The elevation changes must satisfy, for each active node i,
+ **
+ **    R_i = Av_i dz_i + rt Sum_j Q_ij( z + dz ) = 0
+ **
+ **  with dz = 0 at boundary nodes. This is solved by Newton's method from
+ **  dz = 0: each iteration solves J ddz = -R for the correction ddz, where
+ **  the Jacobian J is symmetric and positive definite, by the
+ **  preconditioned conjugate gradient method (tSparseMatrix::SolvePCG).
+ **  The pattern of J is assembled once, along with copies of the edge
+ **  data it needs, and only its values are updated from one iteration to
+ **  the next. Iteration stops when |R_i|/Av_i is less than kTol at every
+ **  node, which in the linear case takes a single solution. If that has
+ **  not happened within kMaxIter iterations, the step is halved and the
+ **  interval taken in sub-steps of that size.
+ **
+ **  With noDepoFlag, nodes that would gain material are held at their old
+ **  elevation, and if minDz is not empty, nodes whose dz would be less
+ **  than minDz (by node ID) are held at that value; after each solution,
+ **  any new such nodes are held and the rest solved for again.
+ **
+ **  For each call, the time, rt, and the number of sub-steps, Newton
+ **  iterations and conjugate gradient iterations, and the largest final
+ **  |R_i|/Av_i, are written to the .difit file.
+ **
+ **  Inputs:  rt -- time duration over which to compute diffusion
+ **           cond -- exchange coefficient c_ij of each edge, by ID
+ **           nonlinear -- if true, use the nonlinear flux law
+ **           noDepoFlag -- if true, material is only eroded, never
+ **                         deposited
+ **           minDz -- least dz allowed at each node, by ID (or empty)
+ **           time -- current time (for the .difit file)
+ **  Returns:  dz -- elevation change of each node over rt, by ID
+ **
+ \*****************************************************************************/
+void tErosion::DiffuseImplicitSolve( double rt, const std::vector<double> &cond,
+                                     bool nonlinear, bool noDepoFlag,
+                                     const std::vector<double> &minDz,
+                                     std::vector<double> &dz, double time )
+{
+  const double kTol = 1e-6;     // largest residual allowed, as depth (m)
+  const double kPCGTol = 1e-10; // PCG tolerance, relative to norm of rhs
+  const int kMaxIter = 20;      // Newton iterations before halving the step
+  const int kMaxHalvings = 30;
+  const double kMaxSlopeRatio = 0.999; // as in DiffuseNonlinear
+  // flux / c_ij and its derivative at S/Sc = kMaxSlopeRatio, per Le Sc
+  const double kFluxAtMax = kMaxSlopeRatio /
+    ( 1.0 - kMaxSlopeRatio*kMaxSlopeRatio );
+  const double kDerivAtMax = ( 1.0 + kMaxSlopeRatio*kMaxSlopeRatio ) /
+    ( ( 1.0 - kMaxSlopeRatio*kMaxSlopeRatio ) *
+      ( 1.0 - kMaxSlopeRatio*kMaxSlopeRatio ) );
+  tLNode * cn;
+  tEdge * ce;
+  tMesh< tLNode >::nodeListIter_t nodIter( meshPtr->getNodeList() );
+
+  int maxNodeID = -1;
+  for( cn=nodIter.FirstP(); !( nodIter.AtEnd() ); cn=nodIter.NextP() )
+    if( cn->getID() > maxNodeID ) maxNodeID = cn->getID();
+
+  // Elevation of each node at the start of the current step, by ID
+  std::vector< double > z( maxNodeID+1 );
+  for( cn=nodIter.FirstP(); !( nodIter.AtEnd() ); cn=nodIter.NextP() )
+    z[ cn->getID() ] = cn->getZ();
+  std::vector< tLNode * > activeNodes;
+  for( cn=nodIter.FirstP(); nodIter.IsActive(); cn=nodIter.NextP() )
+    activeNodes.push_back( cn );
+
+  dz.assign( maxNodeID+1, 0.0 );
+  std::vector< double > dzStep( maxNodeID+1 ); // dz over the current step
+  std::vector< bool > held( maxNodeID+1 );
+  std::vector< int > row( maxNodeID+1 );       // row of each free node, or -1
+
+  // Jacobian; ID and Voronoi area of the node of each row; and for each
+  // row, the edges with exchange: their destination's ID, c_ij, Le Sc,
+  // and Jacobian entry (-1 if the destination is not free)
+  tSparseMatrix jacobian;
+  std::vector< int > freeID, diagEntry, rowEdgStart, edgNbr, edgEntry;
+  std::vector< double > freeArea, edgCond, edgLenSc;
+  int patternHeld = -1;  // no. of nodes held when jacobian was assembled
+  std::vector< double > res, ddz;
+
+  double tRemaining = rt, dt = rt, maxRes = 0.0;
+  int nSteps = 0, nHalvings = 0, nNewton = 0, nPCG = 0;
+  while( tRemaining > 0.0 )
+  {
+    if( dt > tRemaining ) dt = tRemaining;
+    std::fill( dzStep.begin(), dzStep.end(), 0.0 );
+    std::fill( held.begin(), held.end(), false );
+    int nHeld = 0, nNewlyHeld;
+    bool converged;
+    do
+    {
+      if( patternHeld != nHeld )
+      {
+        // Assemble the pattern of the Jacobian for the free nodes
+        freeID.clear();
+        freeArea.clear();
+        std::fill( row.begin(), row.end(), -1 );
+        for( size_t i=0; i<activeNodes.size(); ++i )
+          if( !held[ activeNodes[i]->getID() ] )
+          {
+            row[ activeNodes[i]->getID() ] = static_cast<int>(freeID.size());
+            freeID.push_back( activeNodes[i]->getID() );
+            freeArea.push_back( activeNodes[i]->getVArea() );
+          }
+        jacobian.Clear();
+        edgNbr.clear();
+        edgCond.clear();
+        edgLenSc.clear();
+        edgEntry.clear();
+        rowEdgStart.assign( 1, 0 );
+        diagEntry.resize( freeID.size() );
+        for( size_t i=0, k=0; i<activeNodes.size(); ++i )
+        {
+          cn = activeNodes[i];
+          if( held[ cn->getID() ] ) continue;
+          ce = cn->getEdg();
+          do
+          {
+            if( cond[ ce->getID() ] > 0.0 )
+            {
+              const int j = row[ ce->getDestinationPtr()->getID() ];
+              edgNbr.push_back( ce->getDestinationPtr()->getID() );
+              edgCond.push_back( cond[ ce->getID() ] );
+              edgLenSc.push_back( nonlinear ? ce->getLength() * mdSc : 0.0 );
+              edgEntry.push_back( j>=0 ? jacobian.getNumEntries() : -1 );
+              if( j>=0 ) jacobian.AddEntry( j, 0.0 );
+            }
+          } while( ( ce=ce->getCCWEdg() ) != cn->getEdg() );
+          diagEntry[k] = jacobian.getNumEntries();
+          jacobian.AddEntry( static_cast<int>(k), 0.0 );
+          jacobian.EndRow();
+          rowEdgStart.push_back( static_cast<int>(edgNbr.size()) );
+          ++k;
+        }
+        patternHeld = nHeld;
+      }
+
+      // Newton iterations for dz of the free nodes
+      converged = false;
+      res.resize( freeID.size() );
+      for( int iter=0; ; ++iter )
+      {
+        // Residual and Jacobian at the current estimate
+        maxRes = 0.0;
+        for( size_t i=0; i<freeID.size(); ++i )
+        {
+          const double zi = z[ freeID[i] ] + dzStep[ freeID[i] ];
+          double r = freeArea[i] * dzStep[ freeID[i] ];
+          double diag = freeArea[i];
+          for( int k=rowEdgStart[i]; k<rowEdgStart[i+1]; ++k )
+          {
+            const double dzij = zi - z[ edgNbr[k] ] - dzStep[ edgNbr[k] ];
+            double q = dzij, dq = 1.0;  // Q_ij/c_ij and its derivative
+            if( nonlinear )
+            {
+              const double slopeRatio = dzij / edgLenSc[k];
+              if( fabs( slopeRatio ) > kMaxSlopeRatio )
+              {
+                dq = kDerivAtMax;
+                q = ( slopeRatio > 0.0 ? 1.0 : -1.0 ) *
+                  ( kFluxAtMax + kDerivAtMax *
+                    ( fabs( slopeRatio ) - kMaxSlopeRatio ) ) * edgLenSc[k];
+              }
+              else
+              {
+                const double f = 1.0 - slopeRatio*slopeRatio;
+                q = dzij / f;
+                dq = ( 2.0 - f ) / ( f * f );
+              }
+            }
+            const double c = dt * edgCond[k];
+            r += c * q;
+            diag += c * dq;
+            if( edgEntry[k] >= 0 )
+              jacobian.SetEntry( edgEntry[k], -c * dq );
+          }
+          jacobian.SetEntry( diagEntry[i], diag );
+          res[i] = -r;
+          if( fabs( r ) / freeArea[i] > maxRes )
+            maxRes = fabs( r ) / freeArea[i];
+        }
+        if( maxRes < kTol )
+        {
+          converged = true;
+          break;
+        }
+        if( iter == kMaxIter ) break;
+
+        ddz.assign( freeID.size(), 0.0 );
+        const int nIter =
+          jacobian.SolvePCG( res, ddz, kPCGTol, 2*jacobian.getNumRows()+100 );
+        if( nIter < 0 ) break;
+        nPCG += nIter;
+        ++nNewton;
+        for( size_t i=0; i<freeID.size(); ++i )
+          dzStep[ freeID[i] ] += ddz[i];
+      }
+      if( !converged ) break;
+
+      // Hold nodes that would gain material (if no deposition) or go
+      // below their least dz, and solve again for the rest
+      nNewlyHeld = 0;
+      for( size_t i=0; i<freeID.size(); ++i )
+      {
+        const int id = freeID[i];
+        if( noDepoFlag && dzStep[id] > 0.0 )
+          dzStep[id] = 0.0;
+        else if( !minDz.empty() && dz[id] + dzStep[id] < minDz[id] )
+          dzStep[id] = minDz[id] - dz[id];
+        else
+          continue;
+        held[id] = true;
+        ++nNewlyHeld;
+      }
+      nHeld += nNewlyHeld;
+    } while( nNewlyHeld > 0 );
+
+    if( converged )
+    {
+      for( size_t i=0; i<activeNodes.size(); ++i )
+      {
+        const int id = activeNodes[i]->getID();
+        dz[id] += dzStep[id];
+        z[id] += dzStep[id];
+      }
+      tRemaining -= dt;
+      ++nSteps;
+    }
+    else
+    {
+      if( ++nHalvings > kMaxHalvings )
+        ReportFatalError( "No convergence in DiffuseImplicitSolve()" );
+      dt *= 0.5;
+    }
+  }
+
+  if( ImpDif_fsPtr )
+    *ImpDif_fsPtr << time << " " << rt << " " << nSteps << " " << nNewton
+                  << " " << nPCG << " " << maxRes << std::endl;
+
+}
 
 
 #define kEpsOver2 0.1
@@ -5986,6 +7259,7 @@ void tErosion::DiffuseMultiSize( double rt, bool noDepoFlag, double time )
  **                             deposited
  **  Created: August 2007, GT
  **  Modifications:
+ **   - hands over to DiffuseImplicit if OPT_IMPLICIT_DIFFUSION is set
  ** 
  \*****************************************************************************/
 //#define kVerySmall 1e-6
@@ -5993,6 +7267,12 @@ void tErosion::DiffuseMultiSize( double rt, bool noDepoFlag, double time )
 #define kBeta 0.999    // Dz/Sc isn't allowed to go higher than this
 void tErosion::DiffuseNonlinear( double rt, bool noDepoFlag, double time )
 {
+  if( optImplicitDiffusion )
+  {
+    DiffuseImplicit( rt, noDepoFlag, time, true );
+    return;
+  }
+
   tLNode * cn;
   tEdge * ce;
   double volout,  // Sediment volume output from a node (neg=input)
@@ -6170,6 +7450,9 @@ void tErosion::DiffuseNonlinear( double rt, bool noDepoFlag, double time )
  **
  **  Created: July, 2010, SL
  **  Modifications:
+ **   - hands over to DiffuseNonlinearDepthDepImplicit if
+ **     OPT_IMPLICIT_DIFFUSION is set
+ **   - layer handling moved to EroDepTopLayers
  ** 
  \*****************************************************************************/
 #define kEpsOver2 0.1
@@ -6183,6 +7466,12 @@ void tErosion::DiffuseNonlinearDepthDep( double rt, double time )
   kd = kd_ts.calc( time );
   
   if( kd==0 ) return;
+
+  if( optImplicitDiffusion )
+  {
+    DiffuseNonlinearDepthDepImplicit( rt, time );
+    return;
+  }
   
   tLNode * cn;
   tEdge * ce;
@@ -6238,10 +7527,13 @@ void tErosion::DiffuseNonlinearDepthDep( double rt, double time )
       edgeH[k] = nodeSoilThickness;    
       edgeKd[k] = 
 	    kd * ( 1 - exp( -edgeH[k] * cos( atan( slope[k] ) ) / diffusionH ) );
-      // max. time step this edge:
-      delt = 
-	    kEpsOver2 * ce->getLength()*ce->getLength()*f[k]*sqrt(f[k]) / edgeKd[k];  
-      if( delt < dtmax ) dtmax = delt;  // remember the smallest delt
+      // max. time step this edge (no limit where there is no soil):
+      if( edgeKd[k] > 0.0 )
+      {
+        delt = 
+	      kEpsOver2 * ce->getLength()*ce->getLength()*f[k]*sqrt(f[k]) / edgeKd[k];  
+        if( delt < dtmax ) dtmax = delt;  // remember the smallest delt
+      }
       tempArrayIndex[ce->getID()] = k; // store index for this edge
       ce = edgIter.NextP();  // Skip complementary edge
       tempArrayIndex[ce->getID()] = k; // store index for complementary edge
@@ -6340,34 +7632,9 @@ void tErosion::DiffuseNonlinearDepthDep( double rt, double time )
     // change elevations, etc., in a separate loop, after done adjusting fluxes:
     for( cn=nodIter.FirstP(); nodIter.IsActive(); cn=nodIter.NextP() )
     {
-      tArray<double> erolist( cn->getNumg() );
       // elevation change is net flux per area:
-      double deltaZ = ( cn->getQs() + cn->getQsin() ) / cn->getVArea();
-      // add elevation change, and mind the layers:
-      if( deltaZ > 0.0 )
-	    {
-	      for( size_t j=0; j<cn->getNumg(); ++j )
-          erolist[j] = deltaZ * cn->getLayerDgrade(0,j)/cn->getLayerDepth(0);
-	      cn->EroDep( 0, erolist, time );  // add or subtract net flux/area    
-	    }
-      else if( deltaZ < 0.0 )
-        while( deltaZ < 0.0 )
-	      {
-          if( -deltaZ <= cn->getLayerDepth(0) )
-          {
-            for( size_t j=0; j<cn->getNumg(); ++j )
-              erolist[j] = 
-              deltaZ * cn->getLayerDgrade(0,j) / cn->getLayerDepth(0);
-            deltaZ = 0.0;
-          }
-          else
-          {
-            for( size_t j=0; j<cn->getNumg(); ++j )
-              erolist[j] = cn->getLayerDgrade(0,j);
-            deltaZ += cn->getLayerDepth(0);
-          }
-          cn->EroDep( 0, erolist, time );
-	      }
+      EroDepTopLayers( cn, ( cn->getQs() + cn->getQsin() ) / cn->getVArea(),
+                       time );
       cn->getDownstrmNbr()->addQsdin(-1 * cn->getQs()/dtmax);
       //this won't work if time steps are varying, because you are adding fluxes     
     }
@@ -6378,6 +7645,146 @@ void tErosion::DiffuseNonlinearDepthDep( double rt, double time )
 #undef kEpsOver2
 #undef kBeta
 
+
+/*****************************************************************************\
+ **
+ **  tErosion::DiffuseNonlinearDepthDepImplicit
+ **
+ **  Semi-implicit alternative to DiffuseNonlinearDepthDep, selected with
+ **  the option OPT_IMPLICIT_DIFFUSION. The depth-dependent transport
+ **  coefficient of each edge is found from the soil depth of its upslope
+ **  node and its slope at the start of the interval, as in the first
+ **  sub-step of DiffuseNonlinearDepthDep, and held fixed; the elevation
+ **  change over the whole interval rt is then found in one backward-Euler
+ **  step by DiffuseImplicitSolve, with the nonlinear creep law. Supply
+ **  limitation applies to the net loss from a node rather than to its
+ **  outflux: a node that would lose more than its soil thickness loses
+ **  just that thickness.
+ **
+ **  Inputs:  rt -- time duration over which to compute diffusion
+ **           time -- runtime, for updating layers (needed by EroDep)
+ **  Modifies:  node elevations and layers; node Qs and Qsin are set to
+ **             the net volume lost or gained over rt, and Qsdin of each
+ **             node's downstream neighbor to the rate of loss
+ **
+ \*****************************************************************************/
+void tErosion::DiffuseNonlinearDepthDepImplicit( double rt, double time )
+{
+  tLNode * cn;
+  tEdge * ce;
+  tMesh< tLNode >::nodeListIter_t nodIter( meshPtr->getNodeList() );
+  tMesh< tLNode >::edgeListIter_t edgIter( meshPtr->getEdgeList() );
+
+  kd = kd_ts.calc( time );
+  if( kd==0 || rt<=0.0 ) return;
+
+  int maxNodeID = -1, maxEdgeID = -1;
+  for( cn=nodIter.FirstP(); !( nodIter.AtEnd() ); cn=nodIter.NextP() )
+    if( cn->getID() > maxNodeID ) maxNodeID = cn->getID();
+  for( ce=edgIter.FirstP(); !( edgIter.AtEnd() ); ce=edgIter.NextP() )
+    if( ce->getID() > maxEdgeID ) maxEdgeID = ce->getID();
+
+  // Soil thickness of each node, which is the most it can lose
+  std::vector< double > soilThickness( maxNodeID+1, 0.0 );
+  std::vector< double > minDz( maxNodeID+1, 0.0 );
+  for( cn=nodIter.FirstP(); !( nodIter.AtEnd() ); cn=nodIter.NextP() )
+  {
+    double nodeSoilThickness(0.0);
+    tListIter< tLayer > lI( cn->getLayersRefNC() );
+    for( tLayer *lP=lI.FirstP(); lP->getSed() == tLayer::kSed; lP=lI.NextP() )
+      nodeSoilThickness += lP->getDepth();
+    soilThickness[ cn->getID() ] = nodeSoilThickness;
+    minDz[ cn->getID() ] = -nodeSoilThickness;
+  }
+
+  // Exchange coefficient Kd(h) Lv/Le of each edge, by ID (zero if none),
+  // using the soil thickness of the upslope endpoint
+  std::vector< double > cond( maxEdgeID+1, 0.0 );
+  for( ce=edgIter.FirstP(); edgIter.IsActive(); ce=edgIter.NextP() )
+  {
+    tLNode *on = static_cast<tLNode *>(ce->getOriginPtrNC());
+    tLNode *dn = static_cast<tLNode *>(ce->getDestinationPtrNC());
+    double c = 0.0;
+    if( !( difThresh > 0. && on->getDrArea() > difThresh ) )
+    {
+      const double slope = ce->CalcSlope();
+      cn = ( on->getZ() > dn->getZ() ) ? on : dn;
+      c = kd * ( 1 - exp( -soilThickness[ cn->getID() ] *
+                          cos( atan( slope ) ) / diffusionH ) )
+        * ce->getVEdgLen() / ce->getLength();
+    }
+    cond[ ce->getID() ] = c;
+    ce = edgIter.NextP();  // complementary edge
+    cond[ ce->getID() ] = c;
+  }
+
+  std::vector< double > dz;
+  DiffuseImplicitSolve( rt, cond, true, false, minDz, dz, time );
+
+  for( cn=nodIter.FirstP(); nodIter.IsActive(); cn=nodIter.NextP() )
+  {
+    cn->setQsdin( 0. );
+    const double vol = dz[ cn->getID() ] * cn->getVArea();
+    cn->setQs( vol < 0.0 ? vol : 0.0 );
+    cn->setQsin( vol > 0.0 ? vol : 0.0 );
+  }
+
+  // change elevations, etc.
+  for( cn=nodIter.FirstP(); nodIter.IsActive(); cn=nodIter.NextP() )
+  {
+    EroDepTopLayers( cn, dz[ cn->getID() ], time );
+    cn->getDownstrmNbr()->addQsdin( -1 * cn->getQs()/rt );
+  }
+}
+
+
+/*****************************************************************************\
+ **
+ **  tErosion::EroDepTopLayers
+ **
+ **  Changes the elevation of a node by deltaZ, minding the layers: if
+ **  deltaZ is positive, it is added to the top layer with the grain-size
+ **  proportions of that layer; if negative, it is removed from the top
+ **  layer down, one layer at a time, each with its own proportions.
+ **  (Moved from DiffuseNonlinearDepthDep, where the removal of a whole
+ **  layer had the wrong sign and deposited it instead.)
+ **
+ **  Inputs:  cn -- node
+ **           deltaZ -- elevation change
+ **           time -- runtime, for updating layers (needed by EroDep)
+ **  Called by: DiffuseNonlinearDepthDep, DiffuseNonlinearDepthDepImplicit
+ **
+ \*****************************************************************************/
+void tErosion::EroDepTopLayers( tLNode *cn, double deltaZ, double time )
+{
+  tArray<double> erolist( cn->getNumg() );
+  if( deltaZ > 0.0 )
+  {
+    for( size_t j=0; j<cn->getNumg(); ++j )
+      erolist[j] = deltaZ * cn->getLayerDgrade(0,j)/cn->getLayerDepth(0);
+    cn->EroDep( 0, erolist, time );  // add or subtract net flux/area
+  }
+  else if( deltaZ < 0.0 )
+    while( deltaZ < 0.0 )
+    {
+      if( -deltaZ <= cn->getLayerDepth(0) )
+      {
+        for( size_t j=0; j<cn->getNumg(); ++j )
+          erolist[j] =
+            deltaZ * cn->getLayerDgrade(0,j) / cn->getLayerDepth(0);
+        deltaZ = 0.0;
+      }
+      else
+      {
+        for( size_t j=0; j<cn->getNumg(); ++j )
+          erolist[j] = -cn->getLayerDgrade(0,j);
+        deltaZ += cn->getLayerDepth(0);
+      }
+      cn->EroDep( 0, erolist, time );
+    }
+}
+
+
 /***************************************************************************\
  **  tErosion::ProduceRegolith( double dtg, double time )
  **
@@ -6393,16 +7800,24 @@ void tErosion::DiffuseNonlinearDepthDep( double rt, double time )
  **      bedrock.
  **  Changes: Elevations and layers for active tLNodes.
  **
+ **  The rates of bedrock lowering are all found before any node is
+ **  changed, since the rate at a node depends on the slope to the node
+ **  downstream. Both steps are done in parallel (see tThreadPool.h).
+ **
  **  - STL, 6/2010
  \***************************************************************************/
 void tErosion::ProduceRegolith( double dtg, double time )
 {
-  tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() ); // node iter.
+  const std::vector< tLNode * > &nodes = meshPtr->getActiveNodePtrs();
+  // find rate of bedrock lowering at each active node:
+  std::vector< double > rates( nodes.size() );
+  tThreadPool::ParallelFor( nodes.size(), [&]( long k ) {
+    rates[k] = physWeath->SoilProduction( nodes[k] );
+  } );
   // do physical weathering for each active node:
-  for( tLNode* n = ni.FirstP(); ni.IsActive(); n = ni.NextP() )
-  {
-    // find rate of bedrock lowering:
-    double rate = physWeath->SoilProduction( n );
+  tThreadPool::ParallelFor( nodes.size(), [&]( long k ) {
+    tLNode *n = nodes[k];
+    const double rate = rates[k];
     if( rate < 0.0 ) // skip it all if no soil production
     {
       double rockDeltaZ = rate * dtg; // bedrock lowering
@@ -6483,7 +7898,7 @@ void tErosion::ProduceRegolith( double dtg, double time )
 	      soilP->setBulkDensity( soilBulkDensity );
 	    }
     } // end if( rate < 0.0 ) 
-  } // nodeList loop
+  } ); // node loop
 } // void tErosion::ProduceRegolith( double dtg, double time )
 
 /***************************************************************************\
@@ -66,6 +66,7 @@
 #ifndef EROSION_H
 #define EROSION_H
 
+#include <vector>
 #include "../Definitions.h"
 #include "../Classes.h"
 #include "../tArray/tArray.h"
@@ -125,6 +126,56 @@ private:
   double shortRate;
 };
 
+/***************************************************************************/
+/**
+ **  @class tLawBatch
+ **
+ **  A list of evaluations of a transport or detachment law at a range of
+ **  nodes, for the batch versions of the laws (tSedTrans::TransCapacity
+ **  and tBedErode::DetachCapacity with a tLawBatch). Each item is a node,
+ **  a layer (or -1 for the law without a layer, e.g. TransCapacity( n ))
+ **  and a weight (e.g. the layer's share of the channel depth).
+ **
+ **  A law's batch version copies the node values it needs into the arrays
+ **  (Gather functions), computes all the items in one loop over the
+ **  arrays, with no virtual calls or access to the nodes, and then makes
+ **  the same changes to the nodes, item by item, as its node by node
+ **  version would. Its results are those of the node by node version, to
+ **  the last bit. The arrays keep their memory from one use to the next.
+ */
+/***************************************************************************/
+class tLawBatch
+{
+public:
+  void Clear() { node.clear(); layer.clear(); weight.clear(); }
+  void Add( tLNode *n, int lyr, double wt )
+  { node.push_back( n ); layer.push_back( lyr ); weight.push_back( wt ); }
+  size_t getSize() const { return node.size(); }
+  // sizes the results (cap, tau, and capg for numg sizes)
+  void Start( size_t numg );
+  // copies Q, S, hydraulic width and flood status of the nodes
+  void GatherFlow();
+  // copies the fraction of each size in the items' layers (layer 0 for
+  // items without a layer)
+  void GatherTexture( size_t numg );
+  // copies the nodes' critical shear stress and the layers' erodibility
+  void GatherBed();
+
+  // items
+  std::vector< tLNode * > node;
+  std::vector< int > layer;
+  std::vector< double > weight;
+  // node and layer values
+  std::vector< double > Q, S, W; // discharge, slope, hydraulic width
+  std::vector< char > wet;       // 1 if not flooded
+  std::vector< double > frac;    // fraction of size g: frac[k*numg+g]
+  std::vector< double > tauc, erody;
+  // results
+  std::vector< double > tau;     // shear stress
+  std::vector< double > cap;     // transport capacity or detachment rate
+  std::vector< double > capg;    // capacity of size g: capg[k*numg+g]
+};
+
 /***************************************************************************/
 /**
  **  @class tSedTrans
@@ -138,6 +189,10 @@ public:
   virtual ~tSedTrans() {}
   virtual double TransCapacity( tLNode *n ) = 0;
   virtual double TransCapacity( tLNode *n, int i, double weight) = 0;
+  //Computes the capacities (b.cap) of all items of b, as TransCapacity(
+  //n, i, weight) or TransCapacity( n ) for each item in turn; returns
+  //false, without doing anything, if the law has no batch version
+  virtual bool TransCapacity( tLawBatch & /*b*/ ) { return false; }
   virtual void Initialize_Copy( tSedTrans* ) =0;
 };
 
@@ -159,6 +214,7 @@ public:
   tSedTransPwrLaw( const tSedTransPwrLaw & );
   double TransCapacity( tLNode * n );
   double TransCapacity( tLNode *n, int i, double weight);
+  bool TransCapacity( tLawBatch & );
   void Initialize_Copy( tSedTrans* );
 
 private:
@@ -168,6 +224,9 @@ private:
   double nf;  // Exponent on slope
   double pf;  // Excess shear exponent
   double tauc; // Entrainment threshold
+
+  // batch loop, for items with a layer (weighted) or without
+  template< bool kWeighted > void CapacityKernel( tLawBatch & ) const;
 };
 
 /***************************************************************************/
@@ -278,6 +337,7 @@ public:
   tSedTransPwrLawMulti( const tSedTransPwrLawMulti & );
   double TransCapacity( tLNode * n );
   double TransCapacity( tLNode *n, int lyr, double weight );
+  bool TransCapacity( tLawBatch & );
   void Initialize_Copy( tSedTrans* );
 
 private:
@@ -290,6 +350,8 @@ private:
   tArray<double> mdTauc; // Entrainment threshold
   int miNumgrnsizes;  // No. grain size classes
   double mdHidingexp; // Hiding/protrusion exponent
+
+  void CapacityKernel( tLawBatch & ) const;  // batch loop
 };
 
 
@@ -312,6 +374,7 @@ public:
   tSedTransWilcock( const tSedTransWilcock & );
   double TransCapacity( tLNode * n ); // returns total volumetric load
   double TransCapacity( tLNode *n, int i, double weight);
+  bool TransCapacity( tLawBatch & );
   void Initialize_Copy( tSedTrans* );
   //returns total volumetric load
   
@@ -328,7 +391,10 @@ private:
   double gravb;
   double gravs;
   tArray< double > grade;
-  
+
+  // batch loop, for sand only or sand and gravel
+  template< bool kTwoSizes >
+  void CapacityKernel( tLawBatch &, size_t numg ) const;
 };
 
 /************************************************************************/
@@ -411,8 +477,15 @@ public:
   virtual double DetachCapacity( tLNode * n, int i ) = 0 ;
   //Computes rate of erosion at node n
   virtual double DetachCapacity( tLNode * n ) = 0 ;
+  //Computes the rates (b.cap) of all items of b, as DetachCapacity( n, i )
+  //or DetachCapacity( n ) for each item in turn; returns false, without
+  //doing anything, if the law has no batch version
+  virtual bool DetachCapacity( tLawBatch & /*b*/ ) { return false; }
   //Returns an estimate of maximum stable & accurate time step size
   virtual double SetTimeStep( tLNode * n ) = 0 ;
+  //Computes rate of erosion at node n for a trial slope, and its
+  //derivative with respect to slope (for the implicit solver)
+  virtual double DetachRate( tLNode * n, double slp, double &dRdS );
   virtual void Initialize_Copy( tBedErode* ) =0;
 };
 
@@ -439,8 +512,12 @@ public:
   double DetachCapacity( tLNode * n, int i );
   //Computes rate of erosion at node n
   double DetachCapacity( tLNode * n );
+  //Computes the rates of all items of b
+  bool DetachCapacity( tLawBatch &b );
   //Returns an estimate of maximum stable & accurate time step size
   double SetTimeStep( tLNode * n );
+  //Computes rate of erosion at node n for a trial slope
+  double DetachRate( tLNode * n, double slp, double &dRdS );
   void Initialize_Copy( tBedErode* );
 
 private:
@@ -451,6 +528,8 @@ private:
   double nb;  // Exponent on slope
   double pb;  // Exponent on excess erosion capacity (e.g., shear stress)
   double taucd;  // Erosion threshold
+
+  void RateKernel( tLawBatch & ) const;  // batch loop
 };
 
 
@@ -484,6 +563,8 @@ public:
   double DetachCapacity( tLNode * n );
   //Returns an estimate of maximum stable & accurate time step size
   double SetTimeStep( tLNode * n );
+  //Computes rate of erosion at node n for a trial slope
+  double DetachRate( tLNode * n, double slp, double &dRdS );
   void Initialize_Copy( tBedErode* );
 
 private:
@@ -572,6 +653,8 @@ public:
    double DetachCapacity( tLNode * nd );
      //Does nothing but included in just in case it's needed in the future.
    double SetTimeStep( tLNode * nd );
+     //Computes rate of erosion at node n for a trial slope
+   double DetachRate( tLNode * nd, double slp, double &dRdS );
   void Initialize_Copy( tBedErode* );
 
   private:
@@ -603,6 +686,9 @@ public:
   double DetachCapacity( tLNode * ) {return 0.0;}
   //Returns an estimate of maximum stable & accurate time step size
   double SetTimeStep( tLNode * ) {return 0.0;}
+  //Computes rate of erosion at node n for a trial slope
+  double DetachRate( tLNode *, double, double &dRdS )
+  {dRdS = 0.0; return 0.0;}
   void Initialize_Copy( tBedErode* ) {}
 };
 
@@ -1238,14 +1324,18 @@ public:
    ~tErosion();
    void ErodeDetachLim( double dtg, tStreamNet *, tVegetation * );
    void ErodeDetachLim( double dtg, tStreamNet *, tUplift const * );
+   void ErodeDetachLimImplicit( double dtg, tStreamNet * );
    void StreamErode( double dtg, tStreamNet * );
    void StreamErodeMulti( double dtg, tStreamNet *, double time);
    void DetachErode( double dtg, tStreamNet *, double time, tVegetation * pVegetation );
    void DetachErode2( double dtg, tStreamNet *, double time, tVegetation * pVegetation );
    void Diffuse( double dtg, bool detach, double time );
+   void DiffuseImplicit( double dtg, bool detach, double time,
+                         bool nonlinear = false );
   void DiffuseMultiSize( double dtg, bool detach, double time );
    void DiffuseNonlinear( double dtg, bool detach, double time );
   void DiffuseNonlinearDepthDep( double dtg, double time );
+  void DiffuseNonlinearDepthDepImplicit( double dtg, double time );
   void ProduceRegolith( double dtg, double time );
   void WeatherBedrock( double dtg );
   void LandslideClusters( double rainrate, double time );
@@ -1258,6 +1348,9 @@ public:
   { track_sed_flux_at_nodes_ =true;  water_sed_tracker_ptr_ = 0; }
   void TurnOnOutput( const tInputFile& );
   void TurnOffOutput();
+  // save and restore the state that varies during a run (see tCheckpoint.h)
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
 
   tDF_RunOut* getDF_RunOutPtr() {return runout;}
   tDF_Scour* getDF_ScourPtr() {return scour;}
@@ -1271,6 +1364,15 @@ public:
   unsigned getNumGrainSizes() { return num_grain_sizes_; }
 
 private:
+  void DiffuseImplicitSolve( double dtg, const std::vector<double> &cond,
+                             bool nonlinear, bool detach,
+                             const std::vector<double> &minDz,
+                             std::vector<double> &dz, double time );
+  void DiffuseMeshArrays( double dtg, bool detach, double time );
+  void EroDepTopLayers( tLNode *, double dz, double time );
+  int DetachErodeNodes( double dtg, tStreamNet *, double time,
+                        tNetOrderIter &, double *outVolume = 0 );
+
   tMesh<tLNode> *meshPtr;    // ptr to mesh
   // pointers to objects governing rules for sediment transport:
   tBedErode *bedErode;        // bed erosion object
@@ -1284,6 +1386,8 @@ private:
   tDF_Deposit *deposit; // debris flow deposition object
   std::ofstream *DF_fsPtr; // pointer to output stream for debris flows
   std::ofstream *DF_Hyd_fsPtr; // pointer to output stream for debris flow tally
+  std::ofstream *ImpDif_fsPtr; // pointer to output stream for implicit diffusion iterations
+  std::ofstream *DtSub_fsPtr; // pointer to output stream for basin time steps
   
   double kd;                 // Hillslope transport (diffusion) coef
   tTimeSeries kd_ts;         // Hillslope transport coef as time series
@@ -1300,6 +1404,9 @@ private:
   double woodDensity; // density of wood (kg/m3)
   double fricSlope; // tangent of angle of repose for soil (unitless)
   unsigned num_grain_sizes_;  // number of grain-size classes used
+  bool optImplicitDetachLim; // option for implicit detachment-limited solver
+  bool optImplicitDiffusion; // option for implicit hillslope diffusion solvers
+  bool optParallelBasins; // option for eroding drainage basins separately
 public:
   double debris_flow_sed_bucket; // tally of debris flow sed. volume
   double debris_flow_wood_bucket;// tally of debris flow wood volume
@@ -16,6 +16,8 @@
 
 #include "../tInputFile/tInputFile.h"
 #include "../tListInputData/tListInputData.h"
+#include "../tCheckpoint/tCheckpoint.h"
+#include "../errors/errors.h"
 
 /*********************************************************\
 **  ran3
@@ -73,6 +75,35 @@ int tRand::numberRecords() const {
   return sizeof(ma)/sizeof(ma[0])-1+2;
 }
 
+void tRand::getState( long *state ) const {
+  for(size_t i=1; i<sizeof(ma)/sizeof(ma[0]); ++i)
+    *state++ = ma[i];
+  *state++ = inext;
+  *state = inextp;
+}
+
+void tRand::setState( const long *state ) {
+  for(size_t i=1; i<sizeof(ma)/sizeof(ma[0]); ++i)
+    ma[i] = *state++;
+  inext = *state++;
+  inextp = *state;
+}
+
+void tRand::WriteCheckpoint( tCheckpointWriter &ckp, const char *name ) const {
+  std::vector<long> state( numberRecords() );
+  getState( &state[0] );
+  ckp.Write( name, state );
+}
+
+void tRand::ReadCheckpoint( const tCheckpointReader &ckp, const char *name ) {
+  std::vector<long> state;
+  ckp.Read( name, state );
+  if( static_cast<int>(state.size()) != numberRecords() )
+    ReportFatalError( "tRand: bad random number generator state in "
+                      "checkpoint." );
+  setState( &state[0] );
+}
+
 #define MBIG 1000000000
 #define MSEED 161803398
 #define MZ 0
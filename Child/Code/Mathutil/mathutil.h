@@ -31,6 +31,8 @@ double genrand_res53(void);
 
 // forward declaration
 class tInputFile;
+class tCheckpointWriter;
+class tCheckpointReader;
 #include <iosfwd>
 #include <math.h>
 
@@ -52,6 +54,13 @@ public:
   void dumpToFile( std::ofstream&  );
   void readFromFile( std::ifstream& );
   int numberRecords() const;
+  // copies the state, in the order of dumpToFile, to numberRecords() values
+  void getState( long * ) const;
+  // sets the state from numberRecords() values, as given by getState
+  void setState( const long * );
+  // checkpoint the state as the field of the given name
+  void WriteCheckpoint( tCheckpointWriter &, const char *name ) const;
+  void ReadCheckpoint( const tCheckpointReader &, const char *name );
 private:
   void initFromFile(tInputFile const &);
   // state of ran3()
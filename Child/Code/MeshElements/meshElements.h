@@ -371,6 +371,7 @@ public:
   tArray2<double> FindCircumcenter() const; // computes & returns tri's circumcenter
   const unsigned char *index() const { return index_; }
   void SetIndexIDOrdered(); // build the ordering index array
+  inline void SetIndexFrom( int ); // ordering index array from given vertex
   inline bool isIndexIDOrdered() const;
   bool containsPoint(double, double) const; // does "this" contains the point (x,y)
   tTriangle* NbrToward( double, double );
@@ -737,14 +738,14 @@ inline tArray< double > tNode::FuturePosn() {return get2DCoords();}
 
 /*******************************************************************\
   tNode::getEdgePtrIndices() virtual function; here, returns 
-  one-member array with edg ID
+  one-member array with edg ID (-1 if none)
 
   10/10 SL
 \*******************************************************************/
 inline tArray< int > tNode::getEdgePtrIndices() 
 {
   tArray<int> ar(1);
-  ar[0] = edg->getID();
+  ar[0] = edg ? edg->getID() : -1;
   return ar;
 }
 
@@ -1189,6 +1190,14 @@ void tTriangle::SetIndex()
   index_[2] = 2;
 }
 
+inline void tTriangle::SetIndexFrom( int first )
+{
+  assert( first >= 0 && first < 3 );
+  index_[0] = first;
+  index_[1] = (index_[0]+1)%3;
+  index_[2] = (index_[1]+1)%3;
+}
+
 //default
 inline tTriangle::tTriangle() :
   listObj(),
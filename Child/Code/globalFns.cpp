@@ -838,6 +838,47 @@ double DistanceToLine( double x2, double y2, tNode const *p0, tNode const *p1 )
 }
 
 
+/*****************************************************************************\
+**
+**      HilbertIndex: given integer coords (ix, iy) on a square grid of
+**              2^order by 2^order cells, returns the position of the cell
+**              along the Hilbert curve through the grid. Cells that are
+**              close on the curve are close in space; used to order the
+**              mesh for locality (tMesh::ReorderForLocality).
+**      Global function.
+**
+**      Assumes: 0 <= ix, iy < 2^order; order <= 16
+**      Called by: tMesh::ReorderForLocality
+**
+\*****************************************************************************/
+unsigned long HilbertIndex( unsigned long ix, unsigned long iy, int order )
+{
+   assert( order > 0 && order <= 16 );
+   const unsigned long n = 1UL << order;
+   unsigned long d = 0;
+   for( unsigned long s = n/2; s > 0; s /= 2 )
+   {
+      const unsigned long rx = ( ix & s ) > 0;
+      const unsigned long ry = ( iy & s ) > 0;
+      d += s * s * ( ( 3 * rx ) ^ ry );
+      // rotate the quadrant so that the curve within it has the
+      // standard orientation
+      if( ry == 0 )
+      {
+         if( rx == 1 )
+         {
+            ix = n-1 - ix;
+            iy = n-1 - iy;
+         }
+         const unsigned long tmp = ix;
+         ix = iy;
+         iy = tmp;
+      }
+   }
+   return d;
+}
+
+
 // global function to be used with veg. growth stuff:
   /*
    * this equation was called Richard's Chapman equation (in the Ecological
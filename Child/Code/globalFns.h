@@ -107,6 +107,9 @@ double DistanceToLine( double x2, double y2, double a, double b, double c );
 
 double DistanceToLine( double x2, double y2, tNode const *p0, tNode const *p1 );
 
+// position of grid cell (ix, iy) along the Hilbert curve of the given order
+unsigned long HilbertIndex( unsigned long ix, unsigned long iy, int order );
+
 // global function to be used with veg. growth stuff:
 // added by SL, 8/10
 double Richards_Chapman_equ( const double t, const double Smax, 
@@ -0,0 +1,130 @@
+//-*-c++-*-
+
+/***************************************************************************/
+/**
+ **  @file tFixedArray.h
+ **  @brief Header file for tFixedArray objects.
+ **
+ **  A tFixedArray is a 1D array of up to N elements, N being fixed at
+ **  compile time, and its size at run time. Unlike tArray, it keeps its
+ **  elements within itself, so that creating or copying one performs no
+ **  memory allocation. It is meant for small temporary arrays in loops
+ **  over the nodes, e.g., the depths of each grain size (tGrainArray,
+ **  see tLNode.h).
+ */
+/***************************************************************************/
+
+#ifndef TFIXEDARRAY_H
+#define TFIXEDARRAY_H
+
+#include <iostream>
+#include "../errors/errors.h"
+
+/***************************************************************************/
+/**
+ **  @class tFixedArray
+ **
+ **  The tFixedArray template class implements 1D arrays of at most N
+ **  elements of any data type.
+ **
+ */
+/***************************************************************************/
+template< class T, size_t N >
+class tFixedArray
+{
+  static void fatalReport( size_t ) ATTRIBUTE_NORETURN; // bail out
+public:
+  inline explicit tFixedArray( size_t n = 0 );  // n elements set to zero
+  inline tFixedArray( size_t n, const T& );     // n elements set to value
+
+  inline T &operator[]( size_t );   // index operator (bounds checked)
+  inline const T &operator[]( size_t ) const;
+  inline T & at( size_t );          // likewise with no check
+  inline const T & at( size_t ) const;
+  size_t getSize() const { return npts; }
+  inline void setSize( size_t );    // resets size and values to zero
+  inline void Fill( const T& );     // sets all elements to value
+  T *getArrayPtr() { return avalue; }
+  const T *getArrayPtr() const { return avalue; }
+private:
+  T avalue[N]; // the array itself
+  size_t npts; // size of array
+};
+
+
+/**************************************************************************\
+ **
+ **  Constructors: the size must not exceed N.
+ **
+\**************************************************************************/
+template< class T, size_t N >
+inline tFixedArray< T, N >::tFixedArray( size_t n ) :
+  npts(0)
+{
+  setSize( n );
+}
+
+template< class T, size_t N >
+inline tFixedArray< T, N >::tFixedArray( size_t n, const T& val ) :
+  npts(0)
+{
+  setSize( n );
+  Fill( val );
+}
+
+template< class T, size_t N >
+inline void tFixedArray< T, N >::setSize( size_t n )
+{
+  if( unlikely(n > N) )
+    fatalReport( n );
+  npts = n;
+  Fill( T(0) );
+}
+
+template< class T, size_t N >
+inline void tFixedArray< T, N >::Fill( const T& val )
+{
+  for( size_t i=0; i<npts; ++i )
+    avalue[i] = val;
+}
+
+/**************************************************************************\
+ **  Overloaded operators
+\**************************************************************************/
+template< class T, size_t N >
+inline T &tFixedArray< T, N >::operator[]( size_t subscript )
+{
+  if( unlikely(subscript >= npts) )
+    fatalReport( subscript );
+  return avalue[subscript];
+}
+
+template< class T, size_t N >
+inline const T &tFixedArray< T, N >::operator[]( size_t subscript ) const
+{
+  if( unlikely(subscript >= npts) )
+    fatalReport( subscript );
+  return avalue[subscript];
+}
+
+template< class T, size_t N >
+inline T &tFixedArray< T, N >::at( size_t subscript )
+{
+  return avalue[subscript];
+}
+
+template< class T, size_t N >
+inline const T &tFixedArray< T, N >::at( size_t subscript ) const
+{
+  return avalue[subscript];
+}
+
+template< class T, size_t N >
+void tFixedArray< T, N >::fatalReport( size_t subscript )
+{
+  std::cout << "subscript or size " << subscript << " out of range (at most "
+            << N << " elements)" << std::endl;
+  ReportFatalError( "Subscript out of range." );
+}
+
+#endif
@@ -0,0 +1,234 @@
+/**************************************************************************/
+/**
+**  @file tCheckpoint.cpp
+**
+**  @brief Functions for classes tCheckpointWriter and tCheckpointReader.
+**
+**  See tCheckpoint.h.
+*/
+/**************************************************************************/
+
+#include <stdio.h>
+#include <iostream>
+#include "tCheckpoint.h"
+#include "../errors/errors.h"
+
+using namespace tBinaryOutput;
+
+// fields holding the names and sizes of the output files
+static const char kFileNames[] = "out.files";
+static const char kFileSizes[] = "out.sizes";
+
+
+/**************************************************************************\
+**
+**  tCheckpointWriter constructor, destructor
+**
+**  The constructor opens the temporary file and starts its slice. The
+**  destructor removes the temporary file if the checkpoint was not
+**  committed.
+**
+\**************************************************************************/
+tCheckpointWriter::tCheckpointWriter( const std::string &fileName_,
+                                      double time ) :
+  fileName( fileName_ ),
+  tmpName( fileName_ + ".tmp" ),
+  file(),
+  committed( false )
+{
+  file.Open( tmpName.c_str(), false );
+  file.BeginSlice( time, 0, 0, 0, 0 );
+}
+
+tCheckpointWriter::~tCheckpointWriter()
+{
+  if( committed ) return;
+  file.Close();
+  remove( tmpName.c_str() );
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointWriter::Write
+**
+**  Write a value, or a field of values in rows of ncols.
+**
+\**************************************************************************/
+void tCheckpointWriter::Write( const char *name, double v )
+{
+  file.WriteField( name, &v, 1 );
+}
+
+void tCheckpointWriter::Write( const char *name, long v )
+{
+  file.WriteField( name, &v, 1 );
+}
+
+void tCheckpointWriter::Write( const char *name,
+                               const std::vector< double > &v, int ncols )
+{
+  file.WriteField( name, v, ncols );
+}
+
+void tCheckpointWriter::Write( const char *name,
+                               const std::vector< long > &v, int ncols )
+{
+  file.WriteField( name, v.empty() ? 0 : &v[0], v.size()/ncols, ncols );
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointWriter::WriteOutputFiles
+**
+**  Records the output files and their sizes. The names are stored one
+**  character per value, each followed by a 0.
+**
+\**************************************************************************/
+void tCheckpointWriter::WriteOutputFiles()
+{
+  std::vector< std::string > names;
+  std::vector< int64_t > sizes;
+  tOutputFiles::GetSizes( names, sizes );
+  std::vector< long > chars, lsizes( sizes.begin(), sizes.end() );
+  for( size_t i=0; i<names.size(); ++i )
+  {
+    chars.insert( chars.end(), names[i].begin(), names[i].end() );
+    chars.push_back( 0 );
+  }
+  Write( kFileNames, chars );
+  Write( kFileSizes, lsizes );
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointWriter::Commit
+**
+**  Completes the file, and renames it to the name of the checkpoint
+**  (which replaces the previous checkpoint in one step).
+**
+\**************************************************************************/
+void tCheckpointWriter::Commit()
+{
+  file.Close();
+  if( rename( tmpName.c_str(), fileName.c_str() ) != 0 )
+  {
+    std::cout << "While writing " << fileName << std::endl;
+    ReportFatalError( "Can't rename the checkpoint file." );
+  }
+  committed = true;
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointReader constructor
+**
+**  Maps the checkpoint and finds its fields.
+**
+\**************************************************************************/
+tCheckpointReader::tCheckpointReader( const std::string &fileName ) :
+  reader( fileName.c_str() ),
+  time( 0. ),
+  fields()
+{
+  if( reader.getNumSlices() != 1 )
+  {
+    std::cout << "While reading " << fileName << std::endl;
+    ReportFatalError( "This is not a CHILD checkpoint file." );
+  }
+  time = reader.getTime( 0 );
+  std::vector< tField > list;
+  reader.GetFields( 0, list );
+  for( size_t k=0; k<list.size(); ++k )
+    fields[ list[k].name ] = list[k];
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointReader::Find, Has
+**
+\**************************************************************************/
+const tField &tCheckpointReader::Find( const char *name, int type ) const
+{
+  std::map< std::string, tField >::const_iterator f = fields.find( name );
+  if( f == fields.end() || f->second.type != type )
+  {
+    std::cout << "Checkpoint field " << name << std::endl;
+    ReportFatalError( "The checkpoint lacks a field of the model state." );
+  }
+  return f->second;
+}
+
+bool tCheckpointReader::Has( const char *name ) const
+{
+  return fields.find( name ) != fields.end();
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointReader::ReadDouble, ReadInt, Read
+**
+\**************************************************************************/
+double tCheckpointReader::ReadDouble( const char *name ) const
+{
+  const tField &f = Find( name, kFloat64 );
+  if( f.nrows * f.ncols != 1 )
+    ReportFatalError( "tCheckpointReader: field is not a single value." );
+  return f.getDoubles()[0];
+}
+
+long tCheckpointReader::ReadInt( const char *name ) const
+{
+  const tField &f = Find( name, kInt64 );
+  if( f.nrows * f.ncols != 1 )
+    ReportFatalError( "tCheckpointReader: field is not a single value." );
+  return static_cast<long>( f.getInt64s()[0] );
+}
+
+void tCheckpointReader::Read( const char *name,
+                              std::vector< double > &v ) const
+{
+  const tField &f = Find( name, kFloat64 );
+  v.assign( f.getDoubles(), f.getDoubles() + f.nrows * f.ncols );
+}
+
+void tCheckpointReader::Read( const char *name,
+                              std::vector< long > &v ) const
+{
+  const tField &f = Find( name, kInt64 );
+  v.assign( f.getInt64s(), f.getInt64s() + f.nrows * f.ncols );
+}
+
+
+/**************************************************************************\
+**
+**  tCheckpointReader::ResumeOutputFiles
+**
+**  Passes the output files recorded in the checkpoint to tOutputFiles.
+**  Must be called before the output files are opened.
+**
+\**************************************************************************/
+void tCheckpointReader::ResumeOutputFiles() const
+{
+  std::vector< long > chars, lsizes;
+  Read( kFileNames, chars );
+  Read( kFileSizes, lsizes );
+  std::vector< std::string > names( 1 );
+  for( size_t i=0; i<chars.size(); ++i )
+  {
+    if( chars[i] == 0 )
+      names.push_back( std::string() );
+    else
+      names.back() += static_cast<char>( chars[i] );
+  }
+  names.pop_back();
+  if( names.size() != lsizes.size() )
+    ReportFatalError( "tCheckpointReader: bad list of output files." );
+  std::vector< int64_t > sizes( lsizes.begin(), lsizes.end() );
+  tOutputFiles::Resume( names, sizes );
+}
@@ -0,0 +1,112 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tCheckpoint.h
+**
+**  @brief Header file for classes tCheckpointWriter and tCheckpointReader.
+**
+**  A checkpoint holds the complete state of a model run: the mesh and
+**  everything stored at its nodes, the state of the random number
+**  generators, of the run timer, storm, stream network, erosion, uplift,
+**  vegetation and output objects, and the sizes of the output files. A
+**  run restarted from a checkpoint (child --restart=<file> <input file>)
+**  goes on exactly as the original run would have, and continues its
+**  output files.
+**
+**  The checkpoint is a binary output file (see tBinaryOutput.h) with a
+**  single time slice, whose fields are named after the object they belong
+**  to ("rand", "timer.d", "mesh.node.i", ...). The values are stored as
+**  they are in memory, so that the state is restored exactly. Each class
+**  writes and reads its own fields, in WriteCheckpoint and
+**  ReadCheckpoint functions. The file is written under a temporary name,
+**  and renamed when it is complete, so that a run that is killed while
+**  writing a checkpoint leaves the previous one intact.
+**
+**  The classes whose state is restored are constructed from the input
+**  file as usual before ReadCheckpoint is called (the mesh has a
+**  constructor of its own, which rebuilds it from the checkpoint); the
+**  input file must therefore be the one the checkpoint was written with.
+*/
+/**************************************************************************/
+
+#ifndef TCHECKPOINT_H
+#define TCHECKPOINT_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "../tOutput/tBinaryOutput.h"
+
+#define SCHECKPOINT ".ckp"
+
+/**************************************************************************/
+/**
+** @class tCheckpointWriter
+**
+** Writes a checkpoint file. The fields are written to <fileName>.tmp,
+** which Commit renames to fileName; a checkpoint that is not committed is
+** removed.
+**
+*/
+/**************************************************************************/
+class tCheckpointWriter
+{
+  tCheckpointWriter( const tCheckpointWriter & );
+  tCheckpointWriter &operator=( const tCheckpointWriter & );
+public:
+  tCheckpointWriter( const std::string &fileName, double time );
+  ~tCheckpointWriter();
+
+  void Write( const char *name, double );
+  void Write( const char *name, long );
+  void Write( const char *name, const std::vector< double > &,
+              int ncols = 1 );
+  void Write( const char *name, const std::vector< long > &,
+              int ncols = 1 );
+  // records the names and sizes of the output files (see tOutputFiles)
+  void WriteOutputFiles();
+  void Commit();
+
+private:
+  std::string fileName;
+  std::string tmpName;
+  tBinaryOutputFile file;
+  bool committed;
+};
+
+
+/**************************************************************************/
+/**
+** @class tCheckpointReader
+**
+** Reads a checkpoint file. Reading a field that the checkpoint does not
+** hold, or that has a different type, is a fatal error.
+**
+*/
+/**************************************************************************/
+class tCheckpointReader
+{
+  tCheckpointReader( const tCheckpointReader & );
+  tCheckpointReader &operator=( const tCheckpointReader & );
+public:
+  explicit tCheckpointReader( const std::string &fileName );
+
+  double getTime() const { return time; }
+  bool Has( const char *name ) const;
+  double ReadDouble( const char *name ) const;
+  long ReadInt( const char *name ) const;
+  void Read( const char *name, std::vector< double > & ) const;
+  void Read( const char *name, std::vector< long > & ) const;
+  // has the output files continued from their sizes at the checkpoint
+  void ResumeOutputFiles() const;
+
+private:
+  const tBinaryOutput::tField &Find( const char *name, int type ) const;
+
+  tBinaryOutputReader reader;
+  double time;
+  std::map< std::string, tBinaryOutput::tField > fields;
+};
+
+#endif
@@ -15,6 +15,9 @@ class tIDGenerator
 	  tIDGenerator();
 	  tIDGenerator(int startingValue);
 	  int getNextID();
+	  // the ID that getNextID will return next (for checkpoints)
+	  int peekNextID() const { return id; }
+	  void setNextID( int next ) { id = next; }
 	  
 	private:
 	   int id;
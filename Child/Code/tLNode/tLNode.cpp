@@ -308,7 +308,7 @@ double tLNode::new_sed_bulk_density_ = kDefaultSoilBulkDensity;
 tLNode::tLNode()                                                   //tLNode
   :
 tNode(), vegCover(), rock(), reg(), chan(),
-flood(kNotFlooded), flowedge(0), tracer(0),
+flood(kNotFlooded), flowedge(0),
 dzdt(0.), drdt(0.), tau(0.), taucb(0.), taucr(0.), qs(0.),
 qsm(),
 qsin(0.),
@@ -331,7 +331,7 @@ public1(-1)
 tLNode::tLNode( const tInputFile &infile )
 :
 tNode( infile ), vegCover(), rock(), reg(), chan(),
-flood(kNotFlooded), flowedge(0), tracer(0),
+flood(kNotFlooded), flowedge(0),
 dzdt(0.), drdt(0.), tau(0.), taucb(0.), taucr(0.), qs(0.),
 qsm(),
 qsin(0.),
@@ -364,6 +364,8 @@ public1(-1)
     int tmp_;
     tmp_ = infile.ReadItem( tmp_, "NUMGRNSIZE" );
     assert(tmp_ >= 0);
+    if( tmp_ > kMaxGrainSizes )
+      ReportFatalError( "NUMGRNSIZE must not be greater than 9." );
     numg = tmp_;
   }
   grade.setSize( numg );
@@ -576,7 +578,6 @@ tLNode::tLNode( const tLNode &orig )                               //tLNode
     chan( orig.chan ),
     flood(orig.flood), 
     flowedge(0), 
-    tracer(orig.tracer),
     dzdt(orig.dzdt), 
     drdt(orig.drdt), 
     tau(orig.tau), 
@@ -635,7 +636,6 @@ const tLNode &tLNode::operator=( const tLNode &right )                  //tNode
       chan = right.chan;
       flood = right.flood;
       flowedge = right.flowedge;
-      tracer = right.tracer;
       dzdt = right.dzdt;
       drdt = right.drdt;
       tau = right.tau;
@@ -2015,14 +2015,27 @@ tLNode* tLNode::getUpstrmNbr()
    that a new static boolean tNode::freezeElevations is consulted to 
    determine whether elevations are meant to change or not.
 
+  Modified: the work is done by EroDep( int, double *, double ), which
+   takes the depths by pointer and replaces them with the depths
+   actually ero'd/dep'd, and keeps its temporary arrays on the stack, so
+   that the erosion loops perform no memory allocation.
+
 \***********************************************************************/
 
 
 tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
+{
+  if( valgrd.getSize() < numg )
+    ReportFatalError( "tLNode::EroDep: fewer depths than grain sizes" );
+  EroDep( i, valgrd.getArrayPtr(), tt );
+  return valgrd;
+}
+
+void tLNode::EroDep( int i, double *valgrd, double tt)
 {
   double amt, val, olddep;
-  tArray<double> update(numg);
-  tArray<double> hupdate(numg);
+  tGrainArray update(numg);
+  tGrainArray hupdate(numg);
   
   //NIC these are for testing
   //Xbefore=getLayerDepth(i);
@@ -2085,7 +2098,7 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
 	     {
 	        // keep eroding until you either get all the material you
 	        // need to refill the top layer, or you run out of material
-	        hupdate = addtoLayer(i+1, val);//remove stuff from lower layer
+	        addtoLayer(i+1, val, hupdate.getArrayPtr());//remove stuff from lower layer
 	        size_t g=0;
 	        sumd=0;
 	        while(g<numg)
@@ -2183,7 +2196,7 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
             g++;
           }
           assert( getLayerDepth(i)>0.0 );
-          makeNewLayerBelow(i, getLayerSed(i), getLayerErody(i), update, tt,
+          makeNewLayerBelow(i, getLayerSed(i), getLayerErody(i), update.getArrayPtr(), tt,
                             getLayerBulkDensity(i) );
           
           //When new layer is created then you change the recent time.
@@ -2238,7 +2251,7 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
             // keep getting material from below  until you
             // either get all the material you
             // need to refill the top layer, or you run out of material
-            hupdate = addtoLayer(i+1, val);//remove stuff from
+            addtoLayer(i+1, val, hupdate.getArrayPtr());//remove stuff from
                                            //lower layer, hupdate stores texture of material that will
                                            //refil the top layer
             size_t g=0;
@@ -2293,7 +2306,7 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
           }
 	      }
 	      assert( getLayerDepth(i)>0.0 );
-	      makeNewLayerBelow(i-1, tLayer::kSed, KRnew, update, tt, 
+	      makeNewLayerBelow(i-1, tLayer::kSed, KRnew, update.getArrayPtr(), tt, 
                           new_sed_bulk_density_);
 	      //New layer made with deposited material
 	    }
@@ -2386,7 +2399,7 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
               g++;
             }
             assert( getLayerDepth(i)>0.0 );
-            makeNewLayerBelow(i, getLayerSed(i), getLayerErody(i), update, tt,
+            makeNewLayerBelow(i, getLayerSed(i), getLayerErody(i), update.getArrayPtr(), tt,
                               getLayerBulkDensity(i) );
             setLayerEtime(i+1, olde);
             //When new layer is created then you change the time.
@@ -2412,7 +2425,7 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
 	    {
 	      //Layer is bedrock, so make a new layer on top to deposit into
 	      //or, depositing more than maxregdep
-	      makeNewLayerBelow(i-1, tLayer::kSed, KRnew, update, tt, 
+	      makeNewLayerBelow(i-1, tLayer::kSed, KRnew, update.getArrayPtr(), tt, 
                           new_sed_bulk_density_);
 	    }
       }
@@ -2422,12 +2435,12 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
   if(getLayerDepth(i)>1.1*maxregdep && getLayerSed(i) != tLayer::kBedRock ){
     //Make a top layer that is maxregdep deep so that further erosion
     //is not screwed up
-    hupdate = addtoLayer(i, -1*maxregdep);
+    addtoLayer(i, -1*maxregdep, hupdate.getArrayPtr());
     for(size_t g=0; g<numg; g++) {
       hupdate[g]=-1* hupdate[g];
       assert( hupdate[g]>=0.0 ); //GT
     }
-    makeNewLayerBelow(-1, tLayer::kSed, getLayerErody(i), hupdate, tt, 
+    makeNewLayerBelow(-1, tLayer::kSed, getLayerErody(i), hupdate.getArrayPtr(), tt, 
                       new_sed_bulk_density_);
     setLayerRtime(i,0.);
   }
@@ -2436,8 +2449,6 @@ tArray<double> tLNode::EroDep( int i, tArray<double> valgrd, double tt)
   //   std::cout<<"TOO MUCH SEDIMENT IN TOP LAYER"<<std::endl;
   //   TellAll();
   //}
-  
-return valgrd;
   }
 
 /**************************************************************
@@ -2483,18 +2494,16 @@ void tLNode::addtoLayer(int i, int g, double val, double tt)
  **  As always, the depth of each grain size class is also updated.
  **  i = layer to deplete
  **  val = amount to deplete by
- **  Returns an array containing the texture of material removed.
+ **  Sets ret (numg values) to the texture of material removed.
  **
  **  created NG
  **  Since only for erosion, nic modified this so that the time
  **  is not passed, since time will not be reset for erosion.
  ******************************************************************/
-tArray<double> tLNode::addtoLayer(int i, double val)
+void tLNode::addtoLayer(int i, double val, double *ret)
 {
   assert( val<0.0 ); // Function should only be called for erosion
 
-  tArray<double> ret(numg);
-
   tLayer *hlp = layerlist.getIthDataPtrNC( i );
 
   if(hlp->getDepth()+val>1e-7)
@@ -2508,7 +2517,6 @@ tArray<double> tLNode::addtoLayer(int i, double val)
 	  hlp->addDgrade(n,hlp->getDgrade(n)*val/amt);
 	  n++;
 	}
-      return ret;
     }
   else
     {
@@ -2520,7 +2528,6 @@ tArray<double> tLNode::addtoLayer(int i, double val)
 	  n++;
 	}
       removeLayer(i);
-      return ret;
     }
 
 }
@@ -2595,7 +2602,7 @@ void tLNode::removeLayer(int i)
 }
 
 /*****************************************************************
- ** tLNode::makeNewLayerBelow(int i, int sd, double erd, tArray<double> sz, double tt)
+ ** tLNode::makeNewLayerBelow(int i, int sd, double erd, double const *sz, double tt)
  ** Makes a new layer below layer i.
  ** if i<0 then make new top layer.
  ** sd = sediment flag
@@ -2606,7 +2613,7 @@ void tLNode::removeLayer(int i)
  ** in erodep.
  ********************************************************************/
 void tLNode::makeNewLayerBelow(int i, tLayer::tSed_t sd, double erd,
-			       tArray<double> const &sz, double tt, 
+			       double const *sz, double tt, 
              double bulk_density )
 {
   tLayer hlp, niclay;
@@ -2705,3 +2712,205 @@ double tLNode::getRegolithDepth()
 }
 
 
+
+
+/*******************************************************************
+ **
+ **  tLayer::WriteState, ReadState
+ **  tLNode::WriteState, ReadState
+ **
+ **  Append the state of a layer or node to the arrays of a checkpoint
+ **  (see tCheckpoint.h), or read it back, advancing the pointers past
+ **  the values read. Arrays are written with their size, in the integer
+ **  array. The values are set directly, so that the state is restored
+ **  exactly (e.g., setDgrade would recompute the layer depth).
+ **
+ ********************************************************************/
+static void WriteStateArray( const tArray< double > &a,
+			     std::vector<double> &d, std::vector<long> &l )
+{
+  l.push_back( a.getSize() );
+  for( size_t i=0; i<a.getSize(); ++i )
+    d.push_back( a[i] );
+}
+
+static void ReadStateArray( tArray< double > &a,
+			    const double *&d, const long *&l )
+{
+  const size_t n = *l++;
+  if( a.getSize() != n )
+    a.setSize( n );
+  for( size_t i=0; i<n; ++i )
+    a[i] = *d++;
+}
+
+void tLayer::WriteState( std::vector<double> &d, std::vector<long> &l ) const
+{
+  l.push_back( layerID );
+  l.push_back( sed );
+  d.push_back( ctime );
+  d.push_back( rtime );
+  d.push_back( etime );
+  d.push_back( depth );
+  d.push_back( erody );
+  d.push_back( paleocurrent );
+  d.push_back( bulkDensity );
+  WriteStateArray( dgrade, d, l );
+}
+
+void tLayer::ReadState( const double *&d, const long *&l )
+{
+  layerID = static_cast<int>( *l++ );
+  sed = static_cast<tSed_t>( *l++ );
+  ctime = *d++;
+  rtime = *d++;
+  etime = *d++;
+  depth = *d++;
+  erody = *d++;
+  paleocurrent = *d++;
+  bulkDensity = *d++;
+  ReadStateArray( dgrade, d, l );
+}
+
+void tLNode::WriteState( std::vector<double> &d, std::vector<long> &l ) const
+{
+  vegCover.WriteState( d, l );
+  d.push_back( rock.erodibility );
+  d.push_back( reg.thickness );
+  WriteStateArray( reg.dgrade, d, l );
+  d.push_back( chan.drarea );
+  d.push_back( chan.q );
+  d.push_back( chan.mdFlowPathLength );
+  d.push_back( chan.chanwidth );
+  d.push_back( chan.hydrwidth );
+  d.push_back( chan.channrough );
+  d.push_back( chan.hydrnrough );
+  d.push_back( chan.chandepth );
+  d.push_back( chan.hydrdepth );
+  d.push_back( chan.chanslope );
+  d.push_back( chan.hydrslope );
+  d.push_back( chan.diam );
+  const tMeander &m = chan.migration;
+  d.push_back( m.newx );
+  d.push_back( m.newy );
+  d.push_back( m.deltax );
+  d.push_back( m.deltay );
+  d.push_back( m.zoldright );
+  d.push_back( m.zoldleft );
+  d.push_back( m.bankrough );
+  WriteStateArray( m.xyzd, d, l );
+  l.push_back( m.reachmember );
+  l.push_back( m.meander );
+
+  // flow edge, as its position among the spokes
+  long flowSpoke = -1;
+  if( flowedge != 0 )
+    {
+      tEdge *ce = const_cast< tEdge * >( getEdg() );
+      for( long i=0; flowSpoke<0; ++i, ce=ce->getCCWEdg() )
+	{
+	  if( ce == flowedge )
+	    flowSpoke = i;
+	  else if( i > 0 && ce == getEdg() )
+	    ReportFatalError( "tLNode::WriteState: flow edge is not a spoke "
+			      "of the node." );
+	}
+    }
+  l.push_back( flood );
+  l.push_back( flowSpoke );
+  d.push_back( dzdt );
+  d.push_back( drdt );
+  d.push_back( tau );
+  d.push_back( taucb );
+  d.push_back( taucr );
+  d.push_back( qs );
+  WriteStateArray( qsm, d, l );
+  d.push_back( qsin );
+  WriteStateArray( qsinm, d, l );
+  d.push_back( qsdin );
+  WriteStateArray( qsdinm, d, l );
+  d.push_back( uplift );
+  WriteStateArray( accumdh, d, l );
+  d.push_back( qsubsurf );
+  d.push_back( netDownslopeForce );
+  d.push_back( cumulative_ero_dep_ );
+  d.push_back( cumulative_sed_xport_volume_ );
+  l.push_back( is_masked_ );
+  l.push_back( is_moving_ );
+  l.push_back( public1 );
+
+  l.push_back( layerlist.getSize() );
+  tListIter< tLayer > li( const_cast< tList< tLayer > & >( layerlist ) );
+  for( tLayer *lay = li.FirstP(); !li.AtEnd(); lay = li.NextP() )
+    lay->WriteState( d, l );
+}
+
+void tLNode::ReadState( const double *&d, const long *&l )
+{
+  vegCover.ReadState( d, l );
+  rock.erodibility = *d++;
+  reg.thickness = *d++;
+  ReadStateArray( reg.dgrade, d, l );
+  chan.drarea = *d++;
+  chan.q = *d++;
+  chan.mdFlowPathLength = *d++;
+  chan.chanwidth = *d++;
+  chan.hydrwidth = *d++;
+  chan.channrough = *d++;
+  chan.hydrnrough = *d++;
+  chan.chandepth = *d++;
+  chan.hydrdepth = *d++;
+  chan.chanslope = *d++;
+  chan.hydrslope = *d++;
+  chan.diam = *d++;
+  tMeander &m = chan.migration;
+  m.newx = *d++;
+  m.newy = *d++;
+  m.deltax = *d++;
+  m.deltay = *d++;
+  m.zoldright = *d++;
+  m.zoldleft = *d++;
+  m.bankrough = *d++;
+  ReadStateArray( m.xyzd, d, l );
+  m.reachmember = *l++ != 0;
+  m.meander = *l++ != 0;
+
+  flood = static_cast<tFlood_t>( *l++ );
+  const long flowSpoke = *l++;
+  flowedge = 0;
+  if( flowSpoke >= 0 )
+    {
+      flowedge = getEdg();
+      for( long i=0; i<flowSpoke; ++i )
+	flowedge = flowedge->getCCWEdg();
+    }
+  dzdt = *d++;
+  drdt = *d++;
+  tau = *d++;
+  taucb = *d++;
+  taucr = *d++;
+  qs = *d++;
+  ReadStateArray( qsm, d, l );
+  qsin = *d++;
+  ReadStateArray( qsinm, d, l );
+  qsdin = *d++;
+  ReadStateArray( qsdinm, d, l );
+  uplift = *d++;
+  ReadStateArray( accumdh, d, l );
+  qsubsurf = *d++;
+  netDownslopeForce = *d++;
+  cumulative_ero_dep_ = *d++;
+  cumulative_sed_xport_volume_ = *d++;
+  is_masked_ = *l++ != 0;
+  is_moving_ = *l++ != 0;
+  public1 = static_cast<int>( *l++ );
+
+  const long nlayers = *l++;
+  layerlist.Flush();
+  for( long i=0; i<nlayers; ++i )
+    {
+      tLayer lay;
+      lay.ReadState( d, l );
+      layerlist.insertAtBack( lay );
+    }
+}
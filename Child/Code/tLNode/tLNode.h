@@ -38,6 +38,7 @@
 
 #include "../Definitions.h"
 #include "../tArray/tArray.h"
+#include "../tArray/tFixedArray.h"
 #include "../MeshElements/meshElements.h"
 #include "../tList/tList.h"
 #include "../tInputFile/tInputFile.h"
@@ -51,6 +52,12 @@ class tStratGrid;
 
 #define kVeryHigh 100000  // Used in FillLakes
 
+// Largest number of grain sizes (read as GRAINDIAM1...GRAINDIAM9), and
+// the array type for temporary values of each grain size, which needs no
+// memory allocation
+#define kMaxGrainSizes 9
+typedef tFixedArray< double, kMaxGrainSizes > tGrainArray;
+
 
 /** @class tLayer
     Layer records */
@@ -107,6 +114,9 @@ public:
   inline double getBulkDensity() const {return bulkDensity;}
   inline void setBulkDensity( double val ) {bulkDensity = val;}
   inline void addBulkDensity( double val ) {bulkDensity += val;}
+  // append the layer to / read it from checkpoint arrays (see tLNode)
+  void WriteState( std::vector<double> &, std::vector<long> & ) const;
+  void ReadState( const double *&, const long *& );
 
 protected:
   int layerID;
@@ -537,12 +547,6 @@ public:
   inline void RevertToOldCoords();
   virtual inline void UpdateCoords();
   double DistNew( tLNode const *, tLNode const * ) const;
-  void ActivateSortTracer();
-  void DeactivateSortTracer();
-  void MoveSortTracerDownstream();
-  void FlagDownhillNodes();
-  inline void AddTracer();
-  bool NoMoreTracers() const;
   void EroDep( double dz );
   inline void setAlluvThickness( double ); // deprecated
   inline double getAlluvThickness() const; // deprecated
@@ -653,6 +657,9 @@ public:
   // Can be used for erosion of bedrock.
   // Algorithm assumes that the material being deposited is the
   // Same material as that in the layer you are depositing into.
+  void EroDep(int, double *, double);
+  // Same, for the numg depths at the pointer, which are replaced by the
+  // depths actually deposited or eroded (no memory allocation).
 
   // New functions below, added 28-10-2003, Quintijn
   inline void ResetAccummulatedDh();                           // set to 0.0
@@ -671,16 +678,17 @@ public:
   inline bool IsMasked() { return is_masked_; }
   inline void setMask( bool is_masked ) { is_masked_ = is_masked; }
 
-  tArray<double> addtoLayer(int, double);
+  void addtoLayer(int, double, double *);
   // Used if removing material from lower layers -
   // only called from EroDep
   // because appropriate checking needs to be done first.
-  // array tells the composition of the material which was taken from layer
+  // array (numg values) gets the composition of the material which was
+  // taken from layer
   void addtoLayer(int, int, double, double);
   // Used if depositing or eroding material to lower layer size by size
   // only called from EroDep because appropriate checking needs
   // to be done first - also used for erosion from the surface layer
-  void makeNewLayerBelow(int, tLayer::tSed_t, double, tArray<double> const &,
+  void makeNewLayerBelow(int, tLayer::tSed_t, double, double const *,
 			 double, double );
   void removeLayer(int);
   void InsertLayerBack( tLayer const & );
@@ -709,6 +717,12 @@ public:
 
   void TellAll() const;
 
+  // Append the state of the node (everything but the tNode data, which
+  // the mesh saves itself) to checkpoint arrays, or read it back. The
+  // flow edge is saved as its position among the node's spokes.
+  void WriteState( std::vector<double> &, std::vector<long> & ) const;
+  void ReadState( const double *&, const long *& );
+
 protected:
   double CalcSlopeMeander(); // specialisation of CalcSlope()
   tLNode *getDSlopeDtMeander( double &curlen );  // specialisation of getDSlopeDt()
@@ -719,7 +733,6 @@ protected:
   tChannel chan;
   tFlood_t flood;        /* flag: is the node part of a lake?*/
   tEdge *flowedge;
-  int tracer;                       /* Used by network sorting algorithm*/
   double dzdt;                      /* Erosion rate */
   double drdt;                      /* Rock erosion rate */
   double tau;                       // Shear stress or equivalent (e.g., unit stream pwr)
@@ -1387,76 +1400,6 @@ inline double tLNode::getAccFine() const
 }
 // end of 5 functions related to the conversion of dh from tLNode to tStratNode
 
-/**************************************************************************\
- **
- **  Tracer-sorting routines:
- **
- **  These routines are utilities that are used in sorting the nodes
- **  according to their position within the drainage network. The main
- **  sorting algorithm is implemented in tStreamNet::SortNodesByNetOrder().
- **  The sorting method works by introducing a "tracer" at each point,
- **  then allowing the tracers to iteratively cascade downstream. At each
- **  step any nodes not containing tracers are moved to the back of the
- **  list. The result is a list sorted in upstream-to-downstream order.
- **
- **  These utilities do the following:
- **    ActivateSortTracer -- injects a single tracer at a node
- **    AddTracer -- adds a tracer to a node (ignored if node is a bdy)
- **    MoveSortTracerDownstream -- removes a tracer and sends it to the
- **                                downstream neighbor (unless the node is
- **                                a sink; then the tracer just vanishes)
- **    FlagDownhillNodes -- for multiple flow direction
- **                         routing: flag all downhill nodes
- **    NoMoreTracers -- reports whether there are any tracers left here
- **
- **  Created by GT 12/97.
- **
- **  Modifications:
- **   - added MoveSortTracersDownstrmMulti and moved all files to .h
- **     for inlining, 1/00, GT
- **
-\**************************************************************************/
-
-inline void tLNode::ActivateSortTracer()
-{ tracer = 1; }
-
-inline void tLNode::DeactivateSortTracer()
-{ tracer = 0; }
-
-inline void tLNode::MoveSortTracerDownstream()
-{
-  tracer--;
-  //if( flood!=kSink ) getDownstrmNbr()->AddTracer();
-  if( flood!=kSink ) 
-  {
-    tLNode *dsnbr = getDownstrmNbr();
-    if( dsnbr==0 ) TellAll();
-    assert( dsnbr!=0 );
-    dsnbr->AddTracer();
-  }
-}
-
-inline void tLNode::FlagDownhillNodes()
-{
-  tEdge *ce;
-
-  // Flag all adjacent nodes that are lower than me
-  ce = getEdg();
-  do
-    {
-      if( ce->getDestinationPtr()->getZ() < z && ce->FlowAllowed() )
-	(static_cast<tLNode *>(ce->getDestinationPtrNC()))->ActivateSortTracer();
-      ce = ce->getCCWEdg();
-    }
-  while( ce!=getEdg() );
-
-}
-
-inline void tLNode::AddTracer()
-{
-  if( boundary == kNonBoundary ) tracer++;
-}
-
 inline void tLNode::setAlluvThickness( double val )
 {
   //reg.thickness = ( val >= 0.0 ) ? val : 0.0;
@@ -1473,12 +1416,6 @@ tLNode::getAlluvThicknessm( ) const
   return reg.dgrade;
 }
 
-inline bool tLNode::NoMoreTracers() const
-{
-  assert( tracer>=0 );
-  return BOOL( tracer==0 );
-}
-
 // SL, 9/2003: Version to override tNode version. ChangeZ is only used
 //  by tUplift functions, so this version will cause uplift to be applied
 //  to "old" elevations so that, if a long time elapses between setting
@@ -1496,15 +1433,15 @@ inline void tLNode::ChangeZ( double val )
 
 /*******************************************************************\
   tNode::getEdgePtrIndices() virtual function; here, returns 
-  one-member array with edg ID
+  two-member array with edg and flowedge IDs (-1 if none)
 
   10/10 SL
 \*******************************************************************/
 inline tArray< int > tLNode::getEdgePtrIndices() 
 {
   tArray<int> ar(2);
-  ar[0] = getEdg()->getID();
-  ar[1] = flowedge->getID();
+  ar[0] = getEdg() ? getEdg()->getID() : -1;
+  ar[1] = flowedge ? flowedge->getID() : -1;
   return ar;
 }
 
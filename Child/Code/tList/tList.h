@@ -43,6 +43,8 @@
 
 #include "tListFwd.h"
 #include "../compiler.h"
+#include "../tPool/tPool.h"
+#include <algorithm>
 
 /**************************************************************************/
 /**
@@ -69,6 +71,11 @@ public:
   inline tListNodeBasic( const tListNodeBasic< NodeType > & ); // copy constructor #1
   inline tListNodeBasic( const NodeType & );              // copy constructor #2
   ~tListNodeBasic() {next = prev = 0;}
+  // storage comes from a tPool (see tPool.h)
+  static void *operator new( size_t size )
+  { return tPool< tListNodeBasic< NodeType > >::Allocate( size ); }
+  static void operator delete( void *ptr, size_t size )
+  { tPool< tListNodeBasic< NodeType > >::Free( ptr, size ); }
   const tListNodeBasic< NodeType >
   &operator=( const tListNodeBasic< NodeType > & );           // assignment
   inline bool operator==( const tListNodeBasic< NodeType > & ) const; // equality
@@ -297,6 +304,11 @@ public:
   inline tListNodeListable( const tListNodeListable< NodeType > & ); // copy constructor #1
   inline tListNodeListable( const NodeType & );              // copy constructor #2
   ~tListNodeListable() {next = prev = 0;}
+  // storage comes from a tPool (see tPool.h)
+  static void *operator new( size_t size )
+  { return tPool< tListNodeListable< NodeType > >::Allocate( size ); }
+  static void operator delete( void *ptr, size_t size )
+  { tPool< tListNodeListable< NodeType > >::Free( ptr, size ); }
   const tListNodeListable< NodeType >
   &operator=( const tListNodeListable< NodeType > & );           // assignment
   inline bool operator==( const tListNodeListable< NodeType > & ) const; // equality
@@ -541,6 +553,8 @@ public:
   inline void moveToBefore( ListNodeType *, ListNodeType * );
   inline void moveToAfter( ListNodeType *, ListNodeType * );
   inline void makeCircular();   // makes list circular (last points to first)
+  void Relink( ListNodeType * const *, int ); // puts nodes in given order
+  void Swap( tList< NodeType, ListNodeType > & ); // exchanges contents
   inline const NodeType getIthData( int ) const;     // rtns copy of given item #
   inline const NodeType *getIthDataPtr( int ) const; // rtns ptr to given item #
   inline const NodeType &getIthDataRef( int ) const; // rtns ref to given item #
@@ -622,7 +636,6 @@ tList( const tList< NodeType, ListNodeType > &original ) :
 {
   int i;
 
-  assert( original != 0 );
   ListNodeType * current = original.first;
   for( i=0; i<original.nNodes; ++i )
     {
@@ -1312,6 +1325,52 @@ makeCircular()
   first->prev = last;
 }
 
+/**************************************************************************\
+ **
+ **  tList::Relink
+ **
+ **  Puts the nodes of the list in a new order, given as an array of
+ **  pointers to all n of its nodes. The nodes are only relinked, not
+ **  copied, so pointers to their items remain valid. A circular list
+ **  stays circular. (Only for lists of doubly linked nodes.)
+ **
+\**************************************************************************/
+template< class NodeType, class ListNodeType >
+void tList< NodeType, ListNodeType >::
+Relink( ListNodeType * const *order, int n )
+{
+  assert( n == nNodes );
+  if( n == 0 ) return;
+  const bool circular = ( last->next != 0 );
+  for( int i=0; i<n; ++i )
+    {
+      order[i]->prev = ( i>0 ) ? order[i-1] : 0;
+      order[i]->next = ( i<n-1 ) ? order[i+1] : 0;
+    }
+  first = order[0];
+  last = order[n-1];
+  if( circular )
+    makeCircular();
+  currentItem = first;
+}
+
+/**************************************************************************\
+ **
+ **  tList::Swap
+ **
+ **  Exchanges the contents of two lists, without copying any items.
+ **
+\**************************************************************************/
+template< class NodeType, class ListNodeType >
+void tList< NodeType, ListNodeType >::
+Swap( tList< NodeType, ListNodeType > &other )
+{
+  std::swap( nNodes, other.nNodes );
+  std::swap( first, other.first );
+  std::swap( last, other.last );
+  std::swap( currentItem, other.currentItem );
+}
+
 
 template< class NodeType, class ListNodeType >
 void tList< NodeType, ListNodeType >::DebugTellPtrs() const
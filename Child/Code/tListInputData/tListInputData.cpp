@@ -24,6 +24,7 @@
 #include <iostream>
 
 #include "../Mathutil/mathutil.h"
+#include "../tOutput/tBinaryOutput.h"
 
 void tListInputDataBase::
 ReportIOError(IOErrorType t, const char *filename,
@@ -76,7 +77,10 @@ openFile( std::ifstream &infile, const char *basename,
  **
  **  tListInputData::findRightTime
  **
- **  Find the right time in file and position it for reading
+ **  Find the right time in file and position it for reading. If the files
+ **  come with an index of their time slices (see tTextSliceIndex), the
+ **  search starts at the slice it gives; otherwise, or if the index does
+ **  not match the file, at the start of the file.
  **
 \**************************************************************************/
 void tListInputDataBase::
@@ -86,6 +90,19 @@ findRightTime( std::ifstream &infile, int &nn, double intime,
   char headerLine[kMaxNameLength]; // header line read from input file
   bool righttime = false;
   double time;
+  int64_t offset;
+  if( tTextSliceIndex::Find( basename, ext, intime, offset ) )
+    {
+      infile.seekg( offset );
+      if( !infile.good() || infile.peek() != kTimeLineMark )
+	{
+	  std::cout << "Warning: the slice index does not match "
+		    << basename << ext << "; reading it from the start."
+		    << std::endl;
+	  infile.clear();
+	  infile.seekg( 0 );
+	}
+    }
   while( !( infile.eof() ) && !righttime )
     {
       /*infile.getline( headerLine, kMaxNameLength );
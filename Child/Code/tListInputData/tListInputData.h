@@ -88,6 +88,9 @@ protected:
  **  the files would normally contain only one "time slice" of course).
  **  In each file the elements are listed in order by ID number, starting
  **  from zero (the ID #s are not actually list in the files).
+ **  The time slices are found through the index of the output files,
+ **  <name>.sidx, if there is one (see tTextSliceIndex in
+ **  tBinaryOutput.h), and otherwise by reading each file from the start.
  **
  **  NODE file format:  (note: the _ character represents a space)
  **    _time
@@ -19,11 +19,15 @@
 #include <fstream>
 #include <time.h>
 #include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
 
 #include "TipperTriangulator.h"
 
 #ifndef DONT_USE_PREDICATE
-#include "../globalFns.h"
+#include "../Predicates/predicates.h"
+extern Predicates predicate; // defined with main (see globalFns.h)
 #endif
 
 #define TIMING 1
@@ -96,6 +100,24 @@ bool needswap(int i1, int i2, int i3, int i4, const point p[]){
 #endif
 }
 
+// Is p3 inside the circle through p0, p1, p2 (counter clockwise)?
+static inline
+bool incircle(int p0, int p1, int p2, int p3, const point p[]){
+#ifdef DONT_USE_PREDICATE
+  const double
+    adx = p[p0].x()-p[p3].x(), ady = p[p0].y()-p[p3].y(),
+    bdx = p[p1].x()-p[p3].x(), bdy = p[p1].y()-p[p3].y(),
+    cdx = p[p2].x()-p[p3].x(), cdy = p[p2].y()-p[p3].y();
+  return
+    (adx*adx+ady*ady)*(bdx*cdy-cdx*bdy)
+    +(bdx*bdx+bdy*bdy)*(cdx*ady-adx*cdy)
+    +(cdx*cdx+cdy*cdy)*(adx*bdy-bdx*ady) > 0 ? true:false;
+#else
+  return predicate.incircle(p[p0].XY(), p[p1].XY(), p[p2].XY(), p[p3].XY())
+    > 0 ? true:false;
+#endif
+}
+
 const point &point::operator=( const point &p ) {
   if ( &p != this ) {
     _XY[0] = p.x(); _XY[1] = p.y(); _id = p.id();
@@ -769,9 +791,478 @@ void moved_duplicated_points(int npoints, point *p, int &npoints_unique){
   delete [] dups;
 }
 
+// Parallel triangulation
+//
+// With more than one thread, the sorted points are cut into vertical
+// strips, one per thread, which are triangulated concurrently by
+// triangulate(). The triangulations of neighbouring strips are then merged
+// pairwise, as in the divide and conquer algorithm of Guibas and Stolfi
+// (ACM Transactions on Graphics vol4 no 2 pp 74-123, 1985), the merges of
+// each round running concurrently too. During the merges a triangulation
+// is held as the ring of neighbours of each point, in counter clockwise
+// order, and the edge table is rebuilt from the rings at the end.
+// When no four points lie on a circle, the Delaunay triangulation is
+// unique and the result is the same as that of the sweep, but for the
+// numbering of the edges. Otherwise either of the possible diagonals may be
+// chosen where points are cocircular, by both methods.
+
+// a strip is not worth a thread below this number of points
+static const int tt_min_strip_points = 10000;
+
+// Neighbour rings of points begin..end-1. The ring of point begin+i is
+// nbr[start[i]..start[i+1]-1], unless it has been changed by a merge, in
+// which case it is changed_rings[changed[i]].
+class tt_strip {
+public:
+  tt_strip(): begin(0), end(0) {}
+  void build(int b, int nedges, const edge* edges);
+
+  int begin, end;
+  std::vector<int> start, nbr;
+  std::vector<int> changed;
+  std::vector< std::vector<int> > changed_rings;
+};
+
+// Build the rings from the edges given by triangulate() for points b.. of
+// the sorted array (edges numbered from 0). The ring of a point on the
+// hull starts with the first neighbour counter clockwise of the outside.
+void tt_strip::build(int b, int nedges, const edge* edges){
+  oriented_edge *oedge;
+  tt_build_spoke(end-b, nedges, edges, &oedge);
+  begin = b;
+  start.resize(end-b+1);
+  nbr.clear();
+  nbr.reserve(2*nedges);
+  changed.assign(end-b, -1);
+  changed_rings.clear();
+  for(int i=0; i<end-b; ++i){
+    start[i] = nbr.size();
+    const oriented_edge s = oedge[i];
+    assert(!s.nonvalid());
+    oriented_edge first = s;
+    for(;;){
+      const oriented_edge cw = first.next_cw_around_from(edges);
+      if (cw.nonvalid() || (cw.e() == s.e() && cw.o() == s.o()))
+	break;
+      first = cw;
+    }
+    oriented_edge e = first;
+    do {
+      nbr.push_back(b + (e.o() ? edges[e.e()].to : edges[e.e()].from));
+      e = e.next_ccw_around_from(edges);
+    } while (!e.nonvalid() && !(e.e() == first.e() && e.o() == first.o()));
+  }
+  start[end-b] = nbr.size();
+  delete [] oedge;
+}
+
+// The rings of all points, strip by strip. Concurrent merges change the
+// rings of distinct strips only.
+class tt_rings {
+  const tt_rings &operator=( const tt_rings & );
+  tt_rings( const tt_rings & );
+public:
+  tt_rings() {}
+  const int *ring(int a, int &deg) const;
+  int onext(int a, int b) const;  // neighbour of a after b, counter clockwise
+  int oprev(int a, int b) const;  // neighbour of a before b
+  int hull_first(int a, const point p[]) const;
+  int hull_last(int a, const point p[]) const;
+  void remove_edge(int a, int b);
+  void insert_before(int a, int x, int v); // v in ring of a, just before x
+  void insert_after(int a, int x, int v);  // v in ring of a, just after x
+
+  std::vector<tt_strip> strips;
+private:
+  int strip_index(int a) const;
+  int position(int a, int b) const;
+  int gap(int a, const point p[]) const;
+  std::vector<int> &changeable_ring(int a);
+};
+
+int tt_rings::strip_index(int a) const {
+  int lo = 0, hi = strips.size()-1;
+  while (lo < hi){
+    const int mid = (lo+hi+1)/2;
+    if (strips[mid].begin <= a) lo = mid;
+    else hi = mid-1;
+  }
+  return lo;
+}
+
+const int *tt_rings::ring(int a, int &deg) const {
+  const tt_strip &s = strips[strip_index(a)];
+  const int i = a - s.begin;
+  if (s.changed[i] >= 0){
+    const std::vector<int> &r = s.changed_rings[s.changed[i]];
+    deg = r.size();
+    return &r[0];
+  }
+  deg = s.start[i+1] - s.start[i];
+  return &s.nbr[0] + s.start[i];
+}
+
+int tt_rings::position(int a, int b) const {
+  int deg;
+  const int *r = ring(a, deg);
+  for(int j=0; j<deg; ++j)
+    if (r[j] == b) return j;
+  assert(0);
+  return -1;
+}
+
+int tt_rings::onext(int a, int b) const {
+  int deg;
+  const int *r = ring(a, deg);
+  const int j = position(a, b);
+  return r[j+1 < deg ? j+1 : 0];
+}
+
+int tt_rings::oprev(int a, int b) const {
+  int deg;
+  const int *r = ring(a, deg);
+  const int j = position(a, b);
+  return r[j > 0 ? j-1 : deg-1];
+}
+
+// position in the ring of a of the neighbour just before the outside of
+// the hull, a being an extreme point (no other is collinear with it and
+// two of its neighbours)
+int tt_rings::gap(int a, const point p[]) const {
+  int deg;
+  const int *r = ring(a, deg);
+  for(int j=0; j<deg; ++j)
+    if (orient2d(a, r[j], r[j+1 < deg ? j+1 : 0], p) <= 0.)
+      return j;
+  assert(0);
+  return -1;
+}
+
+// counter clockwise hull edge out of a is a->hull_first, the clockwise
+// one a->hull_last
+int tt_rings::hull_first(int a, const point p[]) const {
+  int deg;
+  const int *r = ring(a, deg);
+  const int j = gap(a, p);
+  return r[j+1 < deg ? j+1 : 0];
+}
+
+int tt_rings::hull_last(int a, const point p[]) const {
+  int deg;
+  const int *r = ring(a, deg);
+  return r[gap(a, p)];
+}
+
+std::vector<int> &tt_rings::changeable_ring(int a){
+  tt_strip &s = strips[strip_index(a)];
+  const int i = a - s.begin;
+  if (s.changed[i] < 0){
+    s.changed[i] = s.changed_rings.size();
+    s.changed_rings.push_back(
+      std::vector<int>(s.nbr.begin()+s.start[i], s.nbr.begin()+s.start[i+1]));
+  }
+  return s.changed_rings[s.changed[i]];
+}
+
+void tt_rings::remove_edge(int a, int b){
+  {
+    std::vector<int> &r = changeable_ring(a);
+    r.erase(std::find(r.begin(), r.end(), b));
+  }
+  {
+    std::vector<int> &r = changeable_ring(b);
+    r.erase(std::find(r.begin(), r.end(), a));
+  }
+}
+
+void tt_rings::insert_before(int a, int x, int v){
+  std::vector<int> &r = changeable_ring(a);
+  r.insert(std::find(r.begin(), r.end(), x), v);
+}
+
+void tt_rings::insert_after(int a, int x, int v){
+  std::vector<int> &r = changeable_ring(a);
+  r.insert(std::find(r.begin(), r.end(), x)+1, v);
+}
+
+// Merge the triangulations of points lbegin..rbegin-1 and rbegin..rend-1,
+// the former all to the left of the latter (Guibas and Stolfi's merge).
+// An edge is written as org->dest; the names of the quad-edge operators
+// are kept in the comments.
+static
+void tt_merge(int rbegin, const point p[], tt_rings &rings){
+  // ldi: clockwise hull edge out of the rightmost point of the left part,
+  // rdi: counter clockwise hull edge out of the leftmost point of the right
+  int ldio = rbegin-1, ldid = rings.hull_last(ldio, p);
+  int rdio = rbegin, rdid = rings.hull_first(rdio, p);
+  // lower common tangent
+  for(;;){
+    if (orient2d(rdio, ldio, ldid, p) > 0.){ // ldi = Lnext(ldi)
+      const int n = rings.oprev(ldid, ldio);
+      ldio = ldid; ldid = n;
+    } else if (orient2d(ldio, rdid, rdio, p) > 0.){ // rdi = Rprev(rdi)
+      const int n = rings.onext(rdid, rdio);
+      rdio = rdid; rdid = n;
+    } else
+      break;
+  }
+  // basel = Connect(Sym(rdi), ldi), from rdi's origin to ldi's
+  rings.insert_before(rdio, rdid, ldio);
+  rings.insert_after(ldio, ldid, rdio);
+  int bo = rdio, bd = ldio;
+  // zip up, adding one edge from the base edge at each step
+  for(;;){
+    // lcand = Onext(Sym(basel)): bd->lc
+    int lc = rings.onext(bd, bo);
+    if (orient2d(lc, bd, bo, p) > 0.){
+      for(;;){
+	const int t = rings.onext(bd, lc);
+	if (!incircle(bd, bo, lc, t, p)) break;
+	rings.remove_edge(bd, lc);
+	lc = t;
+      }
+    }
+    // rcand = Oprev(basel): bo->rc
+    int rc = rings.oprev(bo, bd);
+    if (orient2d(rc, bd, bo, p) > 0.){
+      for(;;){
+	const int t = rings.oprev(bo, rc);
+	if (!incircle(bd, bo, rc, t, p)) break;
+	rings.remove_edge(bo, rc);
+	rc = t;
+      }
+    }
+    const bool lvalid = orient2d(lc, bd, bo, p) > 0.;
+    const bool rvalid = orient2d(rc, bd, bo, p) > 0.;
+    if (!lvalid && !rvalid)
+      break;
+    if (!lvalid || (rvalid && incircle(lc, bd, bo, rc, p))){
+      // basel = Connect(rcand, Sym(basel))
+      rings.insert_before(rc, bo, bd);
+      rings.insert_after(bd, bo, rc);
+      bo = rc;
+    } else {
+      // basel = Connect(Sym(basel), Sym(lcand))
+      rings.insert_before(bo, bd, lc);
+      rings.insert_after(lc, bd, bo);
+      bd = lc;
+    }
+  }
+}
+
+// Data shared by the threads of the parallel sort and triangulation.
+// Chunk (or strip) i holds points bounds[i]..bounds[i+1]-1.
+class tt_parallel {
+  const tt_parallel &operator=( const tt_parallel & );
+  tt_parallel( const tt_parallel & );
+public:
+  tt_parallel(point *p_) : p(p_), step(0), edges(0) {}
+  point *p;
+  std::vector<int> bounds;
+  int step;                     // no. of chunks in each half of a merge
+  tt_rings rings;
+  std::vector<int> first_edge;  // first edge from each point (see below)
+  edge *edges;
+};
+
+// Run task(0..ntasks-1, tp) on up to nthreads threads.
+static
+void tt_run_tasks(int first, int stride, int ntasks,
+		  void (*task)(int, tt_parallel*), tt_parallel *tp){
+  for(int i=first; i<ntasks; i+=stride)
+    task(i, tp);
+}
+
+static
+void tt_run(int ntasks, int nthreads,
+	    void (*task)(int, tt_parallel*), tt_parallel *tp){
+  if (nthreads > ntasks) nthreads = ntasks;
+  if (nthreads <= 1){
+    tt_run_tasks(0, 1, ntasks, task, tp);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for(int t=1; t<nthreads; ++t)
+    threads.push_back(std::thread(tt_run_tasks, t, nthreads, ntasks, task, tp));
+  tt_run_tasks(0, nthreads, ntasks, task, tp);
+  for(size_t t=0; t<threads.size(); ++t)
+    threads[t].join();
+}
+
+static
+void tt_sort_chunk(int i, tt_parallel *tp){
+  heapsort(tp->bounds[i+1]-tp->bounds[i], tp->p+tp->bounds[i]);
+}
+
+static
+void tt_merge_chunks(int i, tt_parallel *tp){
+  const int nchunks = tp->bounds.size()-1;
+  const int first = 2*i*tp->step;
+  const int middle = first+tp->step;
+  if (middle >= nchunks) return;
+  const int last = std::min(middle+tp->step, nchunks);
+  std::inplace_merge(tp->p+tp->bounds[first], tp->p+tp->bounds[middle],
+		     tp->p+tp->bounds[last]);
+}
+
+// sort in chunks, one per thread, then merge the chunks pairwise
+static
+void tt_parallel_sort(int npoints, point *p, int nthreads){
+  tt_parallel tp(p);
+  for(int i=0; i<=nthreads; ++i)
+    tp.bounds.push_back(static_cast<int>(
+      static_cast<long>(npoints)*i/nthreads));
+  tt_run(nthreads, nthreads, tt_sort_chunk, &tp);
+  for(tp.step=1; tp.step<nthreads; tp.step*=2)
+    tt_run((nthreads+2*tp.step-1)/(2*tp.step), nthreads,
+	   tt_merge_chunks, &tp);
+}
+
+static
+void tt_triangulate_strip(int i, tt_parallel *tp){
+  const int b = tp->bounds[i];
+  tt_strip &s = tp->rings.strips[i];
+  s.end = tp->bounds[i+1];
+  int nedges;
+  edge *edges;
+  triangulate(s.end-b, tp->p+b, &nedges, &edges);
+  s.build(b, nedges, edges);
+  delete [] edges;
+}
+
+static
+void tt_merge_strips(int i, tt_parallel *tp){
+  const int nstrips = tp->bounds.size()-1;
+  const int middle = 2*i*tp->step+tp->step;
+  if (middle < nstrips)
+    tt_merge(tp->bounds[middle], tp->p, tp->rings);
+}
+
+// Edges are numbered point by point: edge first_edge[a]+k goes from a to
+// its k-th neighbour b>a, in the order of a's ring.
+static
+int tt_edge_index(const tt_parallel *tp, int a, int b){
+  if (a > b) std::swap(a, b);
+  int deg;
+  const int *r = tp->rings.ring(a, deg);
+  int k = 0;
+  for(int j=0; j<deg; ++j){
+    if (r[j] == b) return tp->first_edge[a]+k;
+    if (r[j] > a) ++k;
+  }
+  assert(0);
+  return edge::none;
+}
+
+static
+void tt_count_edges(int i, tt_parallel *tp){
+  for(int a=tp->bounds[i]; a<tp->bounds[i+1]; ++a){
+    int deg, n = 0;
+    const int *r = tp->rings.ring(a, deg);
+    for(int j=0; j<deg; ++j)
+      if (r[j] > a) ++n;
+    tp->first_edge[a] = n;
+  }
+}
+
+static
+void tt_fill_edges(int i, tt_parallel *tp){
+  const point *p = tp->p;
+  for(int a=tp->bounds[i]; a<tp->bounds[i+1]; ++a){
+    int deg;
+    const int *r = tp->rings.ring(a, deg);
+    int ie = tp->first_edge[a];
+    for(int j=0; j<deg; ++j){
+      const int b = r[j];
+      if (b < a) continue;
+      edge &e = tp->edges[ie++];
+      e.from = a;
+      e.to = b;
+      // triangle on the left (a,b,c), on the right (a,d,b), unless outside
+      // the hull
+      const int c = r[j+1 < deg ? j+1 : 0], d = r[j > 0 ? j-1 : deg-1];
+      if (orient2d(a, b, c, p) > 0.){
+	e.lef = tt_edge_index(tp, a, c);
+	e.let = tt_edge_index(tp, b, c);
+      }
+      if (orient2d(a, d, b, p) > 0.){
+	e.ref = tt_edge_index(tp, a, d);
+	e.ret = tt_edge_index(tp, b, d);
+      }
+    }
+  }
+}
+
+// triangulate() on strips, one per thread, and merge them
+static
+void tt_parallel_triangulate(int npoints, const point p[], int nthreads,
+			     int *pnedges, edge** edges_ret){
+  tt_parallel tp(const_cast<point*>(p));
+  // strips of (about) equal size, cut where x changes, each of them
+  // with enough points, not all of them aligned
+  int nstrips = std::min(nthreads, npoints/tt_min_strip_points);
+  tp.bounds.push_back(0);
+  for(int i=1; i<nstrips; ++i){
+    int b = static_cast<int>(static_cast<long>(npoints)*i/nstrips);
+    while (b < npoints && p[b-1].x() == p[b].x()) ++b;
+    if (b-tp.bounds.back() < tt_min_strip_points/2 ||
+	npoints-b < tt_min_strip_points/2)
+      continue;
+    bool aligned = true;
+    for(int j=tp.bounds.back()+2; j<b && aligned; ++j)
+      if (orient2d(tp.bounds.back(), tp.bounds.back()+1, j, p) != 0.)
+	aligned = false;
+    if (!aligned)
+      tp.bounds.push_back(b);
+  }
+  tp.bounds.push_back(npoints);
+  nstrips = tp.bounds.size()-1;
+  {
+    // the last strip must not be aligned either
+    bool aligned = nstrips > 1;
+    const int b = tp.bounds[nstrips-1];
+    for(int j=b+2; j<npoints && aligned; ++j)
+      if (orient2d(b, b+1, j, p) != 0.)
+	aligned = false;
+    if (aligned){
+      tp.bounds.erase(tp.bounds.end()-2);
+      --nstrips;
+    }
+  }
+  if (nstrips < 2){
+    triangulate(npoints, p, pnedges, edges_ret);
+    return;
+  }
+
+  tp.rings.strips.resize(nstrips);
+  tt_run(nstrips, nthreads, tt_triangulate_strip, &tp);
+  for(tp.step=1; tp.step<nstrips; tp.step*=2)
+    tt_run((nstrips+2*tp.step-1)/(2*tp.step), nthreads, tt_merge_strips, &tp);
+
+  // edge table
+  tp.first_edge.resize(npoints+1);
+  tt_run(nstrips, nthreads, tt_count_edges, &tp);
+  {
+    int n = 0;
+    for(int a=0; a<npoints; ++a){
+      const int na = tp.first_edge[a];
+      tp.first_edge[a] = n;
+      n += na;
+    }
+    tp.first_edge[npoints] = n;
+    *pnedges = n;
+  }
+  // at most three edges per point, and an end marker, as triangulate()
+  tp.edges = new edge[3*static_cast<long>(npoints)];
+  assert(*pnedges < 3*npoints);
+  tt_run(nstrips, nthreads, tt_fill_edges, &tp);
+  *edges_ret = tp.edges;
+}
+
 void tt_sort_triangulate(int npoints, point *p,
 			 int *pnpoints_unique,
-			 int *pnedges, edge** edges_ret){
+			 int *pnedges, edge** edges_ret,
+			 int nthreads){
 
 #if defined(TIMING)
   {
@@ -782,7 +1273,10 @@ void tt_sort_triangulate(int npoints, point *p,
     //sort the points - note that the point class defines the
     // < operator so that the sort is on the x co-ordinate
     //array p will be replaced with the array sorted in x
-    heapsort(npoints,p);
+    if (nthreads > 1)
+      tt_parallel_sort(npoints, p, nthreads);
+    else
+      heapsort(npoints,p);
     if (0) // DEBUG
       tt_verify_sort(npoints, p);
 
@@ -792,7 +1286,10 @@ void tt_sort_triangulate(int npoints, point *p,
     *pnpoints_unique = npoints_unique;
 
     //triangulate the set of points
-    triangulate(npoints_unique,p,pnedges, edges_ret);
+    if (nthreads > 1)
+      tt_parallel_triangulate(npoints_unique, p, nthreads, pnedges, edges_ret);
+    else
+      triangulate(npoints_unique,p,pnedges, edges_ret);
 
 #if defined(TIMING)
     time_t t2 = time(NULL);
@@ -1117,17 +1614,23 @@ void tt_build_spoke(int npoints, int nedges, const edge* edges,
 void tt_sort_triangulate(int npoints, point *p,
 			 int *pnpoints_unique,
 			 int *pnedges, edge** edges_ret,
-			 int *pnelem, elem** pelems_ret){
-  tt_sort_triangulate(npoints, p, pnpoints_unique, pnedges, edges_ret);
+			 int *pnelem, elem** pelems_ret,
+			 int nthreads){
+  tt_sort_triangulate(npoints, p, pnpoints_unique, pnedges, edges_ret,
+		      nthreads);
   tt_build_elem_table(*pnpoints_unique, p, *pnedges, *edges_ret, pnelem, pelems_ret);
 }
 
-void tt_sort_only( int npoints, point *p, int &npoints_unique )
+void tt_sort_only( int npoints, point *p, int &npoints_unique,
+		   int nthreads )
 {
   //sort the points - note that the point class defines the
   // < operator so that the sort is on the x co-ordinate
   //array p will be replaced with the array sorted in x
-  heapsort(npoints,p);
+  if (nthreads > 1)
+    tt_parallel_sort(npoints, p, nthreads);
+  else
+    heapsort(npoints,p);
   // report duplicated points and moved them to the end.
   moved_duplicated_points(npoints, p, npoints_unique);
 }
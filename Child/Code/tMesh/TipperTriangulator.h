@@ -27,14 +27,20 @@ class point;
 class edge;
 class elem;
 class oriented_edge;
+// With nthreads > 1, the points are sorted and triangulated in parallel
+// (divide and conquer); the triangulation is the same, but the edges are
+// numbered differently.
 void tt_sort_triangulate(int npoints, point *p,
 			 int *pnpoints_unique,
-			 int *pnedges, edge** edges_ret);
+			 int *pnedges, edge** edges_ret,
+			 int nthreads = 1);
 void tt_sort_triangulate(int npoints, point *p,
 			 int *pnpoints_unique,
 			 int *pnedges, edge** edges_ret,
-			 int *pnelem, elem** pelems_ret);
-void tt_sort_only( int npoints, point *p, int &npoints_unique );
+			 int *pnelem, elem** pelems_ret,
+			 int nthreads = 1);
+void tt_sort_only( int npoints, point *p, int &npoints_unique,
+		   int nthreads = 1 );
 void tt_build_elem_table(int npoints, const point *p,
 			 int nedges, const edge* edges,
 			 int *pnelem, elem** pelems_ret);
@@ -9,7 +9,12 @@
 **     TipperTriangulator.cpp TipperTriangulatorError.cpp
 **   (with algorithms in predicates.cpp)
 **   g++ -DTIPPER_TEST TipperTriangulator_test.cpp TipperTriangulator.cpp
-**      TipperTriangulatorError.cpp ../Predicates/predicates.cpp
+**      TipperTriangulatorError.cpp ../Predicates/predicates.cpp -pthread
+**
+** Run without arguments, it triangulates the points in file "points".
+** Run as "a.out <nthreads>", it times the serial and parallel
+** triangulations of 1, 5 and 10 million points, and checks that they
+** give the same spokes around every point.
 **
 */
 /***************************************************************************/
@@ -19,14 +24,17 @@
 #include <fstream>
 #include <stdlib.h>
 #include <assert.h>
+#include <chrono>
 
 #include "TipperTriangulator.h"
 
 #ifndef DONT_USE_PREDICATE
-#include "../globalFns.h"
+#include "../Predicates/predicates.h"
 Predicates predicate;
 #endif
 
+using namespace std;
+
 // generate output files
 const bool WRITE_FILES = false;
 
@@ -213,10 +221,90 @@ void test_triangulate_from_file(){
   delete [] p;
 }
 
+// check that the ring of neighbours (by point id) around a point is the
+// same in both triangulations, given a spoke of the point in each
+static
+bool same_spokes(const point *p1, const edge *edges1,
+		 const oriented_edge &spoke1,
+		 const point *p2, const edge *edges2,
+		 const oriented_edge &spoke2){
+  // find the neighbour of the first spoke in the second ring
+  const int first = spoke1.o() ?
+    p1[edges1[spoke1.e()].to].id() : p1[edges1[spoke1.e()].from].id();
+  oriented_edge e2(spoke2);
+  for(;;){
+    const int n2 = e2.o() ?
+      p2[edges2[e2.e()].to].id() : p2[edges2[e2.e()].from].id();
+    if (n2 == first) break;
+    e2 = e2.ccw_edge_around_from(edges2);
+    if (e2.e() == spoke2.e() && e2.o() == spoke2.o()) return false;
+  }
+  // go round both
+  oriented_edge e1(spoke1);
+  do {
+    const int n1 = e1.o() ?
+      p1[edges1[e1.e()].to].id() : p1[edges1[e1.e()].from].id();
+    const int n2 = e2.o() ?
+      p2[edges2[e2.e()].to].id() : p2[edges2[e2.e()].from].id();
+    if (n1 != n2) return false;
+    e1 = e1.ccw_edge_around_from(edges1);
+    e2 = e2.ccw_edge_around_from(edges2);
+  } while (e1.e() != spoke1.e() || e1.o() != spoke1.o());
+  return true;
+}
+
+// time the serial and parallel triangulations, and compare the spoke tables
+static
+void test_parallel(int n, int nthreads){
+  const long npoints=n*n;
+  point *p1 = new point[npoints];
+  generate_dataset(n,p1);
+  for(int i=0;i<npoints;++i)
+    p1[i] = point(p1[i].x(), p1[i].y(), i);
+  point *p2 = new point[npoints];
+  for(int i=0;i<npoints;++i)
+    p2[i] = p1[i];
+
+  int npoints_unique1, npoints_unique2, nedges1, nedges2;
+  edge *edges1 = NULL, *edges2 = NULL;
+  const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  tt_sort_triangulate(npoints,p1,&npoints_unique1,&nedges1,&edges1);
+  const chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+  tt_sort_triangulate(npoints,p2,&npoints_unique2,&nedges2,&edges2,nthreads);
+  const chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+  cout << "npoints=" << npoints
+       << " serial: " << chrono::duration<double>(t1-t0).count() << " s"
+       << " parallel (" << nthreads << " threads): "
+       << chrono::duration<double>(t2-t1).count() << " s" << endl;
+
+  assert(npoints_unique1 == npoints_unique2);
+  assert(nedges1 == nedges2);
+  sanity_check_edge(edges2);
+  sanity_check_ccwedge(nedges2, edges2);
+
+  oriented_edge *spokes1, *spokes2;
+  tt_build_spoke(npoints_unique1, nedges1, edges1, &spokes1);
+  tt_build_spoke(npoints_unique2, nedges2, edges2, &spokes2);
+  int ndiffer = 0;
+  for(int i=0;i<npoints_unique1;++i){
+    assert(p1[i].id() == p2[i].id());
+    if (!same_spokes(p1, edges1, spokes1[i], p2, edges2, spokes2[i]))
+      ++ndiffer;
+  }
+  cout << "points with different spokes: " << ndiffer << endl;
+
+  delete [] spokes1;
+  delete [] spokes2;
+  delete [] edges1;
+  delete [] edges2;
+  delete [] p1;
+  delete [] p2;
+}
+
 #if !defined(DONT_USE_MAIN)
-int main(void){
+int main(int argc, char **argv){
 
-  switch(2){
+  switch(argc > 1 ? 3 : 2){
   case 0:
     {
       int n=3;
@@ -232,6 +320,14 @@ int main(void){
       }
     }
     break;
+  case 3:
+    {
+      const int nthreads = atoi(argv[1]);
+      test_parallel(1000, nthreads);  // 1 million points
+      test_parallel(2236, nthreads);  // 5 million
+      test_parallel(3162, nthreads);  // 10 million
+    }
+    break;
   default:
     {
       test_triangulate_from_file();
@@ -52,6 +52,8 @@
 #include "../globalFns.h"
 #include "../Predicates/predicates.h"
 #include "../tIDGenerator/tIDGenerator.h"
+#include "tMeshArrays.h"
+#include "tMeshIndex.h"
 
 /** @class tIdArray
     @brief Lookup table per Id for a tList
@@ -153,6 +155,8 @@ public:
    typedef tIdArray< tTriangle, tListNodeListable< tTriangle > > tIdArrayTri_t;
 
    tMesh( const tInputFile &, bool checkMeshConsistency );
+   tMesh( const tInputFile &, const tCheckpointReader &, // restart
+          bool checkMeshConsistency );
    tMesh( tMesh const * );
   tMesh( tArray<double> &, tArray<double> &, tArray<double> &  );
    ~tMesh();
@@ -226,6 +230,24 @@ public:
    void CheckMeshConsistency( bool boundaryCheckFlag=true );
    /* Updates mesh by comp'ing edg lengths & slopes & node Voronoi areas */
    void UpdateMesh( bool checkMeshConsistency = true );
+   /* records a change to a node, for incremental Voronoi updates */
+   void MarkForVoronoiUpdate( tSubNode * );
+   /* contiguous copy of the mesh geometry, kept up to date by UpdateMesh */
+   void EnableMeshArrays();
+   tMeshArrays * getMeshArrays() { return meshArrays; }
+   /* bucket index of the nodes, for point location and proximity queries */
+   void EnableMeshIndex();
+   tMeshIndex * getMeshIndex() { return meshIndex; }
+   tSubNode *FindNearestNode( double, double );
+   void FindNodesWithin( double, double, double, std::vector< tSubNode * > & );
+   /* pointers to the active nodes, the edges (each followed by its
+      complement) and the triangles, for loops run by tThreadPool */
+   inline const std::vector< tSubNode * > &getActiveNodePtrs();
+   inline const std::vector< tEdge * > &getEdgePtrs();
+   inline const std::vector< tTriangle * > &getTrianglePtrs();
+   /* checkpoint of the mesh and of the state of its nodes (tCheckpoint.h) */
+   void WriteCheckpoint( tCheckpointWriter & ) const;
+   void ReadCheckpoint( const tCheckpointReader & );
    /* computes edge slopes as (Zorg-Zdest)/Length */
    //void CalcSlopes(); /* WHY is this commented out? */
    /*routines used to move points; MoveNodes is "master" function*/
@@ -253,6 +275,7 @@ public:
    void ResetEdgeID(); // reset edge IDs in list order
    void ResetTriangleID(); // reset triangle IDs in list order
    void RenumberIDCanonically(); // reset IDs in canonical order
+   void ReorderForLocality(); // reorder lists along a Hilbert curve
    void SetmiNextNodeID(int);
    void SetmiNextEdgID(int);
    void SetmiNextTriID(int);
@@ -273,9 +296,16 @@ public:
 
 
 private:
+   enum { kHilbertOrder = 16 }; // ReorderForLocality uses a 2^16 x 2^16 grid
    static int orderRNode(const void*, const void*);
    static int orderREdge(const void*, const void*);
    static int orderRTriangle(const void*, const void*);
+   static unsigned long HilbertKey( double x, double y, double x0,
+                                    double y0, double scale );
+   void RelinkForLocality();
+   void RelocateInListOrder();
+   tTriangle *WalkToTriangle( tTriangle *, double, double, bool );
+   static tTriangle *TriangleAtNode( tNode * );
 
 protected:
    nodeList_t nodeList; // list of nodes
@@ -291,6 +321,22 @@ protected:
    bool layerflag;                 // flag indicating whether nodes have layers
    bool runCheckMeshConsistency;    // shall we run the tests ?
    tIDGenerator node_ID_generator;  // generates permanent IDs for nodes
+   tMeshArrays *meshArrays;         // contiguous copy of geometry, or 0
+   tMeshIndex *meshIndex;           // bucket index of nodes, or 0
+   int triangulationThreads;        // threads for Tipper triangulator
+   bool incrementalVoronoi;         // update Voronoi geometry where changed
+   bool voronoiAllDirty;            // ...unless this is set
+   std::vector< tSubNode * > voronoiDirtyNodes; // nodes changed since then
+   std::vector< tSubNode * > activeNodePtrs;  // as on the lists at the
+   std::vector< tEdge * > edgePtrs;           // last UpdateElementPtrs
+   std::vector< tTriangle * > triPtrs;
+
+   void UpdateMeshArrays();
+   void UpdateElementPtrs();
+   inline void CheckElementPtrs();
+   void UpdateMeshIndex();
+   void UpdateVoronoiIncrementally();
+   void ForgetVoronoiDirtyNode( tSubNode const * );
 
 };
 
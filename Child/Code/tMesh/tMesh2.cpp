@@ -31,7 +31,7 @@ RemovePointDuplicates( tSubNode &tempnode, tList<double> &xList,
     }
   //sort the points and move duplicated points to the end:
   int npoints_unique;
-  tt_sort_only( npoints, p, npoints_unique );
+  tt_sort_only( npoints, p, npoints_unique, triangulationThreads );
   // add only unique points to nodeList:
   miNextNodeID = 0;
   for( int i=0; i<npoints_unique; ++i )
@@ -170,6 +170,9 @@ MakeMeshFromPointsTipper( const tInputFile &infile ){
 **
 **   once nodeList is set up, build a Delaunay triangulation using Tipper's
 **   algorithm.
+**   With TRIANGULATION_THREADS > 1, the points are triangulated in strips
+**   by parallel threads (see tt_sort_triangulate); the triangulation is
+**   the same, but edges and triangles are numbered differently.
 **
 **   Created: 07/2002, Arnaud Desitter
 **   Calls:
@@ -213,7 +216,8 @@ BuildDelaunayMeshTipper( kUpdateMesh_t updateFlag /*= kUpdateMesh*/ )
    edge* edges(0);
    elem* elems(0);
    int nnodes_unique;
-   tt_sort_triangulate(nnodes, p, &nnodes_unique, &nedgesl, &edges, &nelem, &elems);
+   tt_sort_triangulate(nnodes, p, &nnodes_unique, &nedgesl, &edges, &nelem, &elems,
+		       triangulationThreads);
    if (nnodes != nnodes_unique)
      {
       std::cerr << "\nDuplicated points: '" << std::endl;
@@ -0,0 +1,138 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tMeshArrays.cpp
+**
+**  @brief Implementation of the tMeshArrays class.
+**
+**  See tMeshArrays.h.
+*/
+/**************************************************************************/
+
+#include <assert.h>
+#include "tMeshArrays.h"
+#include "../MeshElements/meshElements.h"
+
+
+/**************************************************************************\
+**
+**  tMeshArrays::Clear
+**
+**  Removes all nodes and edges, keeping the storage for reuse.
+**
+\**************************************************************************/
+void tMeshArrays::Clear()
+{
+  node.clear();
+  x.clear();
+  y.clear();
+  z.clear();
+  varea.clear();
+  nActiveNodes = 0;
+  edge.clear();
+  org.clear();
+  dest.clear();
+  length.clear();
+  vedglen.clear();
+  slope.clear();
+  nActiveEdges = 0;
+  nodeIndex.clear();
+}
+
+
+/**************************************************************************\
+**
+**  tMeshArrays::AddNode, AddEdge
+**
+**  Append a node or an edge to the arrays. The active ones must be added
+**  first, as on the mesh lists, and all the nodes before any edge.
+**
+\**************************************************************************/
+void tMeshArrays::AddNode( tNode *n, bool active )
+{
+  assert( !active || nActiveNodes == getNumNodes() );
+  const int id = n->getID();
+  if( id >= static_cast<int>(nodeIndex.size()) )
+    nodeIndex.resize( id+1, -1 );
+  nodeIndex[id] = getNumNodes();
+  node.push_back( n );
+  x.push_back( n->getX() );
+  y.push_back( n->getY() );
+  z.push_back( n->getZ() );
+  varea.push_back( n->getVArea() );
+  if( active ) ++nActiveNodes;
+}
+
+void tMeshArrays::AddEdge( tEdge *e, bool active )
+{
+  assert( !active || nActiveEdges == getNumEdges() );
+  edge.push_back( e );
+  org.push_back( nodeIndex[ e->getOriginPtr()->getID() ] );
+  dest.push_back( nodeIndex[ e->getDestinationPtr()->getID() ] );
+  length.push_back( e->getLength() );
+  vedglen.push_back( e->getVEdgLen() );
+  slope.push_back( e->getSlope() );
+  if( active ) ++nActiveEdges;
+}
+
+
+/**************************************************************************\
+**
+**  tMeshArrays::LoadZ, StoreZ
+**
+**  Copy node elevations from the mesh to z (LoadZ), or from z back to the
+**  mesh (StoreZ). Note that StoreZ only sets the elevation; a kernel that
+**  changes the layers of the nodes should go through tLNode::EroDep
+**  instead, and reload z.
+**
+\**************************************************************************/
+void tMeshArrays::LoadZ()
+{
+  const int n = getNumNodes();
+  for( int i=0; i<n; ++i )
+    z[i] = node[i]->getZ();
+}
+
+void tMeshArrays::StoreZ() const
+{
+  const int n = getNumNodes();
+  for( int i=0; i<n; ++i )
+    node[i]->setZ( z[i] );
+}
+
+
+/**************************************************************************\
+**
+**  tMeshArrays::CalcSlopes
+**
+**  Computes the slope of each edge from z, as ( Zorg - Zdest ) / length,
+**  for the first of each pair of complementary edges; the second gets the
+**  negative of that value (as in tStreamNet::CalcSlopes).
+**
+\**************************************************************************/
+void tMeshArrays::CalcSlopes()
+{
+  const int n = getNumEdges();
+  for( int k=0; k<n; k+=2 )
+  {
+    assert( length[k] > 0.0 );
+    slope[k] = ( z[org[k]] - z[dest[k]] ) / length[k];
+    slope[k+1] = -slope[k];
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tMeshArrays::StoreSlopes
+**
+**  Copies the edge slopes back to the mesh.
+**
+\**************************************************************************/
+void tMeshArrays::StoreSlopes() const
+{
+  const int n = getNumEdges();
+  for( int k=0; k<n; ++k )
+    edge[k]->setSlope( slope[k] );
+}
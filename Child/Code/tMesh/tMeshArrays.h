@@ -0,0 +1,75 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tMeshArrays.h
+**
+**  @brief Header file for the tMeshArrays class.
+**
+**  A tMeshArrays is a copy of the geometry of a tMesh in contiguous
+**  arrays, one per quantity ("structure of arrays"): the coordinates,
+**  elevation and Voronoi area of each node, and the origin, destination,
+**  length, Voronoi edge length and slope of each edge. Nodes and edges
+**  are stored in the order of the mesh's node and edge lists, so that the
+**  active ones come first (indices 0 to nActiveNodes-1 and 0 to
+**  nActiveEdges-1) and each edge is followed by its complement. Edge
+**  origins and destinations are given as node indices.
+**
+**  Sweeps over the arrays avoid the pointer chasing of the mesh lists,
+**  and are much faster on large meshes. The mesh keeps the arrays up to
+**  date in tMesh::UpdateMesh, once they are enabled with
+**  tMesh::EnableMeshArrays (input option OPT_MESH_ARRAYS). Elevations
+**  and slopes change more often than the mesh, so they are copied
+**  between the arrays and the mesh elements on request (LoadZ, StoreZ,
+**  StoreSlopes).
+*/
+/**************************************************************************/
+
+#ifndef TMESHARRAYS_H
+#define TMESHARRAYS_H
+
+#include <vector>
+
+class tNode;
+class tEdge;
+
+class tMeshArrays
+{
+public:
+  tMeshArrays() : nActiveNodes(0), nActiveEdges(0) {}
+
+  // Empties the arrays, ready to be filled again (by tMesh)
+  void Clear();
+  // Adds a node or edge; all nodes must be added before any edge
+  void AddNode( tNode *, bool active );
+  void AddEdge( tEdge *, bool active );
+
+  // Index of the node with the given ID
+  int getNodeIndex( int id ) const { return nodeIndex[id]; }
+  int getNumNodes() const { return static_cast<int>(node.size()); }
+  int getNumEdges() const { return static_cast<int>(edge.size()); }
+
+  // Copies node elevations from the mesh to z, or from z to the mesh
+  void LoadZ();
+  void StoreZ() const;
+  // Computes edge slopes from z, as ( Zorg - Zdest ) / length
+  void CalcSlopes();
+  // Copies edge slopes to the mesh
+  void StoreSlopes() const;
+
+  // Nodes, by index
+  std::vector<tNode *> node;
+  std::vector<double> x, y, z, varea;
+  int nActiveNodes;
+
+  // Edges, by index
+  std::vector<tEdge *> edge;
+  std::vector<int> org, dest;
+  std::vector<double> length, vedglen, slope;
+  int nActiveEdges;
+
+private:
+  std::vector<int> nodeIndex; // index of each node, by ID (-1 if none)
+};
+
+#endif
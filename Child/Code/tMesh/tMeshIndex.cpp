@@ -0,0 +1,205 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tMeshIndex.cpp
+**
+**  @brief Implementation of the tMeshIndex class.
+**
+**  See tMeshIndex.h.
+*/
+/**************************************************************************/
+
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include "tMeshIndex.h"
+#include "../MeshElements/meshElements.h"
+
+
+/**************************************************************************\
+**
+**  tMeshIndex::Reset
+**
+**  Empties the index and sizes the buckets for about two of nExpected
+**  nodes each, over the box (xmin,ymin)-(xmax,ymax) widened by a margin
+**  of 5% on each side, so that nodes added near the edges of the mesh
+**  still fit.
+**
+\**************************************************************************/
+void tMeshIndex::Reset( double xmin, double ymin, double xmax, double ymax,
+                        int nExpected )
+{
+  assert( xmax >= xmin && ymax >= ymin );
+  double width = xmax - xmin, height = ymax - ymin;
+  double margin = 0.05 * std::max( width, height );
+  if( margin <= 0.0 ) margin = 1.0;
+  x0 = xmin - margin;
+  y0 = ymin - margin;
+  width += 2.0 * margin;
+  height += 2.0 * margin;
+
+  cellSize = sqrt( 2.0 * width * height / std::max( nExpected, 1 ) );
+  nx = static_cast<int>( width / cellSize ) + 1;
+  ny = static_cast<int>( height / cellSize ) + 1;
+
+  // (the storage of the buckets is kept, as the index is rebuilt often)
+  bucket.resize( nx * ny );
+  for( size_t k=0; k<bucket.size(); ++k )
+    bucket[k].clear();
+  nNodes = 0;
+}
+
+
+/**************************************************************************\
+**
+**  tMeshIndex::Column, Row
+**
+**  Bucket column and row of an x or y coordinate, clamped to the grid.
+**
+\**************************************************************************/
+int tMeshIndex::Column( double x ) const
+{
+  const int i = static_cast<int>( floor( ( x - x0 ) / cellSize ) );
+  return i < 0 ? 0 : ( i >= nx ? nx-1 : i );
+}
+
+int tMeshIndex::Row( double y ) const
+{
+  const int j = static_cast<int>( floor( ( y - y0 ) / cellSize ) );
+  return j < 0 ? 0 : ( j >= ny ? ny-1 : j );
+}
+
+
+/**************************************************************************\
+**
+**  tMeshIndex::AddNode
+**
+**  Puts a node in the bucket that contains it. Returns false, without
+**  adding it, if the node lies outside the grid or the average number of
+**  nodes per bucket has reached kMaxPerCell.
+**
+\**************************************************************************/
+bool tMeshIndex::AddNode( tNode *n )
+{
+  const double x = n->getX(), y = n->getY();
+  if( x < x0 || y < y0 || x >= x0 + nx*cellSize || y >= y0 + ny*cellSize
+      || nNodes >= kMaxPerCell * nx * ny )
+    return false;
+  bucket[ Row( y ) * nx + Column( x ) ].push_back( n );
+  ++nNodes;
+  return true;
+}
+
+
+/**************************************************************************\
+**
+**  tMeshIndex::RemoveNode
+**
+**  Removes a node from its bucket. If the node has moved since it was
+**  added, it is looked for in every bucket.
+**
+\**************************************************************************/
+void tMeshIndex::RemoveNode( tNode const *n )
+{
+  if( nNodes == 0 ) return;
+  const int k = Row( n->getY() ) * nx + Column( n->getX() );
+  std::vector<tNode *>::iterator it =
+    std::find( bucket[k].begin(), bucket[k].end(), n );
+  if( it != bucket[k].end() )
+  {
+    *it = bucket[k].back();
+    bucket[k].pop_back();
+    --nNodes;
+    return;
+  }
+  for( size_t m=0; m<bucket.size(); ++m )
+  {
+    it = std::find( bucket[m].begin(), bucket[m].end(), n );
+    if( it != bucket[m].end() )
+    {
+      *it = bucket[m].back();
+      bucket[m].pop_back();
+      --nNodes;
+      return;
+    }
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tMeshIndex::NearestNode
+**
+**  Returns the node closest to (x,y). The buckets are searched in square
+**  rings around the one containing the point (or the nearest one to it).
+**  The search ends once a node has been found that is closer than any
+**  bucket of the next ring can be, i.e., within r bucket widths after
+**  ring r.
+**
+\**************************************************************************/
+tNode *tMeshIndex::NearestNode( double x, double y ) const
+{
+  if( nNodes == 0 ) return 0;
+  const int ci = Column( x ), cj = Row( y );
+  const int maxRing = std::max( std::max( ci, nx-1-ci ),
+                                std::max( cj, ny-1-cj ) );
+  tNode *nearest = 0;
+  double minDist2 = 0.0;
+  for( int r=0; r<=maxRing; ++r )
+  {
+    for( int j=std::max( cj-r, 0 ); j<=std::min( cj+r, ny-1 ); ++j )
+    {
+      // on the top and bottom rows of the ring take every bucket, in
+      // between only the two at its sides
+      const bool edgeRow = ( j == cj-r || j == cj+r );
+      const int step = ( edgeRow || r == 0 ) ? 1 : 2*r;
+      for( int i=ci-r; i<=ci+r; i+=step )
+      {
+        if( i < 0 || i >= nx ) continue;
+        const std::vector<tNode *> &b = bucket[ j*nx + i ];
+        for( size_t m=0; m<b.size(); ++m )
+        {
+          const double dx = b[m]->getX() - x, dy = b[m]->getY() - y;
+          const double d2 = dx*dx + dy*dy;
+          if( nearest == 0 || d2 < minDist2 )
+          {
+            nearest = b[m];
+            minDist2 = d2;
+          }
+        }
+      }
+    }
+    if( nearest != 0 && minDist2 <= r*cellSize * r*cellSize )
+      break;
+  }
+  return nearest;
+}
+
+
+/**************************************************************************\
+**
+**  tMeshIndex::NodesWithin
+**
+**  Appends to found every node within distance r of (x,y), in no
+**  particular order.
+**
+\**************************************************************************/
+void tMeshIndex::NodesWithin( double x, double y, double r,
+                              std::vector<tNode *> &found ) const
+{
+  if( nNodes == 0 || r < 0.0 ) return;
+  const int imin = Column( x - r ), imax = Column( x + r );
+  const int jmin = Row( y - r ), jmax = Row( y + r );
+  for( int j=jmin; j<=jmax; ++j )
+    for( int i=imin; i<=imax; ++i )
+    {
+      const std::vector<tNode *> &b = bucket[ j*nx + i ];
+      for( size_t m=0; m<b.size(); ++m )
+      {
+        const double dx = b[m]->getX() - x, dy = b[m]->getY() - y;
+        if( dx*dx + dy*dy <= r*r )
+          found.push_back( b[m] );
+      }
+    }
+}
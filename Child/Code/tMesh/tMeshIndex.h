@@ -0,0 +1,74 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tMeshIndex.h
+**
+**  @brief Header file for the tMeshIndex class.
+**
+**  A tMeshIndex is a uniform grid of square buckets laid over the mesh,
+**  each holding pointers to the nodes that fall in it, with about two
+**  nodes per bucket. It answers nearest-node and radius queries by
+**  looking only at the buckets near the query point, rather than at
+**  every node. tMesh uses it to choose the triangle from which
+**  LocateTriangle starts its walk ("jump and walk"), so that the walk
+**  covers a few triangles instead of crossing the mesh.
+**
+**  The index holds nodes rather than triangles: nodes are only added and
+**  deleted, while triangles are also replaced whenever an edge is
+**  flipped, and a triangle next to a node is always at hand through the
+**  node's spokes. The mesh adds and removes nodes as it adds and deletes
+**  them (tMesh::AddToList, RemoveFromList, DeleteNode), and rebuilds the
+**  index in tMesh::UpdateMesh, since moving nodes changes their buckets.
+**  It is enabled with tMesh::EnableMeshIndex (input option
+**  OPT_MESH_INDEX).
+*/
+/**************************************************************************/
+
+#ifndef TMESHINDEX_H
+#define TMESHINDEX_H
+
+#include <vector>
+
+class tNode;
+
+class tMeshIndex
+{
+public:
+  tMeshIndex() :
+    x0(0.), y0(0.), cellSize(1.), nx(0), ny(0), nNodes(0)
+  {}
+
+  // Empties the index, with buckets covering the given box for about
+  // nExpected nodes
+  void Reset( double xmin, double ymin, double xmax, double ymax,
+              int nExpected );
+  // Adds a node; returns false (and leaves it out) if the node is outside
+  // the box or the buckets are too full, in which case the index should be
+  // rebuilt
+  bool AddNode( tNode * );
+  // Removes a node, which may have moved since it was added
+  void RemoveNode( tNode const * );
+
+  // Node closest to (x,y), or 0 if the index is empty
+  tNode *NearestNode( double x, double y ) const;
+  // Appends to found the nodes within distance r of (x,y)
+  void NodesWithin( double x, double y, double r,
+                    std::vector<tNode *> &found ) const;
+
+  int getNumNodes() const { return nNodes; }
+
+private:
+  enum { kMaxPerCell = 8 };  // average load at which AddNode refuses
+
+  int Column( double x ) const;
+  int Row( double y ) const;
+
+  double x0, y0;     // lower left corner of the grid
+  double cellSize;   // width of each (square) bucket
+  int nx, ny;        // no. of buckets in x and y
+  int nNodes;
+  std::vector< std::vector<tNode *> > bucket;  // nodes of each bucket
+};
+
+#endif
@@ -86,6 +86,8 @@ class tMeshList : public tList< NodeType, ListNodeType >
    int removeFromFront( NodeType & );
    inline void moveToBefore( ListNodeType*, ListNodeType* );
    inline void moveToAfter( ListNodeType*, ListNodeType* );
+   void Relink( ListNodeType * const *, int );
+   void Swap( tMeshList< NodeType, ListNodeType > & );
    int InActiveList( ListNodeType const * );
    void Flush();
    int CheckConsistency( const char * );
@@ -446,6 +448,40 @@ moveToFront( ListNodeType * mvnode )
 }
 
 
+/**************************************************************************\
+**
+**  tMeshList::Relink
+**
+**  Puts the nodes in a new order (see tList::Relink), and resets
+**  _lastactive_. The order must keep the nActiveNodes active nodes first.
+**
+\**************************************************************************/
+template< class NodeType, class ListNodeType >
+void tMeshList< NodeType, ListNodeType >::
+Relink( ListNodeType * const *order, int n )
+{
+   tList< NodeType, ListNodeType >::Relink( order, n );
+   lastactive = ( nActiveNodes > 0 ) ? order[nActiveNodes-1] : 0;
+}
+
+
+/**************************************************************************\
+**
+**  tMeshList::Swap
+**
+**  Exchanges the contents of two lists (see tList::Swap).
+**
+\**************************************************************************/
+template< class NodeType, class ListNodeType >
+void tMeshList< NodeType, ListNodeType >::
+Swap( tMeshList< NodeType, ListNodeType > &other )
+{
+   tList< NodeType, ListNodeType >::Swap( other );
+   std::swap( nActiveNodes, other.nActiveNodes );
+   std::swap( lastactive, other.lastactive );
+}
+
+
 /**************************************************************************\
 **
 **  tMeshList::moveToActiveBack
@@ -20,7 +20,7 @@
 tOption::tOption(int argc, char const * const argv[])
   : exeName(argv[0]),
     silent_mode(false), checkMeshConsistency(true), no_write_mode(false), 
-    inputFile(0)
+    inputFile(0), restartFile(0)
 {
   argv++;
   while(argc > 1){
@@ -37,7 +37,7 @@ tOption::tOption(int argc, char const * const argv[])
 tOption::tOption(string arguments)
 : exeName("child"),
 silent_mode(false), checkMeshConsistency(true), no_write_mode(false), 
-inputFile(0)
+inputFile(0), restartFile(0)
 {
   ProcessOptionsFromString( arguments );
 }
@@ -45,7 +45,7 @@ inputFile(0)
 tOption::tOption(const char * args)
 : exeName("child"),
 silent_mode(false), checkMeshConsistency(true), no_write_mode(false), 
-inputFile(0)
+inputFile(0), restartFile(0)
 {
   string arg_string( args );
   ProcessOptionsFromString( arg_string );
@@ -81,6 +81,10 @@ int tOption::parseOptions(char const * const argv[]) {
     checkMeshConsistency = false;
     return 1;
   }
+  if (strncmp(thisOption, "--restart=", 10) == 0){
+    restartFile = thisOption + 10;
+    return 1;
+  }
   if (strcmp(thisOption, "--help") == 0){
     usage();
     exit(EXIT_SUCCESS);
@@ -117,6 +121,11 @@ int tOption::parseOptions(string thisOption) {
     checkMeshConsistency = false;
     return 1;
   }
+  if (thisOption.compare(0, 10, "--restart=") == 0){
+    restartFileString = thisOption.substr(10);
+    restartFile = restartFileString.c_str();
+    return 1;
+  }
   if (thisOption.compare("--help") == 0){
     usage();
     exit(EXIT_SUCCESS);
@@ -146,6 +155,7 @@ void tOption::usage() const {
     << " --no-check: disable CheckMeshConsistency().\n"
     << " --silent-mode: silent mode.\n"
     << " --no-write-mode: no writing to output.\n"
+    << " --restart=<file>: restart the run from a checkpoint file.\n"
     << " --version: display version.\n"
     << std::endl;
 }
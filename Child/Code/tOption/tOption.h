@@ -28,6 +28,7 @@ public:
   bool checkMeshConsistency;
   bool no_write_mode; // option to force no writing to files
   char const *inputFile;
+  char const *restartFile; // checkpoint to restart from, or 0
 
   tOption(int argc, char const * const argv[]);
   tOption(string arguments);
@@ -35,6 +36,7 @@ public:
   static void version();
 private:
   string inputFileString;
+  string restartFileString;
   int parseOptions(char const * const argv[]);
   int parseOptions(std::string thisOption);
   void usage() const;
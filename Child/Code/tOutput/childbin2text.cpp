@@ -0,0 +1,59 @@
+/**************************************************************************/
+/**
+**  @file childbin2text.cpp
+**
+**  @brief Converts a CHILD binary output file to text output files.
+**
+**  Usage: childbin2text <file.cbo> [basename]
+**
+**  Writes the files of the text output (basename.nodes, .z, .area, ...,
+**  and basename.lay0, .lay1, ... for the layers) from a file written with
+**  OPT_BINARY_OUTPUT (see tBinaryOutput.h), as the model would have
+**  written them without that option, so that the Matlab and Python
+**  post-processing tools can read them. The basename defaults to the name
+**  of the binary file without its extension. Only the files for which the
+**  binary file holds data are written.
+*/
+/**************************************************************************/
+
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tBinaryOutput.h"
+
+using namespace std;
+
+int main( int argc, char **argv )
+{
+  if( argc < 2 || argc > 3 )
+  {
+    cerr << "Usage: " << argv[0] << " <file.cbo> [basename]\n"
+         << "Converts a CHILD binary output file to text output files.\n";
+    return 1;
+  }
+  string basename;
+  if( argc == 3 )
+    basename = argv[2];
+  else
+  {
+    basename = argv[1];
+    const size_t ext = basename.rfind( SBINARY );
+    if( ext != string::npos && ext + strlen( SBINARY ) == basename.size() )
+      basename.erase( ext );
+  }
+
+  tBinaryOutputReader reader( argv[1] );
+  const int nslices = reader.getNumSlices();
+  cout << argv[1] << ": " << nslices << " time slices" << endl;
+  if( nslices == 0 ) return 0;
+
+  tTextOutputFiles text( basename );
+  vector< tBinaryOutputReader::tField > fields;
+  for( int i=0; i<nslices; ++i )
+  {
+    reader.GetFields( i, fields );
+    text.WriteSlice( reader.getSlice( i ), fields, i );
+  }
+  return 0;
+}
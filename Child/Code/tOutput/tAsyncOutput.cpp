@@ -0,0 +1,270 @@
+/**************************************************************************/
+/**
+**  @file tAsyncOutput.cpp
+**
+**  @brief Functions for class tAsyncOutput.
+**
+**  See tAsyncOutput.h.
+*/
+/**************************************************************************/
+
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include "tAsyncOutput.h"
+
+using namespace tBinaryOutput;
+
+// seconds since an arbitrary time
+static double Seconds()
+{
+  return std::chrono::duration< double >(
+    std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput constructors
+**
+**  Take ownership of the binary file or text files, and start the writer
+**  thread.
+**
+\**************************************************************************/
+tAsyncOutput::tAsyncOutput( tBinaryOutputFile *binary_, size_t maxBytes_ ) :
+  binary( binary_ ),
+  text( 0 ),
+  maxBytes( maxBytes_ ),
+  current( 0 ),
+  nslices( 0 ),
+  queuedBytes( 0 ),
+  closing( false ),
+  waitTime( 0. ),
+  writeTime( 0. )
+{
+  assert( binary != 0 );
+  Start();
+}
+
+tAsyncOutput::tAsyncOutput( tTextOutputFiles *text_, size_t maxBytes_ ) :
+  binary( 0 ),
+  text( text_ ),
+  maxBytes( maxBytes_ ),
+  current( 0 ),
+  nslices( 0 ),
+  queuedBytes( 0 ),
+  closing( false ),
+  waitTime( 0. ),
+  writeTime( 0. )
+{
+  assert( text != 0 );
+  Start();
+}
+
+void tAsyncOutput::Start()
+{
+  writer = std::thread( &tAsyncOutput::Run, this );
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput destructor
+**
+**  Lets the writer thread empty the queue, and closes the files.
+**
+\**************************************************************************/
+tAsyncOutput::~tAsyncOutput()
+{
+  if( current != 0 ) EndSlice();
+  {
+    std::lock_guard< std::mutex > lock( mutex );
+    closing = true;
+  }
+  queueChanged.notify_all();
+  writer.join();
+  delete binary;
+  delete text;
+  std::cout << "Output writer: " << nslices << " time slices written in "
+            << writeTime << " s; model waited " << waitTime << " s"
+            << std::endl;
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput::BeginSlice, WriteField
+**
+**  Copy the fields of a slice into a new snapshot. As in
+**  tBinaryOutputFile, values of type long are kept as 64-bit integers.
+**
+\**************************************************************************/
+void tAsyncOutput::BeginSlice( double time, int nnodes, int nactive,
+                               int nedges, int ntri )
+{
+  if( current != 0 ) EndSlice();
+  current = new tSlice;
+  current->info.time = time;
+  current->info.nnodes = nnodes;
+  current->info.nactive = nactive;
+  current->info.nedges = nedges;
+  current->info.ntri = ntri;
+  current->bytes = sizeof(tSlice);
+}
+
+void tAsyncOutput::AddField( const char *name, int type, int ncols,
+                             long nrows, const void *data, size_t size )
+{
+  assert( current != 0 );
+  current->fields.push_back( tFieldCopy() );
+  tFieldCopy &field = current->fields.back();
+  field.name = name;
+  field.type = type;
+  field.ncols = ncols;
+  field.nrows = nrows;
+  field.data.resize( size );
+  if( size > 0 )
+    memcpy( &field.data[0], data, size );
+  current->bytes += sizeof(tFieldCopy) + size;
+}
+
+void tAsyncOutput::WriteField( const char *name, const double *v,
+                               long nrows, int ncols )
+{
+  AddField( name, kFloat64, ncols, nrows, v, nrows * ncols * sizeof(double) );
+}
+
+void tAsyncOutput::WriteField( const char *name, const int *v,
+                               long nrows, int ncols )
+{
+  std::vector< int32_t > buf( v, v + nrows * ncols );
+  AddField( name, kInt32, ncols, nrows, buf.empty() ? 0 : &buf[0],
+            buf.size() * sizeof(int32_t) );
+}
+
+void tAsyncOutput::WriteField( const char *name, const long *v,
+                               long nrows, int ncols )
+{
+  std::vector< int64_t > buf( v, v + nrows * ncols );
+  AddField( name, kInt64, ncols, nrows, buf.empty() ? 0 : &buf[0],
+            buf.size() * sizeof(int64_t) );
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput::EndSlice
+**
+**  Queues the current snapshot for the writer thread. If the queue would
+**  then hold more than maxBytes, waits until the writer has made room
+**  (the snapshot is always accepted when the queue is empty).
+**
+\**************************************************************************/
+void tAsyncOutput::EndSlice()
+{
+  assert( current != 0 );
+  tSlice *slice = current;
+  current = 0;
+  const double start = Seconds();
+  {
+    std::unique_lock< std::mutex > lock( mutex );
+    while( !queue.empty() && queuedBytes + slice->bytes > maxBytes )
+      queueChanged.wait( lock );
+    queue.push_back( slice );
+    queuedBytes += slice->bytes;
+  }
+  waitTime += Seconds() - start;
+  queueChanged.notify_all();
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput::Flush, Resume
+**
+**  Flush waits until the writer has written the queued snapshots (it
+**  flushes the files after each). Resume sets the number of slices written
+**  so far, which numbers the layer files of the text output.
+**
+\**************************************************************************/
+void tAsyncOutput::Flush()
+{
+  if( current != 0 ) EndSlice();
+  const double start = Seconds();
+  {
+    std::unique_lock< std::mutex > lock( mutex );
+    while( !queue.empty() )
+      queueChanged.wait( lock );
+  }
+  waitTime += Seconds() - start;
+}
+
+void tAsyncOutput::Resume( int nslices_ )
+{
+  Flush();
+  std::lock_guard< std::mutex > lock( mutex );
+  nslices = nslices_;
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput::Run
+**
+**  The writer thread: writes the queued snapshots in order, until the
+**  queue is empty and the output is being closed. A snapshot stays in the
+**  queue (and counts against maxBytes) until it has been written.
+**
+\**************************************************************************/
+void tAsyncOutput::Run()
+{
+  for(;;)
+  {
+    tSlice *slice;
+    {
+      std::unique_lock< std::mutex > lock( mutex );
+      while( queue.empty() && !closing )
+        queueChanged.wait( lock );
+      if( queue.empty() ) return;
+      slice = queue.front();
+    }
+    const double start = Seconds();
+    Write( *slice );
+    writeTime += Seconds() - start;
+    {
+      std::lock_guard< std::mutex > lock( mutex );
+      queue.pop_front();
+      queuedBytes -= slice->bytes;
+    }
+    queueChanged.notify_all();
+    delete slice;
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tAsyncOutput::Write
+**
+**  Writes a snapshot to the binary file or the text files.
+**
+\**************************************************************************/
+void tAsyncOutput::Write( const tSlice &slice )
+{
+  std::vector< tField > fields( slice.fields.size() );
+  for( size_t k=0; k<fields.size(); ++k )
+  {
+    const tFieldCopy &copy = slice.fields[k];
+    fields[k].name = copy.name.c_str();
+    fields[k].type = copy.type;
+    fields[k].ncols = copy.ncols;
+    fields[k].nrows = copy.nrows;
+    fields[k].data = copy.data.empty() ? 0 : &copy.data[0];
+  }
+  if( binary != 0 )
+    binary->WriteSlice( slice.info, fields );
+  else
+    text->WriteSlice( slice.info, fields, nslices );
+  ++nslices;
+}
@@ -0,0 +1,118 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tAsyncOutput.h
+**
+**  @brief Header file for class tAsyncOutput.
+**
+**  With the option OPT_ASYNC_OUTPUT, the output of each time slice is
+**  written on a separate thread, while the model goes on with the next
+**  storms. tOutput and tLOutput copy the fields of the slice into a
+**  snapshot (as for binary output, see tBinaryOutput.h) and hand it to
+**  the tAsyncOutput, which queues it for the writer thread. The writer
+**  thread formats the snapshot as text (tTextOutputFiles) or writes it to
+**  the binary file (tBinaryOutputFile), and flushes the files.
+**
+**  The queue holds at most OUTPUT_BUFFER_MB megabytes of snapshots
+**  (default 256; a single slice is always accepted). When it is full, the
+**  model waits for the writer to catch up ("back-pressure"), so memory
+**  stays bounded even when the disk cannot keep up with the output. The
+**  time spent writing, and the time the model spent waiting, are reported
+**  when the output is closed.
+**
+**  Only the writer thread touches the output files and the snapshots in
+**  the queue; the mesh is only read by the model's thread.
+*/
+/**************************************************************************/
+
+#ifndef TASYNCOUTPUT_H
+#define TASYNCOUTPUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tBinaryOutput.h"
+
+/**************************************************************************/
+/**
+** @class tAsyncOutput
+**
+** A tFieldWriter that copies the fields of each slice and writes them on a
+** writer thread, to a binary file or to text files (it takes ownership of
+** either).
+**
+*/
+/**************************************************************************/
+class tAsyncOutput : public tFieldWriter
+{
+  tAsyncOutput( const tAsyncOutput & );
+  tAsyncOutput &operator=( const tAsyncOutput & );
+public:
+  tAsyncOutput( tBinaryOutputFile *, size_t maxBytes );
+  tAsyncOutput( tTextOutputFiles *, size_t maxBytes );
+  // writes the slices still in the queue, and closes the files
+  ~tAsyncOutput();
+
+  using tFieldWriter::WriteField;
+  void BeginSlice( double time, int nnodes, int nactive, int nedges,
+                   int ntri );
+  void WriteField( const char *name, const double *, long nrows,
+                   int ncols = 1 );
+  void WriteField( const char *name, const int *, long nrows,
+                   int ncols = 1 );
+  void WriteField( const char *name, const long *, long nrows,
+                   int ncols = 1 );
+  // queues the slice, waiting first if the queue is full
+  void EndSlice();
+  // waits until the queue is empty
+  void Flush();
+  void Resume( int nslices );
+
+private:
+  // a copy of a field
+  struct tFieldCopy
+  {
+    std::string name;
+    int type;
+    int ncols;
+    long nrows;
+    std::vector< char > data;
+  };
+  // a copy of a time slice
+  struct tSlice
+  {
+    tBinaryOutput::tSliceInfo info;
+    std::vector< tFieldCopy > fields;
+    size_t bytes;
+  };
+
+  void Start();
+  void AddField( const char *name, int type, int ncols, long nrows,
+                 const void *data, size_t size );
+  void Run();    // the writer thread
+  void Write( const tSlice & );
+
+  tBinaryOutputFile *binary;  // output to binary file, or
+  tTextOutputFiles *text;     // output to text files
+  const size_t maxBytes;      // maximum size of the queued snapshots
+
+  tSlice *current;            // slice being copied
+  int nslices;                // slices written so far (writer thread, or
+                              // with the queue empty)
+
+  std::thread writer;
+  std::mutex mutex;           // protects the members below
+  std::condition_variable queueChanged;
+  std::deque< tSlice * > queue;
+  size_t queuedBytes;
+  bool closing;
+
+  double waitTime;            // time the model spent waiting for the writer
+  double writeTime;           // time the writer spent writing
+};
+
+#endif
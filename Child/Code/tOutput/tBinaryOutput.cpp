@@ -0,0 +1,810 @@
+/**************************************************************************/
+/**
+**  @file tBinaryOutput.cpp
+**
+**  @brief Functions for classes tOutputFiles, tBinaryOutputFile,
+**  tBinaryOutputReader and tTextOutputFiles.
+**
+**  See tBinaryOutput.h.
+*/
+/**************************************************************************/
+
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include "tBinaryOutput.h"
+#include "../errors/errors.h"
+#if defined(__unix__) || defined(__APPLE__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# define CHILD_HAVE_MMAP
+#endif
+
+using namespace tBinaryOutput;
+
+static const char kFileMagic[8] = { 'C','H','I','L','D','B','I','N' };
+static const char kEndMagic[8] = { 'C','H','I','L','D','E','N','D' };
+static const char kSliceName[] = "@slice";
+static const char kIndexName[] = "@index";
+
+// bytes of data with padding to a multiple of 8
+static inline int64_t Padded( int64_t n ) { return ( n + 7 ) & ~int64_t(7); }
+
+
+/**************************************************************************\
+**
+**  tOutputFiles::Open
+**
+**  Opens an output file. A file given to Resume is cut back to the size
+**  recorded for it and opened for appending (once: if it is opened again
+**  later, it is created anew); any other file is created, or emptied.
+**  Files may be opened by the writer thread of tAsyncOutput, hence the
+**  lock.
+**
+\**************************************************************************/
+std::vector< std::string > tOutputFiles::names;
+std::vector< std::ofstream * > tOutputFiles::streams;
+std::map< std::string, int64_t > tOutputFiles::resumeSizes;
+static std::mutex outputFilesMutex;
+
+int64_t tOutputFiles::Open( std::ofstream &ofs, const std::string &name,
+                            std::ios::openmode mode )
+{
+  std::lock_guard< std::mutex > lock( outputFilesMutex );
+  size_t i = 0;
+  while( i<names.size() && names[i] != name )
+    ++i;
+  if( i == names.size() )
+  {
+    names.push_back( name );
+    streams.push_back( &ofs );
+  }
+  else
+    streams[i] = &ofs;
+
+  int64_t size = 0;
+  std::map< std::string, int64_t >::iterator r = resumeSizes.find( name );
+  if( r != resumeSizes.end() )
+  {
+    size = r->second;
+    resumeSizes.erase( r );
+#ifdef CHILD_HAVE_MMAP
+    if( truncate( name.c_str(), size ) != 0 )
+    {
+      std::cout << "While opening " << name << std::endl;
+      ReportFatalError( "Can't cut the output file back to its size at the "
+                        "checkpoint." );
+    }
+#endif
+    ofs.open( name.c_str(), mode | std::ios::app );
+    ofs.seekp( 0, std::ios::end );  // so that tellp gives the offset
+  }
+  else
+    ofs.open( name.c_str(), mode | std::ios::trunc );
+  return size;
+}
+
+
+/**************************************************************************\
+**
+**  tOutputFiles::GetSizes, Resume
+**
+\**************************************************************************/
+void tOutputFiles::GetSizes( std::vector< std::string > &names_,
+                             std::vector< int64_t > &sizes )
+{
+  std::lock_guard< std::mutex > lock( outputFilesMutex );
+  names_.clear();
+  sizes.clear();
+  for( size_t i=0; i<names.size(); ++i )
+  {
+    if( streams[i]->is_open() )
+      streams[i]->flush();
+    std::ifstream ifs( names[i].c_str(), std::ios::in | std::ios::binary );
+    if( !ifs.good() ) continue;
+    ifs.seekg( 0, std::ios::end );
+    names_.push_back( names[i] );
+    sizes.push_back( static_cast<int64_t>( ifs.tellg() ) );
+  }
+}
+
+void tOutputFiles::Resume( const std::vector< std::string > &names_,
+                           const std::vector< int64_t > &sizes )
+{
+  assert( names_.size() == sizes.size() );
+  std::lock_guard< std::mutex > lock( outputFilesMutex );
+  resumeSizes.clear();
+  for( size_t i=0; i<names_.size(); ++i )
+    resumeSizes[ names_[i] ] = sizes[i];
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile constructor, destructor
+**
+\**************************************************************************/
+tBinaryOutputFile::tBinaryOutputFile() :
+  ofs(),
+  offset(0),
+  inSlice(false),
+  index()
+{}
+
+tBinaryOutputFile::~tBinaryOutputFile()
+{
+  Close();
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile::Open
+**
+**  Creates the file and writes the file header, or continues the file of
+**  a restarted run after its last slice.
+**
+\**************************************************************************/
+void tBinaryOutputFile::Open( const char *fileName, bool resumable )
+{
+  assert( !ofs.is_open() );
+  const std::ios::openmode mode = std::ios::out | std::ios::binary;
+  int64_t size = 0;
+  if( resumable )
+    size = tOutputFiles::Open( ofs, fileName, mode );
+  else
+    ofs.open( fileName, mode | std::ios::trunc );
+  if( !ofs.good() )
+  {
+    std::cout << "While opening " << fileName << std::endl;
+    ReportFatalError(
+      "I can't create files for output. Storage space may be exhausted.");
+  }
+  index.clear();
+  if( size > 0 )
+  {
+    // the file has no index yet: the reader finds the slices
+    tBinaryOutputReader reader( fileName );
+    for( int i=0; i<reader.getNumSlices(); ++i )
+    {
+      tIndexEntry entry;
+      entry.time = reader.getTime( i );
+      entry.offset = reader.getOffset( i );
+      index.push_back( entry );
+    }
+    offset = size;
+    return;
+  }
+  tFileHeader header;
+  memcpy( header.magic, kFileMagic, sizeof(header.magic) );
+  header.version = kVersion;
+  header.byteOrder = kByteOrderMark;
+  ofs.write( reinterpret_cast<const char *>(&header), sizeof(header) );
+  offset = sizeof(header);
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile::Close
+**
+**  Writes the index of slices and the trailer, and closes the file.
+**
+\**************************************************************************/
+void tBinaryOutputFile::Close()
+{
+  if( !ofs.is_open() ) return;
+  if( inSlice ) EndSlice();
+  const int64_t indexOffset = offset;
+  WriteChunk( kIndexName, kIndex, 2, index.size(),
+              index.empty() ? 0 : &index[0],
+              index.size() * sizeof(tIndexEntry) );
+  tTrailer trailer;
+  trailer.indexOffset = indexOffset;
+  memcpy( trailer.magic, kEndMagic, sizeof(trailer.magic) );
+  ofs.write( reinterpret_cast<const char *>(&trailer), sizeof(trailer) );
+  ofs.close();
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile::WriteChunk
+**
+**  Writes a chunk header and size bytes of data, padded to a multiple of
+**  8 bytes.
+**
+\**************************************************************************/
+void tBinaryOutputFile::WriteChunk( const char *name, int type, int ncols,
+                                    int64_t nrows, const void *data,
+                                    size_t size )
+{
+  assert( ofs.is_open() );
+  if( strlen( name ) >= kNameSize )
+    ReportFatalError( "tBinaryOutputFile: field name too long." );
+  tChunkHeader header;
+  memset( &header, 0, sizeof(header) );
+  strcpy( header.name, name );
+  header.type = type;
+  header.ncols = ncols;
+  header.nrows = nrows;
+  header.size = Padded( size );
+  ofs.write( reinterpret_cast<const char *>(&header), sizeof(header) );
+  if( size > 0 )
+    ofs.write( static_cast<const char *>(data), size );
+  static const char zeros[8] = { 0,0,0,0,0,0,0,0 };
+  ofs.write( zeros, header.size - size );
+  if( !ofs.good() )
+    ReportFatalError(
+      "I can't write the output file. Storage space may be exhausted.");
+  offset += sizeof(header) + header.size;
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile::BeginSlice, EndSlice
+**
+**  Start and end a time slice. The slice is added to the index, and the
+**  file flushed once it is complete.
+**
+\**************************************************************************/
+void tBinaryOutputFile::BeginSlice( double time, int nnodes, int nactive,
+                                    int nedges, int ntri )
+{
+  if( inSlice ) EndSlice();
+  tIndexEntry entry;
+  entry.time = time;
+  entry.offset = offset;
+  index.push_back( entry );
+  tSliceInfo info;
+  info.time = time;
+  info.nnodes = nnodes;
+  info.nactive = nactive;
+  info.nedges = nedges;
+  info.ntri = ntri;
+  WriteChunk( kSliceName, kSlice, 1, 1, &info, sizeof(info) );
+  inSlice = true;
+}
+
+void tBinaryOutputFile::EndSlice()
+{
+  assert( inSlice );
+  inSlice = false;
+  ofs.flush();
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile::WriteField
+**
+**  Writes a field of nrows rows of ncols values to the current slice.
+**  Values of type long are written as 64-bit integers, so that the file
+**  does not depend on the size of a long.
+**
+\**************************************************************************/
+void tBinaryOutputFile::WriteField( const char *name, const double *v,
+                                    long nrows, int ncols )
+{
+  assert( inSlice );
+  WriteChunk( name, kFloat64, ncols, nrows, v,
+              nrows * ncols * sizeof(double) );
+}
+
+void tBinaryOutputFile::WriteField( const char *name, const int *v,
+                                    long nrows, int ncols )
+{
+  assert( inSlice );
+  if( sizeof(int) == sizeof(int32_t) )
+  {
+    WriteChunk( name, kInt32, ncols, nrows, v,
+                nrows * ncols * sizeof(int32_t) );
+    return;
+  }
+  std::vector< int32_t > buf( v, v + nrows * ncols );
+  WriteChunk( name, kInt32, ncols, nrows, buf.empty() ? 0 : &buf[0],
+              buf.size() * sizeof(int32_t) );
+}
+
+void tBinaryOutputFile::WriteField( const char *name, const long *v,
+                                    long nrows, int ncols )
+{
+  assert( inSlice );
+  std::vector< int64_t > buf( v, v + nrows * ncols );
+  WriteChunk( name, kInt64, ncols, nrows, buf.empty() ? 0 : &buf[0],
+              buf.size() * sizeof(int64_t) );
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputFile::WriteSlice
+**
+**  Writes a whole time slice.
+**
+\**************************************************************************/
+void tBinaryOutputFile::WriteSlice( const tSliceInfo &info,
+                                    const std::vector< tField > &fields )
+{
+  BeginSlice( info.time, info.nnodes, info.nactive, info.nedges, info.ntri );
+  for( size_t k=0; k<fields.size(); ++k )
+  {
+    const tField &f = fields[k];
+    const size_t valueSize = f.type == kInt32 ? sizeof(int32_t) : 8;
+    WriteChunk( f.name, f.type, f.ncols, f.nrows, f.data,
+                f.nrows * f.ncols * valueSize );
+  }
+  EndSlice();
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputReader constructor
+**
+**  Maps the file into memory, checks its header, and finds the slices,
+**  from the index if there is one, or else by scanning the file.
+**
+\**************************************************************************/
+tBinaryOutputReader::tBinaryOutputReader( const char *fileName ) :
+  base(0),
+  size(0),
+  mapped(false),
+  slices(),
+  sliceOffsets()
+{
+#ifdef CHILD_HAVE_MMAP
+  const int fd = open( fileName, O_RDONLY );
+  struct stat st;
+  if( fd >= 0 && fstat( fd, &st ) == 0 && st.st_size > 0 )
+  {
+    void *p = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( p != MAP_FAILED )
+    {
+      base = static_cast<const char *>( p );
+      size = st.st_size;
+      mapped = true;
+    }
+  }
+  if( fd >= 0 ) close( fd );
+#endif
+  if( base == 0 )
+  {
+    // no mmap: read the whole file
+    std::ifstream ifs( fileName, std::ios::in | std::ios::binary );
+    if( ifs.good() )
+    {
+      ifs.seekg( 0, std::ios::end );
+      size = ifs.tellg();
+      ifs.seekg( 0, std::ios::beg );
+      char *buf = new char[ size > 0 ? size : 1 ];
+      ifs.read( buf, size );
+      base = buf;
+    }
+  }
+  if( base == 0 )
+  {
+    std::cout << "While opening " << fileName << std::endl;
+    ReportFatalError( "tBinaryOutputReader: can't open the file." );
+  }
+
+  const tFileHeader *header = reinterpret_cast<const tFileHeader *>( base );
+  if( size < static_cast<int64_t>( sizeof(tFileHeader) )
+      || memcmp( header->magic, kFileMagic, sizeof(header->magic) ) != 0 )
+    ReportFatalError( "tBinaryOutputReader: not a CHILD binary output file." );
+  if( header->byteOrder != kByteOrderMark )
+    ReportFatalError( "tBinaryOutputReader: the file was written on a "
+                      "machine of different byte order." );
+  if( header->version > kVersion )
+    ReportFatalError( "tBinaryOutputReader: unknown file version." );
+
+  if( !ReadIndex() )
+    ScanSlices();
+}
+
+tBinaryOutputReader::~tBinaryOutputReader()
+{
+#ifdef CHILD_HAVE_MMAP
+  if( mapped )
+    munmap( const_cast<char *>( base ), size );
+  else
+#endif
+    delete [] base;
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputReader::ChunkAt
+**
+**  Returns the chunk header at the given offset, or 0 if there is no
+**  complete chunk there.
+**
+\**************************************************************************/
+const tChunkHeader *tBinaryOutputReader::ChunkAt( int64_t offset ) const
+{
+  if( offset < 0 || offset + static_cast<int64_t>( sizeof(tChunkHeader) )
+      > size )
+    return 0;
+  const tChunkHeader *chunk =
+    reinterpret_cast<const tChunkHeader *>( base + offset );
+  if( chunk->size < 0
+      || offset + static_cast<int64_t>( sizeof(tChunkHeader) ) + chunk->size
+      > size )
+    return 0;
+  return chunk;
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputReader::ReadIndex, ScanSlices
+**
+**  Find the slices from the index given by the trailer (ReadIndex returns
+**  false if there is none), or by stepping through the chunks.
+**
+\**************************************************************************/
+bool tBinaryOutputReader::ReadIndex()
+{
+  if( size < static_cast<int64_t>( sizeof(tFileHeader) + sizeof(tTrailer) ) )
+    return false;
+  const tTrailer *trailer =
+    reinterpret_cast<const tTrailer *>( base + size - sizeof(tTrailer) );
+  if( memcmp( trailer->magic, kEndMagic, sizeof(trailer->magic) ) != 0 )
+    return false;
+  const tChunkHeader *chunk = ChunkAt( trailer->indexOffset );
+  if( chunk == 0 || chunk->type != kIndex )
+    return false;
+  const tIndexEntry *entry =
+    reinterpret_cast<const tIndexEntry *>( chunk + 1 );
+  for( int64_t i=0; i<chunk->nrows; ++i )
+  {
+    const tChunkHeader *slice = ChunkAt( entry[i].offset );
+    if( slice == 0 || slice->type != kSlice )
+      return false;
+    slices.push_back( reinterpret_cast<const tSliceInfo *>( slice + 1 ) );
+    sliceOffsets.push_back( entry[i].offset );
+  }
+  return true;
+}
+
+void tBinaryOutputReader::ScanSlices()
+{
+  slices.clear();
+  sliceOffsets.clear();
+  int64_t offset = sizeof(tFileHeader);
+  const tChunkHeader *chunk;
+  while( ( chunk = ChunkAt( offset ) ) != 0 && chunk->type != kIndex )
+  {
+    if( chunk->type == kSlice )
+    {
+      slices.push_back( reinterpret_cast<const tSliceInfo *>( chunk + 1 ) );
+      sliceOffsets.push_back( offset );
+    }
+    offset += sizeof(tChunkHeader) + chunk->size;
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputReader::FindSlice
+**
+**  Returns the index of the (first) slice at the given time, or -1.
+**
+\**************************************************************************/
+int tBinaryOutputReader::FindSlice( double time ) const
+{
+  for( size_t i=0; i<slices.size(); ++i )
+    if( slices[i]->time == time )
+      return static_cast<int>( i );
+  return -1;
+}
+
+
+/**************************************************************************\
+**
+**  tBinaryOutputReader::GetFields, FindField
+**
+**  Step through the fields of slice i, which follow its header up to the
+**  next slice (or the index, or the end of the file).
+**
+\**************************************************************************/
+void tBinaryOutputReader::GetFields( int i, std::vector< tField > &fields )
+  const
+{
+  assert( i >= 0 && i < getNumSlices() );
+  fields.clear();
+  int64_t offset = sliceOffsets[i];
+  offset += sizeof(tChunkHeader) + ChunkAt( offset )->size;
+  const tChunkHeader *chunk;
+  while( ( chunk = ChunkAt( offset ) ) != 0
+         && chunk->type != kSlice && chunk->type != kIndex )
+  {
+    tField field;
+    field.name = chunk->name;
+    field.type = chunk->type;
+    field.ncols = chunk->ncols;
+    field.nrows = static_cast<long>( chunk->nrows );
+    field.data = chunk + 1;
+    fields.push_back( field );
+    offset += sizeof(tChunkHeader) + chunk->size;
+  }
+}
+
+bool tBinaryOutputReader::FindField( int i, const char *name,
+                                     tField &field ) const
+{
+  std::vector< tField > fields;
+  GetFields( i, fields );
+  for( size_t k=0; k<fields.size(); ++k )
+    if( strcmp( fields[k].name, name ) == 0 )
+    {
+      field = fields[k];
+      return true;
+    }
+  return false;
+}
+
+
+/**************************************************************************\
+**
+**  The text output files: the extension, the number in the header of each
+**  time slice, and the fields that make up the columns of each line.
+**
+\**************************************************************************/
+namespace
+{
+  enum tCount_t { kNodes, kActiveNodes, kEdges, kTriangles, kRows };
+
+  struct tTextFile
+  {
+    const char *extension;
+    tCount_t count;
+    const char *fields[4];
+  };
+
+  const tTextFile textFiles[] =
+  {
+    { ".nodes",   kNodes,       { "xy", "edg", "boundary", 0 } },
+    { ".edges",   kEdges,       { "edges", 0 } },
+    { ".tri",     kTriangles,   { "tri", 0 } },
+    { ".z",       kNodes,       { "z", 0 } },
+    { ".varea",   kNodes,       { "varea", 0 } },
+    { ".random",  kRows,        { "random", 0 } },
+    { ".area",    kActiveNodes, { "area", 0 } },
+    { ".net",     kActiveNodes, { "net", 0 } },
+    { ".slp",     kNodes,       { "slp", 0 } },
+    { ".q",       kNodes,       { "q", 0 } },
+    { ".tx",      kNodes,       { "tx", 0 } },
+    { ".tau",     kNodes,       { "tau", 0 } },
+    { ".veg",     kNodes,       { "veg", 0 } },
+    { ".for",     kNodes,       { "for", 0 } },
+    { ".dep",     kNodes,       { "dep", 0 } },
+    { ".chanwid", kNodes,       { "chanwid", 0 } },
+    { ".fplen",   kNodes,       { "fplen", 0 } },
+    { ".qs",      kNodes,       { "qs", 0 } },
+    { ".qsin",    kNodes,       { "qsin", 0 } },
+    { ".qsdin",   kNodes,       { "qsdin", 0 } },
+    { ".dzdt",    kNodes,       { "dzdt", 0 } },
+    { ".up",      kNodes,       { "up", 0 } },
+    { ".id",      kNodes,       { "id", 0 } },
+    { ".force",   kNodes,       { "force", 0 } },
+    { ".qsub",    kNodes,       { "qsub", 0 } },
+    { ".flag",    kNodes,       { "flag", 0 } }
+  };
+  const int nTextFiles = sizeof(textFiles)/sizeof(textFiles[0]);
+
+  // opens a text file, with the precision of tOutputBase::CreateAndOpenFile
+  void OpenTextFile( std::ofstream &ofs, const std::string &name )
+  {
+    tOutputFiles::Open( ofs, name );
+    if( !ofs.good() )
+    {
+      std::cout << "While opening " << name << std::endl;
+      ReportFatalError(
+        "I can't create files for output. Storage space may be exhausted.");
+    }
+    ofs.precision( 12 );
+  }
+
+  // writes value k of a field
+  inline void WriteValue( std::ofstream &ofs, const tField &f, long k )
+  {
+    switch( f.type )
+    {
+    case kFloat64: ofs << f.getDoubles()[k]; break;
+    case kInt32: ofs << f.getInts()[k]; break;
+    case kInt64: ofs << static_cast<long long>( f.getInt64s()[k] ); break;
+    default:
+      ReportFatalError( "tTextOutputFiles: unknown field type." );
+    }
+  }
+
+  const tField *FindIn( const std::vector< tField > &fields,
+                        const char *name )
+  {
+    for( size_t k=0; k<fields.size(); ++k )
+      if( strcmp( fields[k].name, name ) == 0 )
+        return &fields[k];
+    return 0;
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tTextSliceIndex::Open, AddFile, AddSlice
+**
+**  The time is written with the precision of the text files, so that it
+**  reads back as the time in the header of the slice.
+**
+\**************************************************************************/
+void tTextSliceIndex::Open( const std::string &basename )
+{
+  OpenTextFile( idx, basename + SSLICEINDEX );
+}
+
+void tTextSliceIndex::AddFile( const std::ofstream &ofs,
+                               const std::string &extension )
+{
+  extensions[ &ofs ] = extension;
+}
+
+void tTextSliceIndex::AddSlice( std::ofstream &ofs, double time )
+{
+  std::map< const std::ofstream *, std::string >::const_iterator e =
+    extensions.find( &ofs );
+  if( e == extensions.end() || !idx.is_open() )
+    return;
+  const std::streamoff offset = ofs.tellp();
+  if( offset < 0 )
+    return;
+  idx << e->second << ' ' << time << ' ' << static_cast<long long>( offset )
+      << std::endl;
+}
+
+
+/**************************************************************************\
+**
+**  tTextSliceIndex::Find
+**
+**  Reads <basename>.sidx, and finds the first slice of the file
+**  <basename><extension> whose time is at or after the given time.
+**
+\**************************************************************************/
+bool tTextSliceIndex::Find( const std::string &basename,
+                            const char *extension, double time,
+                            int64_t &offset )
+{
+  std::ifstream ifs( ( basename + SSLICEINDEX ).c_str() );
+  std::string ext;
+  double t;
+  long long off;
+  while( ifs >> ext >> t >> off )
+    if( ext == extension && t >= time )
+    {
+      offset = static_cast<int64_t>( off );
+      return true;
+    }
+  return false;
+}
+
+
+/**************************************************************************\
+**
+**  tTextOutputFiles constructor, destructor
+**
+\**************************************************************************/
+tTextOutputFiles::tTextOutputFiles( const std::string &basename_ ) :
+  basename( basename_ ),
+  ofs( nTextFiles, static_cast< std::ofstream * >( 0 ) ),
+  index()
+{
+  index.Open( basename );
+}
+
+tTextOutputFiles::~tTextOutputFiles()
+{
+  for( size_t f=0; f<ofs.size(); ++f )
+    delete ofs[f];
+}
+
+
+/**************************************************************************\
+**
+**  tTextOutputFiles::WriteSlice
+**
+**  Writes a time slice to each text file whose fields are all present:
+**  the time, the number of elements, and a line per row of the fields,
+**  with their values separated by spaces. The layers ("lay.n", "lay.rec"
+**  and "lay.dgrade") go to a new file, <basename>.lay<islice>, in the
+**  format of tLOutput::WriteActiveNodeData.
+**
+\**************************************************************************/
+void tTextOutputFiles::WriteSlice( const tSliceInfo &slice,
+                                   const std::vector< tField > &fields,
+                                   int islice )
+{
+  for( int f=0; f<nTextFiles; ++f )
+  {
+    const tTextFile &file = textFiles[f];
+    std::vector< const tField * > cols;
+    int k;
+    for( k=0; file.fields[k] != 0; ++k )
+    {
+      const tField *field = FindIn( fields, file.fields[k] );
+      if( field == 0 ) break;
+      cols.push_back( field );
+    }
+    if( file.fields[k] != 0 ) continue;
+
+    if( ofs[f] == 0 )
+    {
+      ofs[f] = new std::ofstream;
+      OpenTextFile( *ofs[f], basename + file.extension );
+      index.AddFile( *ofs[f], file.extension );
+    }
+    std::ofstream &out = *ofs[f];
+    long n = 0;
+    switch( file.count )
+    {
+    case kNodes: n = static_cast<long>( slice.nnodes ); break;
+    case kActiveNodes: n = static_cast<long>( slice.nactive ); break;
+    case kEdges: n = static_cast<long>( slice.nedges ); break;
+    case kTriangles: n = static_cast<long>( slice.ntri ); break;
+    case kRows: n = cols[0]->nrows; break;
+    }
+    index.AddSlice( out, slice.time );
+    out << ' ' << slice.time << '\n' << n << '\n';
+    for( long i=0; i<cols[0]->nrows; ++i )
+    {
+      for( size_t c=0; c<cols.size(); ++c )
+        for( int j=0; j<cols[c]->ncols; ++j )
+        {
+          if( c > 0 || j > 0 ) out << ' ';
+          WriteValue( out, *cols[c], i*cols[c]->ncols + j );
+        }
+      out << '\n';
+    }
+    out << std::flush;
+  }
+
+  const tField *nlay = FindIn( fields, "lay.n" ),
+    *rec = FindIn( fields, "lay.rec" ),
+    *dgrade = FindIn( fields, "lay.dgrade" );
+  if( nlay == 0 || rec == 0 || dgrade == 0 )
+    return;
+  std::ostringstream name;
+  name << basename << ".lay" << islice;
+  std::ofstream layofs;
+  OpenTextFile( layofs, name.str() );
+  layofs << ' ' << slice.time << '\n' << nlay->nrows << '\n';
+  const int32_t *n = nlay->getInts();
+  const double *r = rec->getDoubles();
+  const double *d = dgrade->getDoubles();
+  const bool hasDgrade = dgrade->nrows > 0;
+  for( long k=0; k<nlay->nrows; ++k )
+  {
+    layofs << ' ' << n[k] << '\n';
+    for( int l=0; l<n[k]; ++l )
+    {
+      layofs << r[0] << ' ' << r[1] << ' ' << r[2] << '\n';
+      for( int j=3; j<rec->ncols; ++j )
+        layofs << r[j] << ( j < rec->ncols-1 ? " " : "\n" );
+      r += rec->ncols;
+      if( hasDgrade )
+      {
+        for( int j=0; j<dgrade->ncols; ++j )
+          layofs << d[j] << ' ';
+        d += dgrade->ncols;
+      }
+      layofs << '\n';
+    }
+  }
+}
@@ -0,0 +1,373 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tBinaryOutput.h
+**
+**  @brief Header file for classes tBinaryOutputFile and
+**  tBinaryOutputReader.
+**
+**  With the option OPT_BINARY_OUTPUT, tOutput and tLOutput write all the
+**  data of each output time slice (mesh, elevations, drainage areas,
+**  layers, etc.) to a single binary file, <OUTFILENAME>.cbo, instead of
+**  to the two dozen text files of the usual output. The values are stored
+**  as they are in memory, so writing them costs little more than the copy,
+**  and they are read back exactly (the text output keeps 12 digits).
+**
+**  The file is a sequence of chunks, each with a fixed-size header giving
+**  its name, type and size, followed by its data padded to a multiple of
+**  8 bytes (so that arrays in a memory-mapped file are aligned):
+**
+**    file header   "CHILDBIN", version, byte order mark
+**    "@slice"      time and numbers of nodes, active nodes, edges and
+**                  triangles of a time slice, followed by the
+**    fields        of that slice, e.g., "z" (float64, one per node),
+**                  "edges" (int32, three columns), ...
+**    ...           further slices
+**    "@index"      time and file offset of each slice
+**    trailer       offset of the index, "CHILDEND"
+**
+**  The index and trailer are written when the file is closed. A file
+**  without them (e.g., from a run that was killed) is still readable: the
+**  reader then finds the slices by stepping through the chunk headers,
+**  and the last slice may be missing some fields.
+**
+**  tBinaryOutputReader maps a file into memory and gives direct access to
+**  the fields of each slice. tTextOutputFiles writes the fields of a
+**  slice to the usual text output files, as tOutput and tLOutput would;
+**  the program childbin2text (childbin2text.cpp) uses both to convert a
+**  binary file, for the Matlab and Python post-processing tools.
+**
+**  tOutput and tLOutput pass their fields to a tFieldWriter, which is
+**  either a tBinaryOutputFile, or a tAsyncOutput (see tAsyncOutput.h)
+**  that writes them on a separate thread to a binary file or to text
+**  files.
+**
+**  All output files are opened through tOutputFiles, which lets a run
+**  restarted from a checkpoint (see tCheckpoint.h) continue them.
+**
+**  The text output comes with an index of its time slices,
+**  <OUTFILENAME>.sidx (see tTextSliceIndex), which lets a run that reads
+**  its input from the output of another (OPTREADINPUT=1) go straight to
+**  the slice at INPUTTIME.
+*/
+/**************************************************************************/
+
+#ifndef TBINARYOUTPUT_H
+#define TBINARYOUTPUT_H
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define SBINARY ".cbo"
+#define SSLICEINDEX ".sidx"
+
+namespace tBinaryOutput
+{
+  // types of chunks
+  enum tChunkType_t {
+    kInt32 = 1,
+    kInt64 = 2,
+    kFloat64 = 3,
+    kSlice = 16,  // time slice header (tSliceInfo)
+    kIndex = 17   // index of slices (tIndexEntry)
+  };
+
+  enum { kNameSize = 16 };  // maximum field name length, including the 0
+
+  struct tFileHeader
+  {
+    char magic[8];      // "CHILDBIN"
+    int32_t version;
+    uint32_t byteOrder; // kByteOrderMark, as written by the machine
+  };
+
+  struct tChunkHeader
+  {
+    char name[kNameSize];
+    int32_t type;       // tChunkType_t
+    int32_t ncols;      // values per row
+    int64_t nrows;
+    int64_t size;       // bytes of data that follow, including padding
+  };
+
+  struct tSliceInfo
+  {
+    double time;
+    int64_t nnodes, nactive, nedges, ntri;
+  };
+
+  struct tIndexEntry
+  {
+    double time;
+    int64_t offset;     // of the slice's chunk header
+  };
+
+  struct tTrailer
+  {
+    int64_t indexOffset;
+    char magic[8];      // "CHILDEND"
+  };
+
+  const int32_t kVersion = 1;
+  const uint32_t kByteOrderMark = 0x01020304;
+
+  // a field of a time slice, in a file or in memory
+  struct tField
+  {
+    const char *name;
+    int type;         // tChunkType_t
+    int ncols;
+    long nrows;
+    const void *data;
+
+    const double *getDoubles() const
+    { return static_cast< const double * >( data ); }
+    const int32_t *getInts() const
+    { return static_cast< const int32_t * >( data ); }
+    const int64_t *getInt64s() const
+    { return static_cast< const int64_t * >( data ); }
+  };
+}
+
+
+/**************************************************************************/
+/**
+** @class tFieldWriter
+**
+** Interface for writing the fields of output time slices. The fields of
+** each slice are written between BeginSlice and EndSlice.
+**
+*/
+/**************************************************************************/
+class tFieldWriter
+{
+public:
+  virtual ~tFieldWriter() {}
+
+  virtual void BeginSlice( double time, int nnodes, int nactive, int nedges,
+                           int ntri ) = 0;
+  // write nrows rows of ncols values each
+  virtual void WriteField( const char *name, const double *, long nrows,
+                           int ncols = 1 ) = 0;
+  virtual void WriteField( const char *name, const int *, long nrows,
+                           int ncols = 1 ) = 0;
+  virtual void WriteField( const char *name, const long *, long nrows,
+                           int ncols = 1 ) = 0;
+  void WriteField( const char *name, const std::vector<double> &v,
+                   int ncols = 1 )
+  { WriteField( name, v.empty() ? 0 : &v[0], v.size()/ncols, ncols ); }
+  void WriteField( const char *name, const std::vector<int> &v,
+                   int ncols = 1 )
+  { WriteField( name, v.empty() ? 0 : &v[0], v.size()/ncols, ncols ); }
+  virtual void EndSlice() = 0;
+  // waits until the slices written so far are in the files
+  virtual void Flush() {}
+  // the output continues a run restarted from a checkpoint, which had
+  // written nslices slices
+  virtual void Resume( int nslices ) {}
+};
+
+
+/**************************************************************************/
+/**
+** @class tOutputFiles
+**
+** Keeps the names of the output files the model has opened, so that a
+** checkpoint can record their sizes. In a run restarted from that
+** checkpoint, Resume is given the recorded sizes: each of these files is
+** then cut back to its size when it is opened again, and continued,
+** instead of being created anew. Other files are created as usual.
+** The streams are flushed before their sizes are taken, so they must
+** remain valid for as long as checkpoints are written (they belong to
+** the model's objects, which are kept until the end of the run).
+**
+*/
+/**************************************************************************/
+class tOutputFiles
+{
+public:
+  // opens an output file; returns the size at which it is continued, or
+  // 0 if it was created
+  static int64_t Open( std::ofstream &, const std::string &name,
+                       std::ios::openmode mode = std::ios::out );
+  // flushes the files opened so far, and gives their names and sizes
+  static void GetSizes( std::vector< std::string > &names,
+                        std::vector< int64_t > &sizes );
+  // files to continue, with their sizes
+  static void Resume( const std::vector< std::string > &names,
+                      const std::vector< int64_t > &sizes );
+
+private:
+  static std::vector< std::string > names;
+  static std::vector< std::ofstream * > streams; // last opened as names[i]
+  static std::map< std::string, int64_t > resumeSizes;
+};
+
+
+/**************************************************************************/
+/**
+** @class tBinaryOutputFile
+**
+** Writes a binary output file. The file is flushed at the end of each
+** slice. A file continued by a restarted run (see tOutputFiles) gets its
+** index from the slices already in the file.
+**
+*/
+/**************************************************************************/
+class tBinaryOutputFile : public tFieldWriter
+{
+  tBinaryOutputFile( const tBinaryOutputFile & );
+  tBinaryOutputFile &operator=( const tBinaryOutputFile & );
+public:
+  tBinaryOutputFile();
+  ~tBinaryOutputFile();
+
+  // a file that is not resumable (a checkpoint) is not registered with
+  // tOutputFiles
+  void Open( const char *fileName, bool resumable = true );
+  // writes the index and closes the file
+  void Close();
+  bool IsOpen() const { return ofs.is_open(); }
+
+  using tFieldWriter::WriteField;
+  void BeginSlice( double time, int nnodes, int nactive, int nedges,
+                   int ntri );
+  void WriteField( const char *name, const double *, long nrows,
+                   int ncols = 1 );
+  void WriteField( const char *name, const int *, long nrows,
+                   int ncols = 1 );
+  void WriteField( const char *name, const long *, long nrows,
+                   int ncols = 1 );
+  void EndSlice();
+  // writes a whole slice (as the fields, which may include int64 values)
+  void WriteSlice( const tBinaryOutput::tSliceInfo &,
+                   const std::vector< tBinaryOutput::tField > & );
+
+private:
+  void WriteChunk( const char *name, int type, int ncols, int64_t nrows,
+                   const void *data, size_t size );
+
+  std::ofstream ofs;
+  int64_t offset;    // current position in the file
+  bool inSlice;
+  std::vector< tBinaryOutput::tIndexEntry > index;
+};
+
+
+/**************************************************************************/
+/**
+** @class tBinaryOutputReader
+**
+** Gives read-only access to a binary output file, which it maps into
+** memory (or, where mmap is not available, reads in whole). The data of a
+** field point directly into the mapped file.
+**
+*/
+/**************************************************************************/
+class tBinaryOutputReader
+{
+  tBinaryOutputReader( const tBinaryOutputReader & );
+  tBinaryOutputReader &operator=( const tBinaryOutputReader & );
+public:
+  typedef tBinaryOutput::tField tField;
+
+  explicit tBinaryOutputReader( const char *fileName );
+  ~tBinaryOutputReader();
+
+  int getNumSlices() const { return static_cast<int>( slices.size() ); }
+  const tBinaryOutput::tSliceInfo &getSlice( int i ) const
+  { return *slices[i]; }
+  double getTime( int i ) const { return slices[i]->time; }
+  // file offset of slice i
+  int64_t getOffset( int i ) const { return sliceOffsets[i]; }
+  // index of the slice at the given time, or -1
+  int FindSlice( double time ) const;
+  // finds a field of slice i; returns false if there is no such field
+  bool FindField( int i, const char *name, tField & ) const;
+  // all fields of slice i, in the order in which they were written
+  void GetFields( int i, std::vector< tField > & ) const;
+
+private:
+  const tBinaryOutput::tChunkHeader *ChunkAt( int64_t offset ) const;
+  bool ReadIndex();
+  void ScanSlices();
+
+  const char *base;  // start of the file in memory
+  int64_t size;      // file size
+  bool mapped;       // base is from mmap (else from new[])
+  std::vector< const tBinaryOutput::tSliceInfo * > slices;
+  std::vector< int64_t > sliceOffsets;
+};
+
+
+/**************************************************************************/
+/**
+** @class tTextSliceIndex
+**
+** Writes <basename>.sidx, the index of the time slices of the text output
+** files: a line for each slice of each file, with the extension of the
+** file, the time (as written in the header of the slice) and the offset
+** of the header in the file. Find looks up a slice, for tListInputData.
+** The files must have been added before their slices are; slices of
+** other files are not indexed.
+**
+*/
+/**************************************************************************/
+class tTextSliceIndex
+{
+  tTextSliceIndex( const tTextSliceIndex & );
+  tTextSliceIndex &operator=( const tTextSliceIndex & );
+public:
+  tTextSliceIndex() {}
+
+  void Open( const std::string &basename );
+  // the file opened as ofs, <basename><extension>, is to be indexed
+  void AddFile( const std::ofstream &ofs, const std::string &extension );
+  // records the slice whose header is about to be written to ofs
+  void AddSlice( std::ofstream &ofs, double time );
+  // offset of the first slice at or after time in <basename><extension>;
+  // false if there is no index, or it has no such slice
+  static bool Find( const std::string &basename, const char *extension,
+                    double time, int64_t &offset );
+
+private:
+  std::ofstream idx;
+  std::map< const std::ofstream *, std::string > extensions;
+};
+
+
+/**************************************************************************/
+/**
+** @class tTextOutputFiles
+**
+** Writes the fields of time slices to the text output files
+** <basename>.nodes, .z, .area, ..., and <basename>.lay<n> for slice n,
+** in the same format as tOutput and tLOutput. A file is created when its
+** fields first appear.
+**
+*/
+/**************************************************************************/
+class tTextOutputFiles
+{
+  tTextOutputFiles( const tTextOutputFiles & );
+  tTextOutputFiles &operator=( const tTextOutputFiles & );
+public:
+  explicit tTextOutputFiles( const std::string &basename );
+  ~tTextOutputFiles();
+
+  // writes slice no. islice (from 0), and flushes the files
+  void WriteSlice( const tBinaryOutput::tSliceInfo &,
+                   const std::vector< tBinaryOutput::tField > &,
+                   int islice );
+
+private:
+  std::string basename;
+  std::vector< std::ofstream * > ofs;  // per file of the text layout
+  tTextSliceIndex index;
+};
+
+#endif
@@ -32,6 +32,7 @@
 #include "../tStreamNet/tStreamNet.h" // For k2DKinematicWave and kHydrographPeakMethod
 #include "../tStratGrid/tStratGrid.h"
 #include "../tFloodplain/tFloodplain.h"
+#include "../tCheckpoint/tCheckpoint.h"
 
 
 /**************************************************************************/
@@ -57,6 +58,8 @@ public:
 //       vegcovofs(orig.vegcovofs), mdLastVolume(orig.mdLastVolume) {}
   tTSOutputImp( tMesh<tSubNode> * meshPtr, const tInputFile &infile );
   void WriteTSOutput();
+  double getLastVolume() const { return mdLastVolume; }
+  void setLastVolume( double v ) { mdLastVolume = v; }
 private:
   std::ofstream volsofs;    // catchment volume
   std::ofstream dvolsofs;
@@ -138,7 +141,8 @@ private:
 template< class tSubNode >
 tOutputBase<tSubNode>::tOutputBase( tMesh<tSubNode> * meshPtr,
 				    const tInputFile &infile ) :
-  m(meshPtr)
+  m(meshPtr),
+  sliceIndex(0)
 {
   assert( meshPtr != 0 );
   infile.ReadItem( baseName, sizeof(baseName), "OUTFILENAME" );
@@ -154,6 +158,8 @@ tOutputBase<tSubNode>::tOutputBase( tMesh<tSubNode> * meshPtr,
  **
  **  Input:  theOFStream -- ptr to an ofstream object
  **          extension -- file name extension (e.g., ".nodes")
+ **          indexed -- whether the slices of the file go into the index
+ **                     of the text output (if there is one)
  **  Output: theOFStream is initialized to create an open output file
  **  Assumes: extension is a null-terminated string, and the length of
  **           baseName plus extension doesn't exceed kMaxNameSize+6
@@ -162,7 +168,8 @@ tOutputBase<tSubNode>::tOutputBase( tMesh<tSubNode> * meshPtr,
 \*************************************************************************/
 template< class tSubNode >
 void tOutputBase<tSubNode>::CreateAndOpenFile( std::ofstream *theOFStream,
-					       const char *extension ) const
+					       const char *extension,
+					       bool indexed ) const
 {
   char fullName[kMaxNameSize+20];  // name of file to be created
 
@@ -173,24 +180,52 @@ void tOutputBase<tSubNode>::CreateAndOpenFile( std::ofstream *theOFStream,
 
   strcpy( fullName, baseName );
   strcat( fullName, extension );
-  theOFStream->open( fullName );
+  tOutputFiles::Open( *theOFStream, fullName );
 
   if( !theOFStream->good() )
     ReportFatalError(
 		     "I can't create files for output. Storage space may be exhausted.");
   theOFStream->precision( 12 );
+  if( sliceIndex != 0 && indexed )
+    sliceIndex->AddFile( *theOFStream, extension );
+}
+
+/*************************************************************************\
+ **
+ **  tOutputBase::CreateAndOpenFile (binary)
+ **
+ **  Opens the binary output file <baseName><extension>.
+ **
+\*************************************************************************/
+template< class tSubNode >
+void tOutputBase<tSubNode>::CreateAndOpenFile( tBinaryOutputFile *theFile,
+					       const char *extension ) const
+{
+  char fullName[kMaxNameSize+20];  // name of file to be created
+
+  if (strlen(baseName)+strlen(extension) >= sizeof(fullName)) {
+    std::cout << "While opening " << baseName << extension << std::endl;
+    ReportFatalError("tOutputCreateAndOpenFile(): buffer too short.");
+  }
+
+  strcpy( fullName, baseName );
+  strcat( fullName, extension );
+  theFile->Open( fullName );
 }
 
 /*************************************************************************\
  **
  **  tBaseOutput::WriteTimeNumberElements
  **
- **  write time and number of elements
+ **  write time and number of elements, after recording the position of
+ **  the slice in the index
 \*************************************************************************/
 template< class tSubNode >
 void tOutputBase<tSubNode>::WriteTimeNumberElements( std::ofstream &fs,
-						     double time, int n )
+						     double time, int n ) const
 {
+  if( sliceIndex != 0 )
+    sliceIndex->AddSlice( fs, time );
   fs << ' ' << time << '\n' << n << '\n';
 }
 
@@ -211,8 +246,36 @@ template< class tSubNode >
 tOutput<tSubNode>::tOutput( tMesh<tSubNode> * meshPtr,
 			    const tInputFile &infile ) :
   tOutputBase<tSubNode>( meshPtr, infile ),  // call base-class constructor
-  CanonicalNumbering(true)
+  CanonicalNumbering(true),
+  fieldofs(0)
 {
+  const bool binary = infile.ReadBool( "OPT_BINARY_OUTPUT", false );
+  const bool async = infile.ReadBool( "OPT_ASYNC_OUTPUT", false );
+  if( binary || async )
+  {
+    // the data go to a tFieldWriter (see tBinaryOutput.h, tAsyncOutput.h)
+    tBinaryOutputFile *binofs = 0;
+    if( binary ) {
+      binofs = new tBinaryOutputFile;
+      this->CreateAndOpenFile( binofs, SBINARY );
+    }
+    if( !async ) {
+      fieldofs = binofs;
+      return;
+    }
+    int bufferMB = infile.ReadInt( "OUTPUT_BUFFER_MB", false );
+    if( bufferMB <= 0 )
+      bufferMB = 256;
+    const size_t maxBytes = static_cast<size_t>(bufferMB) << 20;
+    if( binary )
+      fieldofs = new tAsyncOutput( binofs, maxBytes );
+    else
+      fieldofs = new tAsyncOutput( new tTextOutputFiles( this->baseName ),
+				   maxBytes );
+    return;
+  }
+  this->sliceIndex = new tTextSliceIndex;
+  this->sliceIndex->Open( this->baseName );
   this->CreateAndOpenFile( &nodeofs, SNODES );
   this->CreateAndOpenFile( &edgofs, SEDGES );
   this->CreateAndOpenFile( &triofs, STRI );
@@ -220,6 +283,37 @@ tOutput<tSubNode>::tOutput( tMesh<tSubNode> * meshPtr,
   this->CreateAndOpenFile( &vaofs, SVAREA );
 }
 
+/*************************************************************************\
+ **
+ **  tOutput destructor
+ **
+ **  Closes the binary output file, which writes its index, or waits for the
+ **  output thread to finish.
+ **
+\*************************************************************************/
+template< class tSubNode >
+tOutput<tSubNode>::~tOutput()
+{
+  delete fieldofs;
+  delete this->sliceIndex;
+}
+
+/*************************************************************************\
+ **
+ **  tOutput::Flush
+ **
+ **  Waits until the slices written so far are in the files, e.g. before
+ **  a checkpoint records the sizes of the files. (The text files are
+ **  flushed when their sizes are taken.)
+ **
+\*************************************************************************/
+template< class tSubNode >
+void tOutput<tSubNode>::Flush()
+{
+  if( fieldofs != 0 )
+    fieldofs->Flush();
+}
+
 
 /*************************************************************************\
  **
@@ -260,6 +354,18 @@ void tOutput<tSubNode>::WriteOutput( double time )
 
   if(1)//DEBUG
     std::cout << "tOutput::WriteOutput() loc 1" << std::endl;
+
+  if( fieldofs != 0 )
+  {
+    const int nActiveNodes = this->m->getNodeList()->getActiveSize();
+    fieldofs->BeginSlice( time, nnodes, nActiveNodes, nedges, ntri );
+    WriteMeshFields();
+    WriteNodeData( time );
+    fieldofs->EndSlice();
+    if (1)//DEBUG
+      std::cout << "tOutput::WriteOutput() Output done" << std::endl;
+    return;
+  }
   
   // Write node file, z file, and varea file
   this->WriteTimeNumberElements( nodeofs, time, nnodes);
@@ -320,6 +426,78 @@ void tOutput<tSubNode>::WriteOutput( double time )
     std::cout << "tOutput::WriteOutput() Output done" << std::endl;
 }
 
+/*************************************************************************\
+ **
+ **  tOutput::WriteMeshFields
+ **
+ **  Writes the node, edge and triangle data of WriteOutput as fields, for
+ **  binary or asynchronous output: "xy", "edg", "boundary", "z" and "varea" for the nodes,
+ **  "edges" (origin, destination and counter-clockwise edge IDs) and
+ **  "tri" (as in the .tri file), in the same order as the text output.
+ **  This is ID order, as the IDs have just been renumbered either
+ **  canonically or in list order.
+ **
+\*************************************************************************/
+template< class tSubNode >
+void tOutput<tSubNode>::WriteMeshFields()
+{
+  const int nnodes = this->m->getNodeList()->getSize();
+  const int nedges = this->m->getEdgeList()->getSize();
+  const int ntri = this->m->getTriList()->getSize();
+
+  {
+    std::vector<double> xy( 2*nnodes ), z( nnodes ), varea( nnodes );
+    std::vector<int> edg( nnodes ), boundary( nnodes );
+    typename tMesh< tSubNode >::tIdArrayNode_t RNode(*(this->m->getNodeList()));
+    for( int i=0; i<nnodes; ++i )
+    {
+      tNode *cn = RNode[i];
+      xy[2*i] = cn->getX();
+      xy[2*i+1] = cn->getY();
+      edg[i] = cn->getEdg()->getID();
+      boundary[i] = BoundToInt(cn->getBoundaryFlag());
+      z[i] = cn->getZ();
+      varea[i] = cn->getVArea();
+    }
+    fieldofs->WriteField( "xy", xy, 2 );
+    fieldofs->WriteField( "edg", edg );
+    fieldofs->WriteField( "boundary", boundary );
+    fieldofs->WriteField( "z", z );
+    fieldofs->WriteField( "varea", varea );
+  }
+
+  {
+    std::vector<int> edges( 3*nedges );
+    typename tMesh< tSubNode >::tIdArrayEdge_t REdge(*(this->m->getEdgeList()));
+    for( int i=0; i<nedges; ++i )
+    {
+      tEdge *ce = REdge[i];
+      edges[3*i] = ce->getOriginPtrNC()->getID();
+      edges[3*i+1] = ce->getDestinationPtrNC()->getID();
+      edges[3*i+2] = ce->getCCWEdg()->getID();
+    }
+    fieldofs->WriteField( "edges", edges, 3 );
+  }
+
+  {
+    std::vector<int> tri( 9*ntri );
+    typename tMesh< tSubNode >::tIdArrayTri_t RTri(*(this->m->getTriList()));
+    for( int i=0; i<ntri; ++i )
+    {
+      tTriangle const *ct = RTri[i];
+      const size_t index[] = {ct->index()[0], ct->index()[1], ct->index()[2]};
+      for( int j=0; j<3; ++j )
+      {
+	tTriangle const *nbr = ct->tPtr(index[j]);
+	tri[9*i+j] = ct->pPtr(index[j])->getID();
+	tri[9*i+3+j] = nbr ? nbr->getID() : -1;
+	tri[9*i+6+j] = ct->ePtr(index[j])->getID();
+      }
+    }
+    fieldofs->WriteField( "tri", tri, 9 );
+  }
+}
+
 /*************************************************************************\
  **
  **  tOutput::RenumberID
@@ -372,14 +550,14 @@ tLOutput<tSubNode>::tLOutput( tMesh<tSubNode> *meshPtr,
   
 {
   int opOpt;  // Optional modules: only output stuff when needed
-  this->CreateAndOpenFile( &randomofs, SRANDOM );
-  this->CreateAndOpenFile( &drareaofs, ".area" );
-  this->CreateAndOpenFile( &netofs, ".net" );
-  this->CreateAndOpenFile( &slpofs, ".slp" );
-  this->CreateAndOpenFile( &qofs, ".q" );
-  this->CreateAndOpenFile( &texofs, ".tx" );
-  this->CreateAndOpenFile( &tauofs, ".tau" );
-  this->CreateAndOpenFile( &permIDofs, ".id" );
+  CreateNodeDataFile( &randomofs, SRANDOM );
+  CreateNodeDataFile( &drareaofs, ".area" );
+  CreateNodeDataFile( &netofs, ".net" );
+  CreateNodeDataFile( &slpofs, ".slp" );
+  CreateNodeDataFile( &qofs, ".q" );
+  CreateNodeDataFile( &texofs, ".tx" );
+  CreateNodeDataFile( &tauofs, ".tau" );
+  CreateNodeDataFile( &permIDofs, ".id" );
 
   //Layer output: only write layer information if user selects to write it
   OptLayOutput = infile.ReadBool( "OPTLAYEROUTPUT" );
@@ -390,9 +568,9 @@ tLOutput<tSubNode>::tLOutput( tMesh<tSubNode> *meshPtr,
   // Vegetation cover: if dynamic vegetation option selected
   if( (opOpt = infile.ReadItem( opOpt, "OPTVEG" ) ) != 0)
     {
-      this->CreateAndOpenFile( &vegofs, SVEG );
+      CreateNodeDataFile( &vegofs, SVEG );
       if( (opOpt = infile.ReadItem( opOpt, "OPTFOREST" ) ) != 0 )
-	this->CreateAndOpenFile( &forestofs, SFOREST );
+	CreateNodeDataFile( &forestofs, SFOREST );
     }
   
 
@@ -403,11 +581,11 @@ tLOutput<tSubNode>::tLOutput( tMesh<tSubNode> *meshPtr,
   if( ( miOptFlowGen == tStreamNet::k2DKinematicWave )
       || ( miOptFlowGen == tStreamNet::kSubSurf2DKinematicWave )
       || ( opOpt = infile.ReadItem( opOpt, "CHAN_GEOM_MODEL"))>1 )
-    this->CreateAndOpenFile( &flowdepofs, ".dep" );
+    CreateNodeDataFile( &flowdepofs, ".dep" );
 
   // subsurface discharge: if subsurface kinematic wave option used
   if( miOptFlowGen == tStreamNet::kSubSurf2DKinematicWave )
-    this->CreateAndOpenFile( &qsubofs, ".qsub" );
+    CreateNodeDataFile( &qsubofs, ".qsub" );
 
   // Time-series output: if requested
   if( infile.ReadBool( "OPTTSOUTPUT" ) ) {
@@ -417,27 +595,27 @@ tLOutput<tSubNode>::tLOutput( tMesh<tSubNode> *meshPtr,
   // Channel width output: if the channel geometry model is other
   // than 1 (code for empirical regime channels)
   if( (opOpt = infile.ReadItem( opOpt, "CHAN_GEOM_MODEL" ) ) > 1 )
-    this->CreateAndOpenFile( &chanwidthofs, ".chanwid" );
+    CreateNodeDataFile( &chanwidthofs, ".chanwid" );
 
   // Flow path length output: if using hydrograph peak method for
   // computing discharge
   if( static_cast<tStreamNet::kFlowGen_t>(opOpt = infile.ReadItem( opOpt, "FLOWGEN" ))
       == tStreamNet::kHydrographPeakMethod )
-    this->CreateAndOpenFile( &flowpathlenofs, ".fplen" );
+    CreateNodeDataFile( &flowpathlenofs, ".fplen" );
 
   // Sediment flux: if not using detachment-limited option
   if( (opOpt = infile.ReadItem( opOpt, "OPTDETACHLIM" ) ) == 0){
-     this->CreateAndOpenFile( &qsofs, ".qs" );
-     this->CreateAndOpenFile( &qsinofs, ".qsin" );
-     this->CreateAndOpenFile( &qsdinofs, ".qsdin" );
-     this->CreateAndOpenFile( &dzdtofs, ".dzdt" );
+     CreateNodeDataFile( &qsofs, ".qs" );
+     CreateNodeDataFile( &qsinofs, ".qsin" );
+     CreateNodeDataFile( &qsdinofs, ".qsdin" );
+     CreateNodeDataFile( &dzdtofs, ".dzdt" );
   }  
   if( (opOpt = infile.ReadInt( "OPT_LANDSLIDES", false ) ) == 1 )
     {
-      this->CreateAndOpenFile( &lsforceofs, ".force" );
-      this->CreateAndOpenFile( &publicflagofs, ".flag" );
+      CreateNodeDataFile( &lsforceofs, ".force" );
+      CreateNodeDataFile( &publicflagofs, ".flag" );
     }
-  this->CreateAndOpenFile( &upofs, ".up" );
+  CreateNodeDataFile( &upofs, ".up" );
 
   // If Rectangular Stratigraphy Grid, open several files
   // for writing the stratigraphy at fixed positions
@@ -497,7 +675,7 @@ void tLOutput<tSubNode>::WriteNodeData( double time )
   const int nActiveNodes = this->m->getNodeList()->getActiveSize(); // # active nodes
   const int nnodes = this->m->getNodeList()->getSize(); // total # nodes
 
-  if(OptLayOutput){
+  if(OptLayOutput && this->fieldofs == 0){
     //taking care of layer and x,y,z file, since new one each time step
     char ext[7];
     strcpy( ext, ".lay");
@@ -507,7 +685,7 @@ void tLOutput<tSubNode>::WriteNodeData( double time )
       strncat(ext, &nums[counter/10], 1);
       strncat(ext, &nums[static_cast<int>( fmod(static_cast<double>(counter),10.0) )], 1);
     }
-    this->CreateAndOpenFile( &layofs, ext );
+    this->CreateAndOpenFile( &layofs, ext, false );
   }
 
 #define MY_EXT ".surf"
@@ -517,11 +695,20 @@ void tLOutput<tSubNode>::WriteNodeData( double time )
 #undef MY_EXT
 
   if(Surfer)
-    this->CreateAndOpenFile( &surfofs, extt );
+    this->CreateAndOpenFile( &surfofs, extt, false );
 
   // *Counter that counts the number of write timesteps* 
   counter++;
 
+  if( this->fieldofs != 0 ) {
+    WriteNodeFields( time );
+    if(time > 0 && stratOutput != 0)
+      stratOutput->WriteNodeData( time, counter );
+    if( surfofs.good() )
+      surfofs.close();
+    return;
+  }
+
   // Write current time in each file
   this->WriteTimeNumberElements( randomofs, time, rand->numberRecords());
   this->WriteTimeNumberElements( drareaofs, time, nActiveNodes);
@@ -616,6 +803,197 @@ void tLOutput<tSubNode>::WriteNodeData( double time )
 }
 
 
+/*************************************************************************\
+ **
+ **  tLOutput::CreateNodeDataFile, HasNodeField
+ **
+ **  With text output, CreateNodeDataFile opens the file for a node data
+ **  field; with binary or asynchronous output, it only enables the field,
+ **  which is named after the file extension (without the dot). HasNodeField
+ **  tells whether a field has been enabled.
+ **
+\*************************************************************************/
+template< class tSubNode >
+void tLOutput<tSubNode>::CreateNodeDataFile( std::ofstream *theOFStream,
+					     const char *extension )
+{
+  if( this->fieldofs == 0 )
+    this->CreateAndOpenFile( theOFStream, extension );
+  else
+    nodeFields.push_back( extension );
+}
+
+template< class tSubNode >
+bool tLOutput<tSubNode>::HasNodeField( const char *extension ) const
+{
+  for( size_t i=0; i<nodeFields.size(); ++i )
+    if( nodeFields[i] == extension )
+      return true;
+  return false;
+}
+
+/*************************************************************************\
+ **
+ **  tLOutput::WriteNodeFields
+ **
+ **  Writes the data of WriteNodeData as fields, in node ID
+ **  order, one field per text file: "random" (the state of the random
+ **  number generator), "area", "net", "slp", "q", etc. The layers, when
+ **  requested, are written as three fields: "lay.n" (number of layers of
+ **  each active node), "lay.rec" (ctime, rtime, etime, depth, erody,
+ **  bulk density if OPT_NEW_LAYERSOUTPUT, and sed of each layer) and
+ **  "lay.dgrade" (the sizes of each layer).
+ **
+\*************************************************************************/
+template< class tSubNode >
+void tLOutput<tSubNode>::WriteNodeFields( double time )
+{
+  tFieldWriter &fofs = *(this->fieldofs);
+  const int nActiveNodes = this->m->getNodeList()->getActiveSize();
+  const int nnodes = this->m->getNodeList()->getSize();
+  typename tMesh< tSubNode >::tIdArrayNode_t RNode(*(this->m->getNodeList()));
+  int i;
+
+  {
+    std::vector<long> state( rand->numberRecords() );
+    rand->getState( &state[0] );
+    fofs.WriteField( "random", &state[0], state.size() );
+  }
+
+  // Active nodes
+  if( surfofs.good() )
+    this->WriteTimeNumberElements( surfofs, time, nActiveNodes);
+  {
+    std::vector<double> area( nActiveNodes );
+    std::vector<int> net;
+    net.reserve( nActiveNodes );
+    for( i=0; i<nActiveNodes; ++i ) {
+      tSubNode *cn = RNode[i];
+      area[i] = cn->getDrArea();
+      if( cn->getDownstrmNbr() )
+	net.push_back( cn->getDownstrmNbr()->getID() );
+      if( surfofs.good() )
+	WriteSurferRecord( cn );
+    }
+    fofs.WriteField( "area", area );
+    fofs.WriteField( "net", net );
+  }
+  if(OptLayOutput){
+    const size_t numg = nnodes > 0 ? RNode[0]->getNumg() : 0;
+    const int nrec = OptNewLayOutput ? 7 : 6;
+    std::vector<int> nlay( nActiveNodes );
+    std::vector<double> rec, dgrade;
+    for( i=0; i<nActiveNodes; ++i ) {
+      tSubNode *cn = RNode[i];
+      nlay[i] = cn->getNumLayer();
+      tListIter< tLayer > lI( cn->getLayersRefNC() );
+      for( tLayer *lP=lI.FirstP(); !lI.AtEnd(); lP=lI.NextP() ) {
+	rec.push_back( lP->getCtime() );
+	rec.push_back( lP->getRtime() );
+	rec.push_back( lP->getEtime() );
+	rec.push_back( lP->getDepth() );
+	rec.push_back( lP->getErody() );
+	if( OptNewLayOutput )
+	  rec.push_back( lP->getBulkDensity() );
+	rec.push_back( lP->getSed() );
+	assert( lP->getDgrade().getSize() == numg );
+	for( size_t j=0; j<numg; ++j )
+	  dgrade.push_back( lP->getDgrade(j) );
+      }
+    }
+    fofs.WriteField( "lay.n", nlay );
+    fofs.WriteField( "lay.rec", rec, nrec );
+    fofs.WriteField( "lay.dgrade", dgrade, numg > 0 ? numg : 1 );
+  }
+
+  // All nodes
+  std::vector<double> v( nnodes );
+  std::vector<int> iv( nnodes );
+  for( i=0; i<nnodes; ++i )
+    v[i] = RNode[i]->getBoundaryFlag() == kNonBoundary ?
+      RNode[i]->calcSlope() : 0.;
+  fofs.WriteField( "slp", v );
+  for( i=0; i<nnodes; ++i )
+    v[i] = RNode[i]->getQ();
+  fofs.WriteField( "q", v );
+  if( HasNodeField( SVEG ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getVegCover().getVeg();
+    fofs.WriteField( "veg", v );
+  }
+  if( HasNodeField( SFOREST ) ) {
+    std::vector<double> forest( 6*nnodes );
+    for( i=0; i<nnodes; ++i ) {
+      tTrees *tPtr = RNode[i]->getVegCover().getTrees();
+      forest[6*i] = tPtr->getRootStrength();
+      forest[6*i+1] = tPtr->getMaxRootStrength();
+      forest[6*i+2] = tPtr->getMaxHeightStand();
+      forest[6*i+3] = tPtr->getBioMassStand();
+      forest[6*i+4] = tPtr->getBioMassDown();
+      forest[6*i+5] = tPtr->getStandDeathTime();
+    }
+    fofs.WriteField( "for", forest, 6 );
+  }
+  if( HasNodeField( ".dep" ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getHydrDepth();
+    fofs.WriteField( "dep", v );
+  }
+  if( HasNodeField( ".chanwid" ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getHydrWidth();
+    fofs.WriteField( "chanwid", v );
+  }
+  {
+    std::vector<double> tx;
+    for( i=0; i<nnodes; ++i )
+      if( RNode[i]->getNumg()>1 ) // temporary hack TODO (as in text output)
+	tx.push_back( RNode[i]->getLayerDgrade(0,0)/RNode[i]->getLayerDepth(0) );
+    fofs.WriteField( "tx", tx );
+  }
+  if( HasNodeField( ".fplen" ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getFlowPathLength();
+    fofs.WriteField( "fplen", v );
+  }
+  for( i=0; i<nnodes; ++i )
+    v[i] = RNode[i]->getTau();
+  fofs.WriteField( "tau", v );
+  if( HasNodeField( ".qs" ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getQs();
+    fofs.WriteField( "qs", v );
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getQsin();
+    fofs.WriteField( "qsin", v );
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getQsdin();
+    fofs.WriteField( "qsdin", v );
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getDzDt();
+    fofs.WriteField( "dzdt", v );
+  }
+  for( i=0; i<nnodes; ++i )
+    v[i] = RNode[i]->getUplift();
+  fofs.WriteField( "up", v );
+  for( i=0; i<nnodes; ++i )
+    iv[i] = RNode[i]->getPermID();
+  fofs.WriteField( "id", iv );
+  if( HasNodeField( ".force" ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getNetDownslopeForce();
+    fofs.WriteField( "force", v );
+    for( i=0; i<nnodes; ++i )
+      iv[i] = RNode[i]->public1;
+    fofs.WriteField( "flag", iv );
+  }
+  if( HasNodeField( ".qsub" ) ) {
+    for( i=0; i<nnodes; ++i )
+      v[i] = RNode[i]->getSubSurfaceDischarge();
+    fofs.WriteField( "qsub", v );
+  }
+}
+
 /*************************************************************************\
  **
  **  tLOutput::WriteTSOutput
@@ -635,6 +1013,33 @@ void tLOutput<tSubNode>::WriteTSOutput()
 template< class tSubNode >
 bool tLOutput<tSubNode>::OptTSOutput() const { return BOOL(TSOutput!=0); }
 
+/*************************************************************************\
+ **
+ **  tLOutput::WriteCheckpoint, ReadCheckpoint
+ **
+ **  The state of the output is the number of time slices written, which
+ **  numbers the layer files, and the last volume of the time series
+ **  output. The output files themselves are continued by tOutputFiles.
+ **
+\*************************************************************************/
+template< class tSubNode >
+void tLOutput<tSubNode>::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  ckp.Write( "output", static_cast<long>( counter ) );
+  if( TSOutput )
+    ckp.Write( "output.ts", TSOutput->getLastVolume() );
+}
+
+template< class tSubNode >
+void tLOutput<tSubNode>::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  counter = ckp.ReadInt( "output" );
+  if( TSOutput )
+    TSOutput->setLastVolume( ckp.ReadDouble( "output.ts" ) );
+  if( this->fieldofs != 0 )
+    this->fieldofs->Resume( counter );
+}
+
 /***********************************************************************\
 **
 ** SetStratGrid: set stratGrid
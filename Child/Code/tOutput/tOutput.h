@@ -43,6 +43,8 @@
 #include "../MeshElements/meshElements.h"
 #include "../tInputFile/tInputFile.h"
 #include "../tMesh/tMesh.h"
+#include "tBinaryOutput.h"
+#include "tAsyncOutput.h"
 class tStratGrid;
 class tFloodplain;
 class tStreamNet;
@@ -71,10 +73,14 @@ protected:
   enum{ kMaxNameSize = 80 };
   tMesh<tSubNode> * m;          // ptr to mesh (for access to nodes, etc)
   char baseName[kMaxNameSize];  // name of output files
+  tTextSliceIndex *sliceIndex;  // index of the text files, or 0
 
-  void CreateAndOpenFile( std::ofstream * theOFStream, const char * extension ) const;
-  // write time/number of element
-  static void WriteTimeNumberElements( std::ofstream &, double, int );
+  // (a file that holds a single slice is not indexed)
+  void CreateAndOpenFile( std::ofstream * theOFStream, const char * extension,
+                          bool indexed = true ) const;
+  void CreateAndOpenFile( tBinaryOutputFile * theFile, const char * extension ) const;
+  // write time/number of element (and index the slice)
+  void WriteTimeNumberElements( std::ofstream &, double, int ) const;
 };
 
 /**************************************************************************/
@@ -87,6 +93,15 @@ protected:
  ** virtual function WriteNodeData to write any application-specific
  ** data.
  **
+ ** The text files are indexed by time slice in <baseName>.sidx (see
+ ** tTextSliceIndex).
+ **
+ ** With the option OPT_BINARY_OUTPUT, the data are written instead to a
+ ** single binary file (see tBinaryOutput.h), one field per file of the
+ ** text output. With OPT_ASYNC_OUTPUT, the fields are copied and written,
+ ** to the binary file or the text files, on a separate thread (see
+ ** tAsyncOutput.h).
+ **
  */
 /**************************************************************************/
 template< class tSubNode >
@@ -101,7 +116,10 @@ public:
 //       zofs(orig.zofs), vaofs(orig.vaofs), 
 //       CanonicalNumbering(orig.CanonicalNumbering) {}
   tOutput( tMesh<tSubNode> * meshPtr, const tInputFile &infile );
+  virtual ~tOutput();
   void WriteOutput( double time );
+  // waits until the output written so far is in the files (see tAsyncOutput)
+  void Flush();
 
 private:
   std::ofstream nodeofs;             // output file for node data
@@ -112,12 +130,15 @@ private:
 
 protected:
   bool CanonicalNumbering;      // Output in canonical order
+  tFieldWriter *fieldofs;       // binary or asynchronous output, or 0
 
   virtual void WriteNodeData( double time );
 
 private:
   // renumber in list order
   void RenumberIDInListOrder();
+  // write the mesh to the binary file
+  void WriteMeshFields();
   // write an individual record
   inline void WriteNodeRecord( tNode * );
   inline void WriteEdgeRecord( tEdge * );
@@ -194,10 +215,18 @@ public:
   bool OptNewLayOutput; // stl added 8/10 for writing bulk density
    void SetStratGrid(tStratGrid *, tStreamNet *);
    void SetFloodplain(tFloodplain *);
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
    
 protected:
    virtual void WriteNodeData( double time );
 private:
+   // opens a node data file, or enables the field for fieldofs
+   void CreateNodeDataFile( std::ofstream *, const char *extension );
+   bool HasNodeField( const char *extension ) const;
+   void WriteNodeFields( double time );
+
+   std::vector< std::string > nodeFields; // fields enabled for fieldofs
    std::ofstream randomofs;  // Random number generator state
    std::ofstream drareaofs;  // Drainage areas
    std::ofstream netofs;     // Downstream neighbor IDs
@@ -229,6 +258,7 @@ private:
   int counter;
   bool Surfer; // Output for Surfer Graphic Package
 
+  inline void WriteSurferRecord( tSubNode * );
   inline void WriteActiveNodeData( tSubNode * );
   inline void WriteAllNodeData( tSubNode * );
 };
@@ -260,6 +290,17 @@ private:
 // - Added output of new tLayer::bulkDensity; just put it on the line
 //   after erodibility; hope that doesn't screw up too many Matlab functions.
 
+// Write X,Y,Z,surface properties file, for Surfer visualisation
+// devide drainage area by 10000., easier in visualisation script of surfer.
+template< class tSubNode >
+inline void tLOutput<tSubNode>::WriteSurferRecord( tSubNode *cn )
+{
+  const int i=0;
+  surfofs << cn->getX() <<' ' <<cn->getY() << ' ' << cn->getZ() <<' '
+	  << cn->getDrArea()/10000. <<' ' << cn->getLayerDepth(i) << ' '
+	  << cn->getLayerCtime(i) << ' ' << cn->getLayerRtime(i) << '\n';
+}
+
 template< class tSubNode >
 inline void tLOutput<tSubNode>::WriteActiveNodeData( tSubNode *cn )
 {
@@ -267,15 +308,8 @@ inline void tLOutput<tSubNode>::WriteActiveNodeData( tSubNode *cn )
     std::cout << "WriteActiveNodeData for node " << cn->getPermID() << std::endl;
   
   assert( cn!=0 );
-  // Write X,Y,Z,surface properties file, for Surfer visualisation
-  // devide drainage area by 10000., easier in visualisation script of surfer.
-  {
-    const int i=0;
-    if( surfofs.good() )
-      surfofs << cn->getX() <<' ' <<cn->getY() << ' ' << cn->getZ() <<' '
-	      << cn->getDrArea()/10000. <<' ' << cn->getLayerDepth(i) << ' '
-	      << cn->getLayerCtime(i) << ' ' << cn->getLayerRtime(i) << '\n';
-  }
+  if( surfofs.good() )
+    WriteSurferRecord( cn );
 
   drareaofs << cn->getDrArea() << '\n';
   if( cn->getDownstrmNbr() )
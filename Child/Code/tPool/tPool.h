@@ -0,0 +1,209 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+ **  @file tPool.h
+ **  @brief Header file for the tPool slab allocator.
+ **
+ **  A tPool<T> hands out memory for objects of type T from blocks ("slabs")
+ **  of about kSlabBytes bytes, and keeps freed objects on a free
+ **  list for reuse, instead of going through the global new and delete
+ **  for each object. It is used by the list node classes (tListNodeBasic,
+ **  tListNodeListable and tPtrListNode), whose class-specific operator
+ **  new and delete call tPool::Allocate and tPool::Free. Since mesh nodes,
+ **  edges and triangles are stored inside the nodes of their lists, this
+ **  covers them too; the meandering and mesh densification routines add
+ **  and delete thousands of these per storm.
+ **
+ **  Slabs are never given back to the system: the memory of freed objects
+ **  is only reused for new objects of the same type. Requests for a size
+ **  other than sizeof(T) (i.e., for a derived class) go to the global new
+ **  and delete.
+ **
+ **  Each thread has its own free list and slabs, so that the loops run by
+ **  tThreadPool (see tThreadPool.h) can add and delete list nodes. An
+ **  object freed on another thread than the one that allocated it goes on
+ **  the free list of the thread that frees it, which is safe since slabs
+ **  are never given back.
+ **
+ **  If the environment variable CHILD_POOL_STATS is set, statistics for
+ **  all pools together are kept in tPoolStats, and written to standard
+ **  output at the end of the run, along with the peak resident memory of
+ **  the process where the system provides it.
+ */
+/**************************************************************************/
+
+#ifndef TPOOL_H
+#define TPOOL_H
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <iostream>
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/resource.h>
+#endif
+
+#define CHILD_POOL_STATS "CHILD_POOL_STATS"
+
+/**************************************************************************/
+/**
+ ** @class tPoolStats
+ **
+ ** Counts of the allocations made through all tPools, on all threads,
+ ** when CHILD_POOL_STATS is set. There is only one instance, returned by
+ ** tPoolStats::Get.
+ **
+ */
+/**************************************************************************/
+class tPoolStats
+{
+public:
+  static tPoolStats &Get() { static tPoolStats stats; return stats; }
+  ~tPoolStats() { if( enabled ) Report( std::cout ); }
+
+  void Allocated( size_t size )
+  {
+    if( !enabled ) return;
+    ++nAllocated;
+    const size_t live = liveBytes += size;
+    size_t peak = peakLiveBytes;
+    while( live > peak &&
+           !peakLiveBytes.compare_exchange_weak( peak, live ) )
+      ;
+  }
+  void Freed( size_t size )
+  { if( enabled ) { ++nFreed; liveBytes -= size; } }
+  void NewSlab( size_t size )
+  { if( enabled ) { ++nSlabs; slabBytes += size; } }
+  inline void Report( std::ostream & ) const;
+
+  const bool enabled;    // CHILD_POOL_STATS is set
+  std::atomic< unsigned long > nAllocated; // objects allocated from the pools
+  std::atomic< unsigned long > nFreed;     // objects returned to the pools
+  std::atomic< unsigned long > nSlabs;     // slabs obtained from the system
+  std::atomic< size_t > slabBytes;         // total size of the slabs
+  std::atomic< size_t > liveBytes;         // size of objects now in use
+  std::atomic< size_t > peakLiveBytes;     // largest value of liveBytes
+
+private:
+  tPoolStats() :
+    enabled( getenv( CHILD_POOL_STATS ) != NULL ),
+    nAllocated(0), nFreed(0), nSlabs(0),
+    slabBytes(0), liveBytes(0), peakLiveBytes(0)
+  {}
+  tPoolStats( const tPoolStats & );
+  tPoolStats &operator=( const tPoolStats & );
+};
+
+inline void tPoolStats::Report( std::ostream &out ) const
+{
+  out << "Pool allocator: " << nAllocated << " objects allocated, "
+      << nFreed << " freed, from " << nSlabs << " slabs ("
+      << slabBytes << " bytes); peak in use " << peakLiveBytes
+      << " bytes" << std::endl;
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) == 0 )
+    out << "Peak resident memory: " << usage.ru_maxrss
+#if defined(__APPLE__)
+        << " bytes" << std::endl;
+#else
+        << " kB" << std::endl;
+#endif
+#endif
+}
+
+
+/**************************************************************************/
+/**
+ ** @class tPool
+ **
+ ** Slab allocator for objects of type T (see above). Objects are carved
+ ** from slabs on demand; a freed object goes on the front of the free
+ ** list of its thread, and is the next to be handed out there.
+ **
+ */
+/**************************************************************************/
+template< class T >
+class tPool
+{
+public:
+  static inline void *Allocate( size_t size );
+  static inline void Free( void *ptr, size_t size );
+
+private:
+  enum { kSlabBytes = 16384 };  // approximate size of each slab
+  // An object's storage, or a link in the free list while it is unused
+  // (the other members ensure alignment for any T)
+  union tItem
+  {
+    tItem *next;
+    char storage[sizeof(T)];
+    double alignDouble;
+    long alignLong;
+    void *alignPtr;
+  };
+  // no. of objects per slab (at least 8)
+  enum { kSlabSize = kSlabBytes/sizeof(tItem) > 8 ?
+         kSlabBytes/sizeof(tItem) : 8 };
+  static thread_local tItem *freeList;
+};
+
+template< class T >
+thread_local typename tPool< T >::tItem *tPool< T >::freeList = 0;
+
+/**************************************************************************\
+ **
+ **  tPool::Allocate
+ **
+ **  Returns storage for an object of the given size, which unless it
+ **  is sizeof(T) comes from the global operator new. When the free list is
+ **  empty, a new slab is obtained and all its objects put on the list.
+ **
+\**************************************************************************/
+template< class T >
+inline void *tPool< T >::Allocate( size_t size )
+{
+  if( size != sizeof(T) )
+    return ::operator new( size );
+  if( freeList == 0 )
+  {
+    tItem *slab =
+      static_cast< tItem * >( ::operator new( kSlabSize * sizeof(tItem) ) );
+    for( int i=0; i<kSlabSize-1; ++i )
+      slab[i].next = &slab[i+1];
+    slab[kSlabSize-1].next = 0;
+    freeList = slab;
+    tPoolStats::Get().NewSlab( kSlabSize * sizeof(tItem) );
+  }
+  tItem *item = freeList;
+  freeList = item->next;
+  tPoolStats::Get().Allocated( sizeof(tItem) );
+  return item;
+}
+
+/**************************************************************************\
+ **
+ **  tPool::Free
+ **
+ **  Puts the storage of an object, obtained from Allocate with the same
+ **  size, back on the free list (or back to the global operator delete).
+ **
+\**************************************************************************/
+template< class T >
+inline void tPool< T >::Free( void *ptr, size_t size )
+{
+  if( ptr == 0 ) return;
+  if( size != sizeof(T) )
+  {
+    ::operator delete( ptr );
+    return;
+  }
+  tItem *item = static_cast< tItem * >( ptr );
+  item->next = freeList;
+  freeList = item;
+  tPoolStats::Get().Freed( sizeof(tItem) );
+}
+
+#endif
@@ -49,6 +49,7 @@
 #include <iostream>
 #include <assert.h>
 #include "../compiler.h"
+#include "../tPool/tPool.h"
 
 // do not support these ill-defined functions
 #undef SUPPORT_DEPRECATED
@@ -115,6 +116,11 @@ public:
   inline tPtrListNode( const tPtrListNode< NodeType > & );  // copy constr #1
   inline tPtrListNode( NodeType * );                        // copy constr #2
   inline ~tPtrListNode();                            // destructor
+  // storage comes from a tPool (see tPool.h)
+  static void *operator new( size_t size )
+  { return tPool< tPtrListNode< NodeType > >::Allocate( size ); }
+  static void operator delete( void *ptr, size_t size )
+  { tPool< tPtrListNode< NodeType > >::Free( ptr, size ); }
   const tPtrListNode< NodeType >
   &operator=( const tPtrListNode< NodeType > & );          // assignment
   inline bool operator==( const tPtrListNode< NodeType > & ) const;  // equality
@@ -24,6 +24,8 @@
 
 #include "../tInputFile/tInputFile.h"
 #include "tRunTimer.h"
+#include "../errors/errors.h"
+#include "../tCheckpoint/tCheckpoint.h"
 
 //****************************************************
 // Constructors
@@ -239,3 +241,34 @@ bool tRunTimer::IsFinished() const
 
 
 
+
+//*************************************************
+// WriteCheckpoint, ReadCheckpoint
+//
+// Save and restore the current time, the end time
+// and the times of the next outputs (the intervals
+// come from the input file).
+//*************************************************
+void tRunTimer::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+	std::vector<double> t(5);
+	t[0] = currentTime;
+	t[1] = endTime;
+	t[2] = nextOutputTime;
+	t[3] = nextNotify;
+	t[4] = nextTSOutputTime;
+	ckp.Write( "timer", t );
+}
+
+void tRunTimer::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+	std::vector<double> t;
+	ckp.Read( "timer", t );
+	if( t.size() != 5 )
+		ReportFatalError( "tRunTimer: bad time state in checkpoint." );
+	currentTime = t[0];
+	endTime = t[1];
+	nextOutputTime = t[2];
+	nextNotify = t[3];
+	nextTSOutputTime = t[4];
+}
@@ -17,6 +17,8 @@
 #ifndef TRUNTIMER_H
 #define TRUNTIMER_H
 
+class tCheckpointWriter;
+class tCheckpointReader;
 
 class tRunTimer
 {
@@ -33,6 +35,8 @@ public:
 	bool CheckOutputTime();             // Is it time to write output yet?
 	void ReportTimeStatus();           // Report time to file and (opt) screen
 	bool CheckTSOutputTime();           // Is it time to write time series output yet?
+	void WriteCheckpoint( tCheckpointWriter & ) const;
+	void ReadCheckpoint( const tCheckpointReader & );
 
 private:
 	std::ofstream timeStatusFile;  // file "run.time" for tracking current time
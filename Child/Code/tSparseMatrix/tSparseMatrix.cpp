@@ -0,0 +1,130 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tSparseMatrix.cpp
+**
+**  @brief Implementation of the tSparseMatrix class.
+**
+**  See tSparseMatrix.h.
+*/
+/**************************************************************************/
+
+#include "tSparseMatrix.h"
+
+
+/**************************************************************************\
+**
+**  tSparseMatrix::Clear
+**
+**  Removes all rows, keeping the storage for reuse.
+**
+\**************************************************************************/
+void tSparseMatrix::Clear()
+{
+  mRowStart.assign( 1, 0 );
+  mCol.clear();
+  mVal.clear();
+}
+
+
+/**************************************************************************\
+**
+**  tSparseMatrix::Multiply
+**
+**  Computes y = A x.
+**
+\**************************************************************************/
+void tSparseMatrix::Multiply( const std::vector<double> &x,
+                              std::vector<double> &y ) const
+{
+  const int n = getNumRows();
+  y.resize( n );
+  for( int i=0; i<n; ++i )
+  {
+    double sum = 0.0;
+    for( int k=mRowStart[i]; k<mRowStart[i+1]; ++k )
+      sum += mVal[k] * x[mCol[k]];
+    y[i] = sum;
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tSparseMatrix::SolvePCG
+**
+**  Solves A x = b for a symmetric positive definite A by the conjugate
+**  gradient method with a Jacobi (diagonal) preconditioner, starting from
+**  the x passed in. Iterates until the norm of the residual is no more
+**  than tol times the norm of b, or maxIter iterations have been done.
+**
+**  Returns: number of iterations, or -1 if not converged
+**
+**  Reference: Saad, Y., 2003, Iterative Methods for Sparse Linear
+**    Systems, 2nd ed.: SIAM, Algorithm 9.1.
+**
+\**************************************************************************/
+int tSparseMatrix::SolvePCG( const std::vector<double> &b,
+                             std::vector<double> &x,
+                             double tol, int maxIter ) const
+{
+  const int n = getNumRows();
+  x.resize( n, 0.0 );
+
+  // inverse of the diagonal, for the preconditioner
+  std::vector<double> dinv( n, 1.0 );
+  for( int i=0; i<n; ++i )
+    for( int k=mRowStart[i]; k<mRowStart[i+1]; ++k )
+      if( mCol[k] == i && mVal[k] != 0.0 )
+        dinv[i] = 1.0 / mVal[k];
+
+  std::vector<double> r( n ), z( n ), p( n ), q( n );
+  double bnorm2 = 0.0, rnorm2 = 0.0;
+  Multiply( x, q );
+  for( int i=0; i<n; ++i )
+  {
+    r[i] = b[i] - q[i];
+    bnorm2 += b[i] * b[i];
+    rnorm2 += r[i] * r[i];
+  }
+  const double tol2 = tol * tol * bnorm2;
+  if( rnorm2 <= tol2 ) return 0;
+
+  double rz = 0.0;
+  for( int i=0; i<n; ++i )
+  {
+    z[i] = dinv[i] * r[i];
+    p[i] = z[i];
+    rz += r[i] * z[i];
+  }
+
+  for( int iter=1; iter<=maxIter; ++iter )
+  {
+    Multiply( p, q );
+    double pq = 0.0;
+    for( int i=0; i<n; ++i )
+      pq += p[i] * q[i];
+    const double alpha = rz / pq;
+    rnorm2 = 0.0;
+    for( int i=0; i<n; ++i )
+    {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+      rnorm2 += r[i] * r[i];
+    }
+    if( rnorm2 <= tol2 ) return iter;
+
+    double rzNew = 0.0;
+    for( int i=0; i<n; ++i )
+    {
+      z[i] = dinv[i] * r[i];
+      rzNew += r[i] * z[i];
+    }
+    const double beta = rzNew / rz;
+    rz = rzNew;
+    for( int i=0; i<n; ++i )
+      p[i] = z[i] + beta * p[i];
+  }
+  return -1;
+}
@@ -0,0 +1,58 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tSparseMatrix.h
+**
+**  @brief Header file for the tSparseMatrix class.
+**
+**  A tSparseMatrix is a square sparse matrix stored in compressed sparse
+**  row (CSR) form. It is filled one row at a time, in row order, with
+**  AddEntry and EndRow, and can solve symmetric positive definite
+**  systems by the preconditioned conjugate gradient method (SolvePCG).
+**  Once filled, the values can be changed in place with SetEntry, so
+**  that a matrix with the same pattern need not be assembled again.
+**  It was written for the implicit hillslope diffusion solutions in
+**  tErosion, whose matrices have one row per active node and one
+**  off-diagonal entry per neighbor.
+*/
+/**************************************************************************/
+
+#ifndef TSPARSEMATRIX_H
+#define TSPARSEMATRIX_H
+
+#include <vector>
+
+class tSparseMatrix
+{
+public:
+  tSparseMatrix() : mRowStart( 1, 0 ) {}
+
+  // Empties the matrix, ready to be filled again from row 0
+  void Clear();
+  // Adds an entry to the current row (no duplicate columns in a row)
+  void AddEntry( int col, double val )
+  { mCol.push_back( col ); mVal.push_back( val ); }
+  // Ends the current row; the next AddEntry goes in the following row
+  void EndRow() { mRowStart.push_back( static_cast<int>(mCol.size()) ); }
+  // Number of rows finished so far
+  int getNumRows() const { return static_cast<int>(mRowStart.size())-1; }
+  // Number of entries added so far; entry k is the k'th added
+  int getNumEntries() const { return static_cast<int>(mVal.size()); }
+  // Changes the value of entry k, keeping the pattern of the matrix
+  void SetEntry( int k, double val ) { mVal[k] = val; }
+
+  // y = A x
+  void Multiply( const std::vector<double> &x, std::vector<double> &y ) const;
+  // Solves A x = b, starting from the x given; returns the number of
+  // iterations, or -1 if the relative residual did not fall below tol
+  int SolvePCG( const std::vector<double> &b, std::vector<double> &x,
+                double tol, int maxIter ) const;
+
+private:
+  std::vector<int> mRowStart; // index in mCol/mVal of the start of each row
+  std::vector<int> mCol;      // column of each entry
+  std::vector<double> mVal;   // value of each entry
+};
+
+#endif
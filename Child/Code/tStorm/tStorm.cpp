@@ -22,6 +22,9 @@
 #include <fstream>
 
 #include "tStorm.h"
+#include "../tOutput/tBinaryOutput.h"
+#include "../errors/errors.h"
+#include "../tCheckpoint/tCheckpoint.h"
 
 /**************************************************************************\
 **
@@ -108,7 +111,7 @@ tStorm::tStorm( const tInputFile &infile, tRand *rand_,
       infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
       strcat( fname, THEEXT );
 #undef THEEXT
-      stormfile.open( fname );
+      tOutputFiles::Open( stormfile, fname );
       if( !stormfile.good() )
           std::cerr << "Warning: unable to create storm data file '"
 		    << fname << "'\n";
@@ -147,7 +150,7 @@ void tStorm::TurnOnOutput( const tInputFile& infile )
       infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
       strcat( fname, THEEXT );
 #undef THEEXT
-      stormfile.open( fname );
+      tOutputFiles::Open( stormfile, fname );
       if( !stormfile.good() )
           std::cerr << "Warning: unable to create storm data file '"
 		    << fname << "'\n";
@@ -262,6 +265,37 @@ void tStorm::setRainrate( double pMeanNew )
 }
 
 
+/**************************************************************************\
+**
+**  tStorm::WriteCheckpoint, ReadCheckpoint
+**
+**  Save and restore the current storm. The rainfall time series come
+**  from the input file.
+**
+\**************************************************************************/
+void tStorm::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  std::vector<double> s(4);
+  s[0] = p;
+  s[1] = stdur;
+  s[2] = istdur;
+  s[3] = endtm;
+  ckp.Write( "storm", s );
+}
+
+void tStorm::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  std::vector<double> s;
+  ckp.Read( "storm", s );
+  if( s.size() != 4 )
+    ReportFatalError( "tStorm: bad storm state in checkpoint." );
+  p = s[0];
+  stdur = s[1];
+  istdur = s[2];
+  endtm = s[3];
+}
+
+
 /**************************************************************************\
 **
 **  GammaDev
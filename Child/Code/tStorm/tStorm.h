@@ -41,6 +41,9 @@
 #include <iosfwd>
 #include <sstream>
 
+class tCheckpointWriter;
+class tCheckpointReader;
+
 class tStorm
 {
 public:
@@ -56,6 +59,8 @@ public:
   void TurnOffOutput();
   inline void setRand( tRand* ptr ) {rand = ptr;}
   void setRainrate( double );
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
 
 private:
     double ExpDev() const;
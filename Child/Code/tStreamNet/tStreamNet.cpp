@@ -17,9 +17,15 @@
 /**************************************************************************/
 
 #include <assert.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
 //#include <string>
 #include "../errors/errors.h"
 #include "tStreamNet.h"
+#include "../tCheckpoint/tCheckpoint.h"
+#include "../tThreadPool/tThreadPool.h"
 
 tStreamNet::kChannelType_t tStreamNet::IntToChannelType( int c ){
   switch(c){
@@ -72,7 +78,13 @@ stormPtr(&storm),
 trans(0), infilt(0),
 inlet( &meshRef, infile ),
 optSinVarInfilt(false),
-mpParkerChannels(0)
+mpParkerChannels(0),
+mFlowStackValid(false),
+mNetOrderValid(false),
+mNetOrderMulti(false),
+mBasinOrder(),
+mBasinStart(),
+mBasinsValid(false)
 {
   if (0) //DEBUG
     std::cout << "tStreamNet(...)...";
@@ -130,7 +142,11 @@ mpParkerChannels(0)
     mdHydrgrphShapeFac = infile.ReadItem( mdHydrgrphShapeFac, "HYDROSHAPEFAC" );
   }
   
-  //    optMultipleFlowDirections = infile.ReadBool( "OPT_MULTIPLE_FLOW_DIR", false );
+  optMultipleFlowDirections = infile.ReadBool( "OPT_MULTIPLE_FLOW_DIR", false );
+  // Option to accumulate drainage area and discharge in a single pass
+  // over a donor/receiver stack, rather than walking downstream from
+  // every node in turn
+  optStackFlowAccum = infile.ReadBool( "OPT_STACK_FLOW_ACCUMULATION", false );
   
   // Get the initial rainfall rate from the storm object, and read in option
   // for stochastic variation in rainfall
@@ -250,7 +266,15 @@ mdMeshAdaptMinArea(orig.mdMeshAdaptMinArea),  // Dr area threshold for densifyin
 mdMeshAdaptMaxVArea(orig.mdMeshAdaptMaxVArea), // Max voronoi area for nodes above threshold
 mdHydrgrphShapeFac(orig.mdHydrgrphShapeFac),  // "Fhs" for hydrograph peak method
 mdFlowVelocity(orig.mdFlowVelocity),      // Runoff velocity for computing travel time
-optVariableTransmissivity(orig.optVariableTransmissivity) // option for soil depth-dependent transmissivity
+optVariableTransmissivity(orig.optVariableTransmissivity), // option for soil depth-dependent transmissivity
+optMultipleFlowDirections(orig.optMultipleFlowDirections), // option for flow routing via MFD algorithm
+optStackFlowAccum(orig.optStackFlowAccum), // option for single-pass (stack) flow accumulation
+mFlowStackValid(false),
+mNetOrderValid(false),
+mNetOrderMulti(false),
+mBasinOrder(),
+mBasinStart(),
+mBasinsValid(false)
 {
   if( orig.mpParkerChannels )
     mpParkerChannels = new tParkerChannels( *orig.mpParkerChannels );  // -> tParkerChannels object
@@ -903,6 +927,7 @@ void tStreamNet::ShowMeanderNeighbours(int debugID) const
  **   - if edge length is zero, it is calculated
  **   - complementary edges on the list are assumed to be organized pairwise;
  **     that is, edges AB and BA are always together, for example.
+ **   - the pairs are done in parallel (see tThreadPool.h)
  **
  **  TODO: should be a member of tMesh!
  **
@@ -910,15 +935,15 @@ void tStreamNet::ShowMeanderNeighbours(int debugID) const
 void tStreamNet::CalcSlopes()
 {
   assert( meshPtr != 0 );
-  tEdge *curedg;
-  tMesh< tLNode >::edgeListIter_t i( meshPtr->getEdgeList() );
+  const std::vector< tEdge * > &edges = meshPtr->getEdgePtrs();
   
   if (0) //DEBUG
     std::cout << "CalcSlopes()...";
   
   // Loop through each pair of edges on the list
-  for( curedg = i.FirstP(); !( i.AtEnd() ); curedg = i.NextP() )
-  {
+  assert( edges.size() % 2 == 0 );
+  tThreadPool::ParallelFor( edges.size() / 2, [&edges]( long k ) {
+    tEdge *curedg = edges[2*k];
     // Make sure edge is valid, and length is nonzero
     assert( curedg != 0 );
     assert( curedg->getLength() > 0 );
@@ -930,12 +955,12 @@ void tStreamNet::CalcSlopes()
     curedg->setSlope( slp );
     
     // Advance to the edge's complement, and assign it -slp
-    curedg = i.NextP();
-    assert( !( i.AtEnd() ) );
+    curedg = edges[2*k+1];
+    assert( curedg == edges[2*k]->getComplementEdge() );
     curedg->setSlope( -slp );
     //curedg->setLength( length );
     assert( curedg->getLength() > 0 );
-  }
+  } );
   if (0) //DEBUG
     std::cout << "CalcSlopes() finished" << std::endl;
 }
@@ -958,27 +983,25 @@ void tStreamNet::CalcSlopes()
 #define kMaxSpokes 100
 void tStreamNet::InitFlowDirs()
 {
-  tMesh< tLNode >::nodeListIter_t i( meshPtr->getNodeList() );
-  tLNode * curnode;
-  tEdge * flowedg;
-  int ctr;
+  const std::vector< tLNode * > &nodes = meshPtr->getActiveNodePtrs();
   
   if (0) //DEBUG
     std::cout << "InitFlowDirs()...\n";
+  FlowDirsChanged();
   
   // For every active (non-boundary) node, initialize it to flow to a
-  // non-boundary node (ie, along a "flowAllowed" edge)
-  curnode = i.FirstP();
-  while( i.IsActive() )
-  {
+  // non-boundary node (ie, along a "flowAllowed" edge); the nodes are
+  // done in parallel (see tThreadPool.h)
+  tThreadPool::ParallelFor( nodes.size(), [&nodes]( long k ) {
+    tLNode * curnode = nodes[k];
     // Start with the node's default edge
     assert( curnode!=0 );
-    flowedg = curnode->getEdg();
+    tEdge * flowedg = curnode->getEdg();
     assert( flowedg!=0 );
     
     // As long as the current edge is a no-flow edge, advance to the next one
     // counter-clockwise
-    ctr = 0;
+    int ctr = 0;
     while( !flowedg->FlowAllowed() )
     {
       flowedg = flowedg->getCCWEdg();
@@ -994,8 +1017,7 @@ void tStreamNet::InitFlowDirs()
     }
     curnode->setFlowEdg( flowedg );
     assert( curnode->getFlowEdg() != 0 );
-    curnode = i.NextP();
-  }
+  } );
   
   if (0) //DEBUG
     std::cout << "finished\n";
@@ -1023,6 +1045,7 @@ void tStreamNet::ReInitFlowDirs()
 {
   if (0) //DEBUG
     std::cout << "ReInitFlowDirs()...\n";
+  FlowDirsChanged();
   // For every active (non-boundary) node, initialize it to flow to a
   // non-boundary node (ie, along a "flowAllowed" edge)
   tMesh< tLNode >::nodeListIter_t i( meshPtr->getNodeList() );
@@ -1162,30 +1185,40 @@ void tStreamNet::ReInitFlowDirs()
  **       - edge slopes are up to date
  **      Updated: 12/19/97 SL; 12/30/97 GT
  **
+ **  The nodes are done in parallel (see tThreadPool.h), in two passes.
+ **  The first chooses the flow edge of each node and stores it in
+ **  mFlowEdg, by the node's place among the active nodes, with a flag for
+ **  sinks in mFlowSink. The second sets the nodes' flow edges and flood
+ **  status from these. A choice depends only on the node's previous flow
+ **  edge and its spokes (slopes, and whether the nodes they lead to
+ **  meander), which the first pass does not change, so the results do not
+ **  depend on the number of threads.
+ **
  \****************************************************************************/
 #define kMaxSpokes 100
 void tStreamNet::FlowDirs()
 {
-  tMesh< tLNode >::nodeListIter_t i( meshPtr->getNodeList() );  // gets nodes from the list
-  double slp=0;                          // steepest slope found so far
-  double meanderslp = 0;		// steepest meander slope found so far
-  double selectslope;			// value of the selected slope
-  tLNode *curnode;                     // ptr to the current node
-                                       //XtLNode *newnode;  // ptr to new downstream node
-                                       //XtLNode * nbr;
-  tEdge * firstedg(0);   // ptr to first edg
-  tEdge * curedg;     // pointer to current edge
-  tEdge * nbredg(0);     // steepest neighbouring edge so far
-  tEdge * meanderedg = NULL;  // steepest meander edge so far
-  
-  int ctr;
+  const std::vector< tLNode * > &nodes = meshPtr->getActiveNodePtrs();
+  const long nnodes = static_cast<long>( nodes.size() );
+  
+  FlowDirsChanged();
   
   // Find the connected edge with the steepest slope
-  curnode = i.FirstP();
-  while( i.IsActive() )  // DO for each non-boundary (active) node   = LOOP OVER NODES !
+  mFlowEdg.resize( nnodes );
+  mFlowSink.resize( nnodes );
+  tThreadPool::ParallelFor( nnodes, [&]( long k )  // LOOP OVER NODES !
   {
-    selectslope = 0.0;
-    curnode->setFloodStatus( tLNode::kNotFlooded );  // Init flood status flag
+    tLNode *curnode = nodes[k];          // ptr to the current node
+    double slp=0;                          // steepest slope found so far
+    double meanderslp = 0;		// steepest meander slope found so far
+    double selectslope = 0.0;		// value of the selected slope
+    tEdge * firstedg(0);   // ptr to first edg
+    tEdge * curedg;     // pointer to current edge
+    tEdge * nbredg(0);     // steepest neighbouring edge so far
+    tEdge * meanderedg = NULL;  // steepest meander edge so far
+    bool sink;                 // whether the node is a sink
+    int ctr;
+    
     firstedg =  curnode->getFlowEdg();
     if( unlikely(firstedg == 0) ) {
       curnode->TellAll();
@@ -1193,6 +1226,7 @@ void tStreamNet::FlowDirs()
     }
     slp = firstedg->getSlope();
     nbredg = firstedg;
+    tEdge * flowedg = firstedg;  // selected edge
 	  if(0) //DEBUG
 	  {
       if(curnode->getID()==8121 /*|| curnode->getID()==213*/) {
@@ -1292,13 +1326,13 @@ void tStreamNet::FlowDirs()
             if(slp > meanderslp){
               if(0) //DEBUG
                 if( curnode->getID()==8121 || curnode->getID()==8122 ) std::cout << "FlowDirs: steepest desc mnds, change dir\n";
-              curnode->setFlowEdg( nbredg);
+              flowedg = nbredg;
               selectslope = slp;
             }
             else if(slp <= meanderslp){
               if(0) //DEBUG
                 if( curnode->getID()==8121 || curnode->getID()==8122 ) std::cout << "FlowDirs: cur mndr IS steepest\n";
-              curnode->setFlowEdg( meanderedg);
+              flowedg = meanderedg;
               selectslope = meanderslp;
             }
           } // end i
@@ -1311,11 +1345,11 @@ void tStreamNet::FlowDirs()
             {
               if( nbredg->getDestinationPtr()->getBoundaryFlag() != kOpenBoundary )
               {
-                curnode->setFlowEdg( meanderedg);
+                flowedg = meanderedg;
                 selectslope = meanderslp;
               }
               else{
-                curnode->setFlowEdg( nbredg);
+                flowedg = nbredg;
                 selectslope = slp;
                 if(0) //debug
                 {
@@ -1331,7 +1365,7 @@ void tStreamNet::FlowDirs()
               {
                 if(0) //DEBUG
                   if( curnode->getID()==8121 || curnode->getID()==8122 ) std::cout << "FlowDirs: steepest doesn't mdr, staying w/ current dir\n";
-                curnode->setFlowEdg( meanderedg);
+                flowedg = meanderedg;
                 selectslope = meanderslp;
                 if(0) //DEBUG
                 {
@@ -1345,7 +1379,7 @@ void tStreamNet::FlowDirs()
               }
               else
               {
-                curnode->setFlowEdg( nbredg);
+                flowedg = nbredg;
                 selectslope = slp;
                 if(0) //debug
                 {
@@ -1358,14 +1392,14 @@ void tStreamNet::FlowDirs()
           
         } // end if
         else{ // all other cases, no menadering nodes involved
-          curnode->setFlowEdg( nbredg );
+          flowedg = nbredg;
           selectslope = slp;
         }
         
         if(0) //DEBUG
         {
           if(curnode->getID()==8121 || curnode->getID()==8122 ) {
-            tEdge * debugedg = curnode->getFlowEdg();
+            tEdge * debugedg = flowedg;
             tLNode * nbr = static_cast<tLNode *>(debugedg->getDestinationPtrNC());
             std::cout<<"FlowDirs 3: node "<<curnode->getID()<<" edge "<<debugedg->getID()<<" slp "<<selectslope<<" downstream nbr "<<nbr->getID()<<std::endl;
             std::cout<<"z "<<curnode->getZ()<<" dsn z "<<nbr->getZ();
@@ -1442,11 +1476,11 @@ void tStreamNet::FlowDirs()
         
         // If the selected node has a positve slope
         if( (selectslope>0) && (curnode->getBoundaryFlag() != kClosedBoundary) ){
-          curnode->setFloodStatus( tLNode::kNotFlooded );
+          sink = false;
           
         }
         else{
-          curnode->setFloodStatus( tLNode::kSink );
+          sink = true;
           if( 0 && curnode->Meanders() ){
             std::cout<<"WARNING-Type 2, from tStreamNet::CalcSlopes....detected a meander node without positive drainage"<<std::endl;
             std::cout<<"ID= "<<curnode->getID()<<", X= "<<curnode->getX()<<", Y= "<<curnode->getY()<<", Z= "<<curnode->getZ()<<std::endl;
@@ -1460,7 +1494,7 @@ void tStreamNet::FlowDirs()
         if(0) //DEBUG
         {
           if(curnode->getID()==8121 || curnode->getID()==8122 ) {
-            tEdge * debugedg = curnode->getFlowEdg();
+            tEdge * debugedg = flowedg;
             tLNode * nbr = static_cast<tLNode *>(debugedg->getDestinationPtrNC());
             std::cout<<"FlowDirs 4: node "<<curnode->getID()<<" edge "<<debugedg->getID()<<" slp "<<selectslope<<" downstream nbr "<<nbr->getID()<<std::endl;
             std::cout<<"z "<<curnode->getZ()<<" dsn z "<<nbr->getZ();
@@ -1468,9 +1502,19 @@ void tStreamNet::FlowDirs()
           }
         }
         
-        curnode = i.NextP();                // Continue with the next node on the active list
+        mFlowEdg[k] = flowedg;
+        mFlowSink[k] = sink;
         
-      } // end of node loop
+      } ); // end of node loop
+      
+      // Set the nodes' flow edges and flood status (the sink flags are kept
+      // as chars, not in a vector<bool>, whose elements share words)
+      tThreadPool::ParallelFor( nnodes, [&]( long k ) {
+        tLNode *curnode = nodes[k];
+        curnode->setFlowEdg( mFlowEdg[k] );
+        curnode->setFloodStatus( mFlowSink[k] ? tLNode::kSink
+                                 : tLNode::kNotFlooded );
+      } );
       
       if (0) //DEBUG
         std::cout << "FlowDirs() finished" << std::endl;
@@ -1495,8 +1539,16 @@ void tStreamNet::FlowDirs()
  **
  **  Note that each node's drainage area includes its own Voronoi area.
  **
+ **  If OPT_STACK_FLOW_ACCUMULATION is set, the cascade is replaced by a
+ **  single pass over the donor/receiver stack built by BuildFlowStack, so
+ **  the cost is O(N) rather than O(N x path length). The totals are the
+ **  same but are summed in a different order, so they can differ from the
+ **  cascade in the last bits.
+ **
  **    Calls: RouteFlowArea, tLNode::setDrArea, tInlet::FindNewInlet
  **    Modifies:  node drainage area
+ **    Assumes: BuildFlowStack has been called since the last change in
+ **             flow directions, if the stack option is used
  **
  \*****************************************************************************/
 void tStreamNet::DrainAreaVoronoi()
@@ -1526,9 +1578,36 @@ void tStreamNet::DrainAreaVoronoi()
       exit(1);
     }
     
-    RouteFlowArea( curnode, curnode->getVArea() );
+    if( !optStackFlowAccum )
+      RouteFlowArea( curnode, curnode->getVArea() );
+  }
+  
+  if( optStackFlowAccum )
+  {
+    // Stack version: each node starts with its own Voronoi area (plus the
+    // inlet area at the inlet node), then a single pass from the top of
+    // the stack passes each node's total on to its receiver. Sinks neither
+    // collect nor pass on area, as in RouteFlowArea.
+    const int nstack = static_cast<int>(mFlowStack.size());
+    std::vector< double > area( nstack, 0. );
+    for( int i=0; i<nstack; ++i )
+    {
+      curnode = mFlowStack[i];
+      if( curnode->getFloodStatus()==tLNode::kSink ) continue;
+      area[i] = curnode->getVArea();
+      if( curnode==inlet.innode )
+        area[i] += inlet.inDrArea;
+    }
+    for( int i=nstack-1; i>=0; --i )
+    {
+      const int r = mFlowRcvr[i];
+      if( r>=0 && mFlowStack[r]->getFloodStatus()!=tLNode::kSink )
+        area[r] += area[i];
+    }
+    for( int i=0; i<nstack; ++i )
+      mFlowStack[i]->setDrArea( area[i] );
   }
-  if( inlet.innode != 0 )
+  else if( inlet.innode != 0 )
   {
 #if 1
     //inlet.FindNewInlet();            QC commented this out -> avoid channel hopping around
@@ -1555,35 +1634,65 @@ void tStreamNet::DrainAreaVoronoi()
  **
  **  Note that each node's drainage area includes its own Voronoi area.
  **
+ **  With OPT_STACK_FLOW_ACCUMULATION, the recursive cascade (whose cost grows
+ **  with the number of flow paths) is replaced by one pass over the
+ **  upstream-to-downstream order built by BuildFlowOrderMFD.
+ **
  **    Calls: RouteFlowAreaMultipleFlowDirections, tLNode::setDrArea
  **    Modifies:  node drainage area
  **
  \*****************************************************************************/
-// void tStreamNet::DrainAreaVoronoiMFD()
-// {
-//    if (0) //DEBUG
-//      std::cout << "DrainAreaVoronoiMFD()..." << std::endl;
-
-//    tLNode * curnode;
-//    tMesh< tLNode >::nodeListIter_t nodIter( meshPtr->getNodeList() );
-
-//    // Reset drainage areas to zero
-//    for( curnode = nodIter.FirstP(); nodIter.IsActive();
-//         curnode = nodIter.NextP() )
-//        curnode->setDrArea( 0. );
-
-//    // send voronoi area for each node to the node at the other end of the
-//    // flowedge and downstream
-//    for( curnode = nodIter.FirstP(); nodIter.IsActive();
-//         curnode = nodIter.NextP() )
-//      RouteFlowAreaMultipleDirections( curnode, curnode->getVArea() );
-
-//    if( inlet.innode != 0 )
-//       RouteFlowAreaMultipleDirections( inlet.innode, inlet.inDrArea );
-
-//    if (0) //DEBUG
-//      std::cout << "DrainAreaVoronoiMFD() finished" << std::endl;
-// }
+void tStreamNet::DrainAreaVoronoiMFD()
+{
+  if (0) //DEBUG
+    std::cout << "DrainAreaVoronoiMFD()..." << std::endl;
+  
+  tLNode * curnode;
+  tMesh< tLNode >::nodeListIter_t nodIter( meshPtr->getNodeList() );
+  
+  // Reset drainage areas to zero
+  for( curnode = nodIter.FirstP(); nodIter.IsActive();
+      curnode = nodIter.NextP() )
+    curnode->setDrArea( 0. );
+  
+  if( !optStackFlowAccum )
+  {
+    // send voronoi area for each node to the node at the other end of the
+    // flowedge and downstream
+    for( curnode = nodIter.FirstP(); nodIter.IsActive();
+        curnode = nodIter.NextP() )
+      RouteFlowAreaMultipleDirections( curnode, curnode->getVArea() );
+    
+    if( inlet.innode != 0 )
+      RouteFlowAreaMultipleDirections( inlet.innode, inlet.inDrArea );
+  }
+  else
+  {
+    // Single pass in upstream-to-downstream order: by the time a node is
+    // reached it holds its own area plus everything sent to it from
+    // upstream, which is then partitioned among its receivers.
+    std::vector< tLNode * > rcvrs;
+    std::vector< double > wts;
+    std::vector< tLNode * >::const_iterator it;
+    for( it = mFlowOrderMFD.begin(); it != mFlowOrderMFD.end(); ++it )
+    {
+      curnode = *it;
+      if( curnode->getFloodStatus()==tLNode::kSink ) continue;
+      curnode->AddDrArea( curnode->getVArea() );
+      if( curnode==inlet.innode )
+        curnode->AddDrArea( inlet.inDrArea );
+      const double addedArea = curnode->getDrArea();
+      const double totalSlopeLengthProd = MFDReceivers( curnode, rcvrs, wts );
+      for( size_t j=0; j<rcvrs.size(); ++j )
+        if( rcvrs[j]->getBoundaryFlag() == kNonBoundary &&
+            rcvrs[j]->getFloodStatus() != tLNode::kSink )
+          rcvrs[j]->AddDrArea( addedArea * wts[j] / totalSlopeLengthProd );
+    }
+  }
+  
+  if (0) //DEBUG
+    std::cout << "DrainAreaVoronoiMFD() finished" << std::endl;
+}
 
 /*****************************************************************************\
  **
@@ -1605,6 +1714,7 @@ void tStreamNet::FlowPathLength()
   
   // Sort nodes in upstream-to-downstream order
   SortNodesByNetOrder( false );
+  tNetOrderIter netIter( *this );
   
   // Reset all flow path lengths to zero
   for( curnode = nodeIter.FirstP(); nodeIter.IsActive();
@@ -1615,8 +1725,8 @@ void tStreamNet::FlowPathLength()
   // the flow path length of each node's downstream neighbor to the
   // maximum of (a) the current node's flow path length plus the length of
   // the flow edge, or (b) the downstream node's existing flow path length.
-  for( curnode = nodeIter.FirstP(); nodeIter.IsActive();
-      curnode = nodeIter.NextP() )
+  for( curnode = netIter.FirstP(); netIter.IsActive();
+      curnode = netIter.NextP() )
   {
     // Compute "local" flow path length to the downstream neighbor --
     // equal to flow path length at the current node plus the length of
@@ -1723,43 +1833,78 @@ void tStreamNet::RouteFlowArea( tLNode *curnode, double addedArea )
  **  From Quinn et al., 1991.
  **  SL, 2010
  \*****************************************************************************/
-// void tStreamNet::RouteFlowAreaMultipleDirections( tLNode *curnode, double addedArea )
-// {
-//   if( curnode->getBoundaryFlag() == kNonBoundary &&
-//       curnode->getFloodStatus() != tLNode::kSink )
-//     {
-//       curnode->AddDrArea( addedArea );
-//       tSpkIter sI( curnode );
-//       double totalSlopeLengthProd=0.0;
-//       tPtrList<tLNode> downhillNbrs;
-//       tList<double> downhillSlopeLengthProds;
-//       for( tEdge *ce = sI.FirstP(); !sI.AtEnd(); ce = sI.NextP() )
-// 	if( ce->getSlope() > 0.0 && 
-// 	    ce->getDestinationPtr()->getBoundaryFlag() != kClosedBoundary )
-// 	  { // downhill to non-boundary or open boundary:
-// 	    const double edgeSlopeLengthProd = ce->getSlope() * ce->getVEdgLen();
-// 	    totalSlopeLengthProd += edgeSlopeLengthProd;
-// 	    downhillSlopeLengthProds.insertAtBack( edgeSlopeLengthProd );
-// 	    tLNode *dn = static_cast<tLNode*>( ce->getDestinationPtrNC() );
-// 	    downhillNbrs.insertAtBack( dn );
-// 	  }
-//       if( !downhillNbrs.isEmpty() )
-// 	{
-// 	  tLNode *dn=0;
-// 	  while( ( dn = downhillNbrs.removeFromFront() ) )
-// 	    {
-// 	      double localSlopeLengthProd=0.0;
-// 	      downhillSlopeLengthProds.removeFromFront( localSlopeLengthProd );
-// 	      RouteFlowAreaMultipleDirections( dn, 
-// 					       addedArea * localSlopeLengthProd 
-// 					       / totalSlopeLengthProd );
-// 	    }
-// 	}
-//       else // if no downslope neighbors, then there's still a flowedge,
-// 	// so send all the area to that node:
-// 	RouteFlowAreaMultipleDirections( curnode->getDownstrmNbr(), addedArea );
-//     }
-// }
+void tStreamNet::RouteFlowAreaMultipleDirections( tLNode *curnode, double addedArea )
+{
+  if( curnode->getBoundaryFlag() == kNonBoundary &&
+      curnode->getFloodStatus() != tLNode::kSink )
+    {
+      curnode->AddDrArea( addedArea );
+      std::vector< tLNode * > downhillNbrs;
+      std::vector< double > downhillSlopeLengthProds;
+      const double totalSlopeLengthProd =
+	MFDReceivers( curnode, downhillNbrs, downhillSlopeLengthProds );
+      for( size_t j=0; j<downhillNbrs.size(); ++j )
+	RouteFlowAreaMultipleDirections( downhillNbrs[j],
+					 addedArea * downhillSlopeLengthProds[j]
+					 / totalSlopeLengthProd );
+    }
+}
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::MFDReceivers
+ **
+ **  Finds the nodes that receive flow from _curnode_ under the multiple
+ **  flow direction algorithm: all downhill neighbours that are not closed
+ **  boundaries, weighted by slope times Voronoi edge length. If there
+ **  isn't at least one downhill neighbour, lake filling has produced a
+ **  flowedge, and all the flow goes to its destination.
+ **
+ **  Flooded nodes and lake outlets (nodes that a flooded neighbour drains
+ **  to) also send all their flow along the flowedge set by FillLakes:
+ **  otherwise a lake node could drain to a higher node that drains back
+ **  down into the lake, and the routing would never end.
+ **
+ **  Parameters: curnode -- node to find receivers for
+ **              rcvrs -- receiving nodes (output)
+ **              wts -- weight of each receiving node (output)
+ **  Returns: sum of the weights
+ **
+ \*****************************************************************************/
+double tStreamNet::MFDReceivers( tLNode *curnode,
+                                 std::vector< tLNode * > &rcvrs,
+                                 std::vector< double > &wts )
+{
+  double totalSlopeLengthProd=0.0;
+  rcvrs.clear();
+  wts.clear();
+  tSpkIter sI( curnode );
+  bool singleFlow = ( curnode->getFloodStatus() != tLNode::kNotFlooded );
+  for( tEdge *ce = sI.FirstP(); !singleFlow && !sI.AtEnd(); ce = sI.NextP() )
+  {
+    tLNode *nbr = static_cast<tLNode*>( ce->getDestinationPtrNC() );
+    if( nbr->getFloodStatus() == tLNode::kFlooded &&
+        nbr->getBoundaryFlag() == kNonBoundary &&
+        nbr->getDownstrmNbr() == curnode )
+      singleFlow = true;  // curnode is a lake outlet
+  }
+  for( tEdge *ce = sI.FirstP(); !singleFlow && !sI.AtEnd(); ce = sI.NextP() )
+    if( ce->getSlope() > 0.0 &&
+        ce->getDestinationPtr()->getBoundaryFlag() != kClosedBoundary )
+    { // downhill to non-boundary or open boundary:
+      const double edgeSlopeLengthProd = ce->getSlope() * ce->getVEdgLen();
+      totalSlopeLengthProd += edgeSlopeLengthProd;
+      wts.push_back( edgeSlopeLengthProd );
+      rcvrs.push_back( static_cast<tLNode*>( ce->getDestinationPtrNC() ) );
+    }
+  if( rcvrs.empty() )
+  {
+    rcvrs.push_back( curnode->getDownstrmNbr() );
+    wts.push_back( 1.0 );
+    totalSlopeLengthProd = 1.0;
+  }
+  return totalSlopeLengthProd;
+}
 
 
 /*****************************************************************************\
@@ -1825,13 +1970,206 @@ void tStreamNet::RouteError( tLNode *curnode )
 }
 
 
+/*****************************************************************************\
+ **
+ **  tStreamNet::FlowReceiver
+ **
+ **  Returns the node that receives flow from _curnode_ in the donor/receiver
+ **  graph, or zero if there is none: sinks pass nothing on, and flow into a
+ **  boundary node leaves the network.
+ **
+ \*****************************************************************************/
+inline
+tLNode *tStreamNet::FlowReceiver( tLNode *curnode )
+{
+  if( curnode->getFloodStatus()==tLNode::kSink )
+    return 0;
+  tLNode *dn = curnode->getDownstrmNbr();
+  return ( dn->getBoundaryFlag() == kNonBoundary ) ? dn : 0;
+}
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::FlowLoopError
+ **
+ **  Error handler for a flow path that loops back on itself, found while
+ **  ordering the nodes. Prints the flow path from _curnode_ into the loop.
+ **
+ \*****************************************************************************/
+void tStreamNet::FlowLoopError( tLNode *curnode )
+{
+  int niterations=0;
+  for( tLNode *cn = curnode; cn != 0 && niterations<=9990;
+       cn = FlowReceiver( cn ), ++niterations )
+  {
+    cn->TellAll();
+    std::cout << std::flush;
+  }
+  ReportFatalError("Flow loop found while ordering nodes.");
+}
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::BuildFlowStack
+ **
+ **  Orders the active nodes into a "stack" in which every node comes after
+ **  the node it drains to, following Braun and Willett (2013): the donors
+ **  of each node are listed, and a depth-first search from each base-level
+ **  node (sink, or node draining to a boundary) adds the nodes upstream of
+ **  it. Traversing the stack from the top then visits every node before
+ **  its receiver, which lets drainage area and discharge be accumulated in
+ **  a single O(N) pass, and gives the order used by SortNodesByNetOrder.
+ **  Must be called again whenever flow directions change.
+ **
+ **  Node IDs are used as indices, so they need not be in list order, but
+ **  the search uses arrays sized by the largest ID.
+ **
+ **  Modifies: mFlowStack, mFlowRcvr, mFlowStackValid
+ **  Calls: FlowReceiver, FlowLoopError
+ **
+ **  Reference: Braun, J., and Willett, S.D., 2013, A very efficient O(n),
+ **    implicit and parallel method to solve the stream power equation
+ **    governing fluvial incision and landscape evolution: Geomorphology,
+ **    v. 180-181, p. 170-179.
+ **
+ \*****************************************************************************/
+void tStreamNet::BuildFlowStack()
+{
+  tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() );
+  tLNode *cn, *rn;
+  
+  int nActive = 0, maxID = -1;
+  for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+  {
+    ++nActive;
+    if( cn->getID() > maxID ) maxID = cn->getID();
+  }
+  
+  // List the donors of each node: donors of node with ID i are
+  // donors[ donorStart[i] ] to donors[ donorStart[i+1]-1 ]
+  std::vector< int > donorStart( maxID+2, 0 );
+  std::vector< tLNode * > donors( nActive );
+  for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+    if( (rn = FlowReceiver( cn )) != 0 )
+      ++donorStart[ rn->getID()+1 ];
+  for( int i=0; i<=maxID; ++i )
+    donorStart[i+1] += donorStart[i];
+  {
+    std::vector< int > nextDonor( donorStart.begin(), donorStart.end()-1 );
+    for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+      if( (rn = FlowReceiver( cn )) != 0 )
+        donors[ nextDonor[ rn->getID() ]++ ] = cn;
+  }
+  
+  // Depth-first search upstream from each base-level node
+  std::vector< int > stackPos( maxID+1, -1 );
+  std::vector< tLNode * > pending;
+  mFlowStack.clear();
+  mFlowStack.reserve( nActive );
+  mFlowRcvr.clear();
+  mFlowRcvr.reserve( nActive );
+  for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+  {
+    if( FlowReceiver( cn ) != 0 ) continue;
+    pending.push_back( cn );
+    while( !pending.empty() )
+    {
+      tLNode *dn = pending.back();
+      pending.pop_back();
+      const int id = dn->getID();
+      stackPos[id] = static_cast<int>(mFlowStack.size());
+      mFlowStack.push_back( dn );
+      rn = FlowReceiver( dn );
+      mFlowRcvr.push_back( rn != 0 ? stackPos[ rn->getID() ] : -1 );
+      for( int j=donorStart[id]; j<donorStart[id+1]; ++j )
+        pending.push_back( donors[j] );
+    }
+  }
+  
+  // Any node not reached from a base-level node is part of a loop
+  if( unlikely( static_cast<int>(mFlowStack.size()) != nActive ) )
+    for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+      if( stackPos[ cn->getID() ] < 0 )
+        FlowLoopError( cn );
+  mFlowStackValid = true;
+}
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::BuildFlowOrderMFD
+ **
+ **  Orders the active nodes from upstream to downstream for the multiple
+ **  flow direction algorithm, in which a node may drain to several
+ **  neighbours (see MFDReceivers). Uses a topological sort (Kahn, 1962):
+ **  count the upstream neighbours of each node, then repeatedly take a
+ **  node with none left uncounted and release its receivers. Must be
+ **  called whenever slopes or flow directions change.
+ **
+ **  Modifies: mFlowOrderMFD
+ **  Calls: MFDReceivers
+ **
+ \*****************************************************************************/
+void tStreamNet::BuildFlowOrderMFD()
+{
+  tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() );
+  tLNode *cn;
+  std::vector< tLNode * > rcvrs;
+  std::vector< double > wts;
+  
+  int nActive = 0, maxID = -1;
+  for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+  {
+    ++nActive;
+    if( cn->getID() > maxID ) maxID = cn->getID();
+  }
+  
+  // Count the donors of each node. Sinks pass nothing on.
+  std::vector< int > ndonors( maxID+1, 0 );
+  for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+  {
+    if( cn->getFloodStatus()==tLNode::kSink ) continue;
+    MFDReceivers( cn, rcvrs, wts );
+    for( size_t j=0; j<rcvrs.size(); ++j )
+      if( rcvrs[j]->getBoundaryFlag() == kNonBoundary )
+        ++ndonors[ rcvrs[j]->getID() ];
+  }
+  
+  // Nodes with no donors go first; each node is added once all of its
+  // donors have been
+  mFlowOrderMFD.clear();
+  mFlowOrderMFD.reserve( nActive );
+  for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+    if( ndonors[ cn->getID() ] == 0 )
+      mFlowOrderMFD.push_back( cn );
+  for( size_t i=0; i<mFlowOrderMFD.size(); ++i )
+  {
+    cn = mFlowOrderMFD[i];
+    if( cn->getFloodStatus()==tLNode::kSink ) continue;
+    MFDReceivers( cn, rcvrs, wts );
+    for( size_t j=0; j<rcvrs.size(); ++j )
+      if( rcvrs[j]->getBoundaryFlag() == kNonBoundary &&
+          --ndonors[ rcvrs[j]->getID() ] == 0 )
+        mFlowOrderMFD.push_back( rcvrs[j] );
+  }
+  
+  if( unlikely( static_cast<int>(mFlowOrderMFD.size()) != nActive ) )
+    for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
+      if( ndonors[ cn->getID() ] > 0 )
+      {
+        cn->TellAll();
+        ReportFatalError("Flow loop found while ordering nodes for MFD.");
+      }
+}
+
+
 /*****************************************************************************\
  **
  **      MakeFlow : flow routing functions
  **
  **      Data members updated:
  **      Called by:
- **      Calls: FillLakes, DrainAreaVoronoi, FlowSaturated, FlowUniform
+ **      Calls: FillLakes, BuildFlowStack, DrainAreaVoronoi, FlowSaturated,
+ **             FlowUniform
  **
  **      Created:  YC
  **      Added:   YC
@@ -1848,6 +2186,15 @@ void tStreamNet::MakeFlow( double tm )
   
   if( filllakes ) FillLakes();
   
+  // Flow directions are now final for this update: order the nodes for
+  // single-pass accumulation
+  if( optStackFlowAccum )
+  {
+    if( !mFlowStackValid ) BuildFlowStack();
+    if( optMultipleFlowDirections )
+      BuildFlowOrderMFD();
+  }
+  
   if(0) //DEBUG
   {
     tMesh< tLNode >::nodeListIter_t mli( meshPtr->getNodeList() );  // gets nodes from the list
@@ -1864,10 +2211,10 @@ void tStreamNet::MakeFlow( double tm )
     }
   }
   
-  //    if( !optMultipleFlowDirections )
-  DrainAreaVoronoi();
-  //    else
-  //      DrainAreaVoronoiMFD();
+  if( !optMultipleFlowDirections )
+    DrainAreaVoronoi();
+  else
+    DrainAreaVoronoiMFD();
   
   
   // If a hydrologic parameter varies through time, update it here
@@ -2008,6 +2355,12 @@ void tStreamNet::FlowSaturated1()
  **  depth to obtain the saturation-excess runoff depth, which is
  **  converted to a rate by multiplying by the storm duration.
  **
+ **  With OPT_STACK_FLOW_ACCUMULATION, runoff is computed at every node
+ **  first and then routed in one pass over the flow stack. The cascade
+ **  instead routes node by node, so a node's saturation deficit can see
+ **  area already routed from nodes earlier in the list; the stack version
+ **  always uses the area from DrainAreaVoronoi.
+ **
  **  Parameters:  none
  **  Called by:  main
  **  Modifies:  node discharges
@@ -2072,7 +2425,39 @@ void tStreamNet::FlowSaturated2()
     else nsr++;
     runoff = infiltExRunoff + rsat/stormDur;
     //std::cout<<" sat excess " << rsat << " total " << runoff << std::endl;
-    RouteRunoff( curnode, curnode->getVArea(), runoff*curnode->getVArea() );
+    if( !optStackFlowAccum )
+      RouteRunoff( curnode, curnode->getVArea(), runoff*curnode->getVArea() );
+    else
+      curnode->setDischarge( runoff*curnode->getVArea() );
+  }
+  
+  // Stack version of RouteRunoff: each node's runoff and Voronoi area are
+  // added to it and to every node downstream in a single pass
+  if( optStackFlowAccum )
+  {
+    const int nstack = static_cast<int>(mFlowStack.size());
+    std::vector< double > area( nstack, 0. ), discharge( nstack, 0. );
+    for( int i=0; i<nstack; ++i )
+    {
+      curnode = mFlowStack[i];
+      if( curnode->getFloodStatus()==tLNode::kSink ) continue;
+      area[i] = curnode->getVArea();
+      discharge[i] = curnode->getQ();
+    }
+    for( int i=nstack-1; i>=0; --i )
+    {
+      const int r = mFlowRcvr[i];
+      if( r>=0 && mFlowStack[r]->getFloodStatus()!=tLNode::kSink )
+      {
+        area[r] += area[i];
+        discharge[r] += discharge[i];
+      }
+    }
+    for( int i=0; i<nstack; ++i )
+    {
+      mFlowStack[i]->AddDrArea( area[i] );
+      mFlowStack[i]->setDischarge( discharge[i] );
+    }
   }
   
   if (0) //DEBUG
@@ -2152,285 +2537,248 @@ void tStreamNet::FlowBucket()
  **  Finds drainage for closed depressions. The algorithm assumes
  **  that sinks (nodes that are lower than any of their neighbors)
  **  have already been identified during the flow directions
- **  procedure. For each sink, the algorithm creates a list of
- **  nodes in the current lake, which initially is just the sink
- **  itself. It then iteratively looks for the lowest node on the
- **  perimeter of the current lake. That node is checked to see
- **  whether it can be an outlet, meaning that one of its
- **  neighbors is both lower than itself and is not already
- **  flooded (or is an open boundary). If the low node is not an
- **  outlet, it is added to the current lake and the process
- **  is repeated. If it is an outlet, then all of the nodes on the
- **  current-lake list are identified draining it. The list is then
- **  cleared, and the next sink is processed. If during the search
- **  for the lowest node on the perimeter a flooded node is found
- **  that isn't already part of the current lake (i.e., it was
- **  flagged as a lake node when a previous sink was processed),
- **  then it is simply added to the current-lake list --- in other
- **  words, the "new" lake absorbs any "old" ones that are encountered.
- **
- **  Once an outlet has been found, flow directions for nodes in the
- **  lake are resolved in order to create a contiguous path through
- **  the lake.
+ **  procedure. If there are any, the mesh is "flooded" inward from
+ **  the open boundaries with a priority queue ("priority-flood", Barnes
+ **  et al., 2014): nodes are taken from the queue lowest water level first,
+ **  and each neighbor that has not yet been reached is given a water
+ **  level equal to the higher of its own elevation and that of the
+ **  node it was reached from. A node whose water level
+ **  lies above its elevation, or which cannot drain to a neighbor
+ **  with a lower water level (see FindLakeNodeOutlet), is part of a
+ **  lake; the node from which the first node of a lake was reached is
+ **  its outlet, and the lake's water level is its spill elevation.
+ **  This gives the same lakes and outlets as the former search, which
+ **  grew a lake from each sink one lowest perimeter node at a time,
+ **  absorbing any previous lakes it met, in O(N log N) for the whole
+ **  mesh instead of one pass over the lake per node added.
+ **
+ **  Flow directions for nodes in a lake are resolved in order to
+ **  create a contiguous path through the lake to its outlet. This
+ **  isn't strictly necessary --- the nodes could all point directly
+ **  to the outlet, skipping anything in between --- but it prevents
+ **  potential problems in ordering the list by network order. Each
+ **  lake node drains to the node it was reached from: as all nodes of
+ **  a lake have the same water level, and the queue takes them first
+ **  in, first out, this amounts to a breadth-first search outward from
+ **  the outlet, so that each node's path is as short (in number of
+ **  nodes) as possible. (This replaces FillLakesFlowDirs, which did
+ **  the same by sweeping repeatedly through each lake.)
+ **
+ **  The lakes found are kept, and can be queried with getNumLakes,
+ **  getLakeIndex, getLakeSpillElev and getLakeOutlet until the next
+ **  call.
  **
  **    Calls: FindLakeNodeOutlet
  **    Called by: MakeFlow
- **    Modifies:  flow direction and flood status flag of affected nodes
+ **    Modifies:  flow direction and flood status flag of affected nodes,
+ **               mLakeIndex, mLakeSpillElev, mLakeOutlet
  **    Created: 6/97 GT
  **    Modifications:
  **     - fixed memory leak on deletion of lakenodes 8/5/97 GT
  **     - updated: 12/19/97 SL
  **     - exploded and optimized: 08/2003 AD
+ **     - per-sink lake search (BuildLakeList) replaced with a single
+ **       priority-flood sweep
+ **
+ **  Reference: Barnes, R., Lehman, C., and Mulla, D., 2014,
+ **    Priority-flood: An optimal depression-filling and watershed-labeling
+ **    algorithm for digital elevation models: Computers & Geosciences,
+ **    v. 62, p. 117-127.
  **
  \*****************************************************************************/
+// entry in the priority-flood queue; ties in water level are taken
+// first in, first out so that the result does not depend on the heap
+struct tFloodEntry
+{
+  double level;
+  int seq;
+  int id;
+  tFloodEntry( double l, int s, int i ) : level(l), seq(s), id(i) {}
+  bool operator>( const tFloodEntry &e ) const
+  { return level > e.level || ( level == e.level && seq > e.seq ); }
+};
+
 void tStreamNet::FillLakes()
 {
   if (0) //DEBUG
   {
     std::cout << "FillLakes()..." << std::endl;
   }
-  int debugcount=0; //DEBUG
-  
+
+  FlowDirsChanged();
+
   tMesh< tLNode >::nodeListIter_t nodIter( meshPtr->getNodeList() ); // node iterator
-  
-  // Check each active node to see whether it is a sink
-  for( tLNode *cn = nodIter.FirstP(); nodIter.IsActive(); cn = nodIter.NextP() )
+  tLNode *cn;
+
+  mLakeSpillElev.clear();
+  mLakeOutlet.clear();
+  int maxID = -1;
+  bool anySinks = false;
+  for( cn = nodIter.FirstP(); !( nodIter.AtEnd() ); cn = nodIter.NextP() )
+  {
+    if( cn->getID() > maxID ) maxID = cn->getID();
+    if( cn->getFloodStatus() == tLNode::kSink ) anySinks = true;
+  }
+  mLakeIndex.assign( maxID+1, -1 );
+  if( !anySinks ) return;
+
+  // The flood visits the nodes in order of water level, which jumps about
+  // in memory, so first copy what it needs into arrays indexed by node ID,
+  // going through the nodes in list order: each node's elevation, the
+  // node it drains to (-1 for sinks and boundaries), and the neighbors
+  // that flow is allowed to (spokes[] and nbr[], from spokeStart[id] up
+  // to spokeEnd[id])
+  std::vector< tLNode * > node( maxID+1, static_cast<tLNode *>(0) );
+  std::vector< double > z( maxID+1 );
+  std::vector< int > rcvr( maxID+1, -1 );
+  std::vector< int > spokeStart( maxID+1, 0 ), spokeEnd( maxID+1, 0 );
+  std::vector< tEdge * > spokes;
+  std::vector< int > nbr;
+  spokes.reserve( 6*(maxID+1) );
+  nbr.reserve( 6*(maxID+1) );
+  for( cn = nodIter.FirstP(); !( nodIter.AtEnd() ); cn = nodIter.NextP() )
   {
-    if( cn->getFloodStatus() == tLNode::kSink )
+    const int id = cn->getID();
+    node[id] = cn;
+    z[id] = cn->getZ();
+    if( cn->getBoundaryFlag() == kNonBoundary &&
+        cn->getFloodStatus() != tLNode::kSink )
+      rcvr[id] = cn->getDownstrmNbr()->getID();
+    spokeStart[id] = static_cast<int>(spokes.size());
+    if( cn->getBoundaryFlag() != kClosedBoundary )
     {
-      // Create a new lake-list, initially containing just the sink node.
-      tPtrList< tLNode > lakeList;
-      
-      // Build lakeList and iteratively search for an outlet along the
-      // perimeter of the lake
-      tLNode *lowestNode = BuildLakeList( lakeList, cn );
-      
-      
-      if(0) //DEBUG
-      {
-        debugcount++;
-        tMesh< tLNode >::nodeListIter_t mli( meshPtr->getNodeList() );  // gets nodes from the list
-        tLNode * cn;
-        for( cn=mli.FirstP(); mli.IsActive(); cn=mli.NextP() )
-        {
-          if( cn->getID()==8121 ) break;
-        }
-        tEdge * debugedg = cn->getFlowEdg();
-        tLNode * nbr = static_cast<tLNode *>(debugedg->getDestinationPtrNC());
-        std::cout<<"FillLakes 1 iter " << debugcount << ": node "<<cn->getID()<<" edge "<<debugedg->getID()<<" downstream nbr "<<nbr->getID()<<std::endl;
-        std::cout<<"z "<<cn->getZ()<<" dsn z "<<nbr->getZ() << " mdr "<<cn->Meanders()<<" nbr mdr "<<nbr->Meanders()<<std::endl;
-      }
-      
-      // Assign a flow path
-      tPtrListIter< tLNode > lakeIter( lakeList ); // Iterator for lake list
-      FillLakesFlowDirs(lakeIter, lowestNode);
-      
-      // Finally, flag all of the nodes in it as "kFlooded"
-      if(0) //DEBUG
-        std::cout<<"FillLakes: " << lakeList.getSize() << " flooded nodes:" <<std::endl;
-      for( tLNode *cln = lakeIter.FirstP(); !( lakeIter.AtEnd() ); cln = lakeIter.NextP() )
+      tEdge *ce = cn->getEdg();
+      do
       {
-        cln->setFloodStatus( tLNode::kFlooded );
-        if(0) //DEBUG
+        const tNode *dn = ce->getDestinationPtr();
+        if( dn->getBoundaryFlag() == kNonBoundary &&
+            ce->FlowAllowed() != tEdge::kFlowNotAllowed )
         {
-          std::cout<<cln->getID();
-          if( cln->Meanders() ) std::cout<<"*";
-          std::cout<<std::endl;
+          spokes.push_back( ce );
+          nbr.push_back( dn->getID() );
         }
-      }
-    } /* END if Sink */
-  } /* END Active Nodes */
-  
-  if (0) //DEBUG
-    std::cout << "FillLakes() finished" << std::endl;
-  
-} // end of tStreamNet::FillLakes
+      } while( ( ce=ce->getCCWEdg() ) != cn->getEdg() );
+    }
+    spokeEnd[id] = static_cast<int>(spokes.size());
+  }
 
+  // Water level of each node reached so far, and the node and spoke it
+  // was reached from
+  std::vector< double > level( maxID+1, std::numeric_limits<double>::max() );
+  std::vector< int > reachedFrom( maxID+1, -1 ), reachedVia( maxID+1, -1 );
+  std::priority_queue< tFloodEntry, std::vector< tFloodEntry >,
+    std::greater< tFloodEntry > > flood;
+  int seq = 0;
 
-/*****************************************************************************\
- **
- **  tStreamNet::BuildLakeList
- **
- **  Build LakeList and iteratively search for an outlet along the perimeter of
- **  the lake
- **
- **  Moved from FillLakes (AD 09/2003)
- **
- \*****************************************************************************/
-// insert a new node in lakelist
-inline
-void insertInLakeList(tPtrList< tLNode > &lakeList, tLNode *cn )
-{
-  lakeList.insertAtBack( cn );
-  cn->setFloodStatus( tLNode::kCurrentLake );
-}
+  // The open boundaries are the outlets of the mesh
+  for( cn = nodIter.FirstP(); !( nodIter.AtEnd() ); cn = nodIter.NextP() )
+    if( cn->getBoundaryFlag() == kOpenBoundary )
+    {
+      level[ cn->getID() ] = cn->getZ();
+      flood.push( tFloodEntry( cn->getZ(), seq++, cn->getID() ) );
+    }
 
-tLNode *tStreamNet::BuildLakeList( tPtrList< tLNode > &lakeList, tLNode *cn )
-{
-  tLNode *lowestNode;      // Lowest node on perimeter found so far
-  tPtrListIter< tLNode > lakeIter( lakeList ); // Iterator for lake list
-  
-  // insert the first node
-  insertInLakeList( lakeList, cn );
-  
-  bool done = false;       // Flag indicating whether outlet has been found
-  do
+  int nReached = 0;
+  while( !flood.empty() )
   {
-    lowestNode = lakeIter.FirstP();
-    double lowestElev = kVeryHigh; // Initialize lowest elev to very high val.
-    
-    // Check the neighbors of every node on the lake-list
-    for( tLNode *cln = lakeIter.FirstP(); !( lakeIter.AtEnd() );
-        cln = lakeIter.NextP() )
+    const int id = flood.top().id;
+    const double wse = flood.top().level;
+    flood.pop();
+
+    if( reachedVia[id] >= 0 )  // (not an open boundary)
     {
-      // Check all the neighbors of the node
-      tEdge *ce = cln->getEdg();
-      do
+      ++nReached;
+      cn = node[id];
+      // It's dry if it can drain to a lower water level; this is usually
+      // the node it drains to already, otherwise check all neighbors
+      bool dry = false;
+      if( z[id] >= wse )
       {
-        tLNode *thenode =
-        static_cast<tLNode *>(ce->getDestinationPtrNC());
-        switch( thenode->getFloodStatus() ){
-            // Is it a potential outlet (ie, not flooded and not
-            // a boundary)?
-          case tLNode::kNotFlooded:
-            if( ce->FlowAllowed() != tEdge::kFlowNotAllowed)
-            {
-              // Is it lower than the lowest found so far?
-              if( thenode->getZ() < lowestElev )
-              {
-                lowestNode = thenode;
-                lowestElev = thenode->getZ();
-              }
-            }
-            break;
-            // If it's a previous lake node or a sink, add it to the list
-          case tLNode::kFlooded:
-          case tLNode::kSink:
-            insertInLakeList( lakeList, thenode );
-            break;
-          default:
-            break;
+        if( rcvr[id] >= 0 && level[ rcvr[id] ] < z[id] )
+          dry = true;
+        else if( tEdge *outletEdg = FindLakeNodeOutlet( cn, level ) )
+        {
+          dry = true;
+          if( cn->getFloodStatus() == tLNode::kSink )
+          {
+            // (can only happen on a meander node held to its channel)
+            cn->setFlowEdg( outletEdg );
+            cn->setFloodStatus( tLNode::kNotFlooded );
+          }
         }
-      } while( ( ce=ce->getCCWEdg() ) != cln->getEdg() );// END spokes
-      
-      
-    } /* END lakeList */
-    
-    // Now we've found the lowest point on the perimeter. Now test
-    // to see whether it's an outlet. If it's an open boundary, it's
-    // an outlet...
-    if( lowestNode->getBoundaryFlag() == kOpenBoundary ) done = true;
-    else // ...it's also an outlet if it can drain to a "dry" location.
-    {
-      // Can lowestNode drain to a non-flooded location?
-      if( FindLakeNodeOutlet( lowestNode ) ) done = true;
-      // no, it can't, so add it to the list and continue:
-      else
-        insertInLakeList( lakeList, lowestNode );
+      }
+      if( !dry )
+      {
+        // It's flooded: it joins the lake of the node it was reached
+        // from, or if that one is dry, starts a new lake draining to it
+        const int from = reachedFrom[id];
+        int lake = mLakeIndex[from];
+        if( lake < 0 )
+        {
+          lake = static_cast<int>(mLakeOutlet.size());
+          mLakeOutlet.push_back( node[from] );
+          mLakeSpillElev.push_back( wse );
+          if( reachedVia[from] >= 0 )
+            node[from]->setFlowEdg( FindLakeNodeOutlet( node[from], level ) );
+        }
+        mLakeIndex[id] = lake;
+        cn->setFloodStatus( tLNode::kFlooded );
+        // Drain to the node it was reached from (see above)
+        cn->setFlowEdg( spokes[ reachedVia[id] ]->getComplementEdge() );
+      }
     }
-    if( unlikely(lakeList.getSize() >
-                 meshPtr->getNodeList()->getActiveSize()) )
+
+    // Add the neighbors not yet reached
+    for( int k=spokeStart[id]; k<spokeEnd[id]; ++k )
     {
-      std::cout << "LAKE LIST SIZE=" << lakeList.getSize() << "\n"
-      "active node size=" << meshPtr->getNodeList()->getActiveSize()
-      << std::endl;
-      std::cerr <<
-      "Error in Lake Filling algorithm: "
-      "Unable to find a drainage outlet.\n"
-      "This error can occur when open boundary node(s) "
-      "are isolated from the interior of the mesh.\n"
-      "This is especially common when a single outlet point "
-      "(open boundary) is used.\n"
-      "Re-check mesh configuration or try changing SEED.\n";
-      ReportFatalError( "No drainage outlet found for one or more interior nodes." );
-    }
-  } while( !done );
-  return lowestNode;
-}
+      const int nid = nbr[k];
+      if( reachedVia[nid] < 0 )
+      {
+        reachedFrom[nid] = id;
+        reachedVia[nid] = k;
+        level[nid] = std::max( z[nid], wse );
+        flood.push( tFloodEntry( level[nid], seq++, nid ) );
+      }
+    }
+  }
+
+  if( unlikely( nReached != meshPtr->getNodeList()->getActiveSize() ) )
+  {
+    std::cout << "NODES REACHED=" << nReached << "\n"
+    "active node size=" << meshPtr->getNodeList()->getActiveSize()
+    << std::endl;
+    std::cerr <<
+    "Error in Lake Filling algorithm: "
+    "Unable to find a drainage outlet.\n"
+    "This error can occur when open boundary node(s) "
+    "are isolated from the interior of the mesh.\n"
+    "This is especially common when a single outlet point "
+    "(open boundary) is used.\n"
+    "Re-check mesh configuration or try changing SEED.\n";
+    ReportFatalError( "No drainage outlet found for one or more interior nodes." );
+  }
+
+  if (0) //DEBUG
+    std::cout << "FillLakes() finished: " << mLakeOutlet.size()
+              << " lakes" << std::endl;
+
+} // end of tStreamNet::FillLakes
 
 
 /*****************************************************************************\
  **
- **  tStreamNet::FillLakesFlowDirs
+ **  tStreamNet::getLakeIndex
  **
- **  Moved from FillLakes (AD 08/2003)
- **  - AD 08/2003: Speed-up: break early from inner loop and we allow to flow
- **    to a kOutletPreFlag node.
+ **  Returns the index of the lake that a node was found to be part of
+ **  by the last call to FillLakes, or -1 if it is not in a lake. The
+ **  index can be passed to getLakeSpillElev and getLakeOutlet.
  **
  \*****************************************************************************/
-void tStreamNet::FillLakesFlowDirs(tPtrListIter< tLNode > &lakeIter,
-                                   tLNode *lowestNode) const
+int tStreamNet::getLakeIndex( const tLNode *node ) const
 {
-  // Now we've found an outlet for the current lake.
-  // This next bit of code assigns a flowsTo for each node so there's
-  // a complete flow path toward the lake's outlet. This isn't strictly
-  // necessary --- the nodes could all point directly to the outlet,
-  // skipping anything in between --- but it prevents potential problems
-  // in ordering the list by network order. This also works by pointing
-  // each node toward the first neighboring node they happen to find
-  // that has been flagged as having its flow direction resolved.
-  // Initially, the low node is thus flagged, and the algorithm repeats
-  // until all the lake nodes are flagged as having a flow direction.
-  // The algorithm isn't unique---there are many paths that could be
-  // taken; this simply finds the most convenient one.
-  lowestNode->setFloodStatus( tLNode::kOutletFlag );
-  
-  // Test for error in mesh: if the lowestNode is a closed boundary, it
-  // means no outlet can be found.
-  bool done;  // Flag indicating whether outlet has been found
-  do
-  {
-    bool newOutLetFound = false;
-    done = true;  // assume done until proven otherwise
-    tLNode *cln;  // current lake node
-    for( cln = lakeIter.FirstP(); !( lakeIter.AtEnd() );
-        cln = lakeIter.NextP() )
-    {
-      const tLNode::tFlood_t fs = cln->getFloodStatus();
-      assert( fs != tLNode::kOutletPreFlag );
-      if( fs != tLNode::kOutletFlag )
-      {
-        done = false;
-        
-        // Check each neighbor
-        // take the first node with tLNode::kOutletFlag, if not found
-        // take the first node with kOutletPreFlag
-        tEdge * const ce1 = cln->getEdg(); // first edge
-        tEdge *ce = ce1;                   // current edge
-        tEdge *cePreFlag = 0;              // edge with kOutletPreFlag
-        do
-        {
-          const tLNode::tFlood_t fsnode =
-          static_cast<tLNode const *>(ce->getDestinationPtr())
-          ->getFloodStatus();
-          if( fsnode == tLNode::kOutletFlag )
-          {     // found one!
-            newOutLetFound = true;
-            cln->setFloodStatus( tLNode::kOutletPreFlag );
-            cln->setFlowEdg( ce );
-            goto foundOutlet;
-          }
-          if( cePreFlag == 0 && fsnode == tLNode::kOutletPreFlag  )
-            cePreFlag = ce;
-        } while( ( ce=ce->getCCWEdg() ) != ce1 );
-        if ( cePreFlag != 0 )
-        {
-          newOutLetFound = true;
-          cln->setFloodStatus( tLNode::kOutletPreFlag );
-          cln->setFlowEdg( cePreFlag );
-        }
-      foundOutlet: ;	      ;
-      } // END if node not flagged as outlet
-    } // END for each lake node
-    
-    // Now flag all the "preflagged" lake nodes as outlets
-    if (newOutLetFound)
-      for( cln = lakeIter.FirstP(); !( lakeIter.AtEnd() );
-          cln = lakeIter.NextP() )
-        if( cln->getFloodStatus() == tLNode::kOutletPreFlag )
-          cln->setFloodStatus( tLNode::kOutletFlag );
-  } while( !done );
-  lowestNode->setFloodStatus( tLNode::kNotFlooded );
+  const int id = node->getID();
+  return ( id >= 0 && id < static_cast<int>(mLakeIndex.size()) ) ?
+    mLakeIndex[id] : -1;
 }
 
 
@@ -2440,10 +2788,10 @@ void tStreamNet::FillLakesFlowDirs(tPtrListIter< tLNode > &lakeIter,
  **
  **  This function is part of the lake-filling algorithm. It checks to see
  **  whether there is a valid outlet for the current node, and if so it
- **  assigns that outlet. An "outlet" essentially means a downhill neighbor
- **  that isn't already flooded to the level of the current node. The function
- **  performs basically the same operation as FlowDirs, but with stricter
- **  criteria. The criteria for a valid outlet are:
+ **  returns the edge that leads to it. An "outlet" essentially means a
+ **  downhill neighbor that isn't already flooded to the level of the current
+ **  node. The function performs basically the same operation as FlowDirs,
+ **  but with stricter criteria. The criteria for a valid outlet are:
  **
  **  (1) It must be lower than the current node (slope > 0)
  **  (2) It must not be part of the current lake (a lake can't outlet to itself)
@@ -2451,73 +2799,43 @@ void tStreamNet::FillLakesFlowDirs(tPtrListIter< tLNode > &lakeIter,
  **  (4) If the outlet is itself part of a different lake, the water surface
  **      elevation of that lake must be lower than the current node.
  **
- **  Returns: TRUE if a valid outlet is found, FALSE otherwise
- **  Calls: (none)
+ **  (2) and (4) both amount to the water level of the neighbor, as found so
+ **  far by FillLakes, being below the current node.
+ **
+ **  Returns: the steepest valid outlet edge, or 0 if there is none
+ **  Calls: FlowDirBreaksMeanderChannel
  **  Called by: FillLakes
  **  Created: 6/97 GT
  **  Updated: 12/19/97 SL; 1/15/98 gt bug fix (open boundary condition)
  **
  \*****************************************************************************/
-bool tStreamNet::FindLakeNodeOutlet( tLNode *node ) const
+tEdge *tStreamNet::FindLakeNodeOutlet( tLNode *node,
+                                       const std::vector< double > &level ) const
 {
   double maxslp = 0;  // Maximum slope found so far
-  tEdge * ce;        // Current edge
-  tLNode *dn,        // Potential outlet
-  *an;           // Node ptr used to find outlet of a previously
-                 // identified lake
-  
+  tEdge *outletEdg = 0;
+
   // Check all the neighbors
-  ce = node->getEdg();
+  tEdge *ce = node->getEdg();
   do
   {
     // If it passes this test, it's a valid outlet
-    dn = static_cast<tLNode *>(ce->getDestinationPtrNC());
+    tLNode *dn = static_cast<tLNode *>(ce->getDestinationPtrNC());
     assert( dn!=0 );
-    /*X      if( ce->getSlope() > maxslp &&
-     dn->getFloodStatus() != kCurrentLake &&
-     ce->FlowAllowed() &&
-     ( dn->getBoundaryFlag()==kOpenBoundary ||
-     dn->getDownstrmNbr()->getZ() < node->getZ() ) )*/
-#define NEWFIX 1
-#if NEWFIX
+    // The neighbor's water level must be strictly lower: if it were
+    // exactly equal to _node_'s elevation, infinite loops could result.
+    // (This fix added 4/98)
     if( ce->getSlope() > maxslp &&
-       dn->getFloodStatus() != tLNode::kCurrentLake &&
+       level[ dn->getID() ] < node->getZ() &&
        ce->FlowAllowed() && !FlowDirBreaksMeanderChannel( node, ce ) )
-#else
-      if( ce->getSlope() > maxslp &&
-         dn->getFloodStatus() != tLNode::kCurrentLake &&
-         ce->FlowAllowed() )
-#endif
-#undef NEWFIX
-      {
-        // Handle a very special and rare case: if the "target" node dn is
-        // part of a previous lake, it's still a valid exit as long as its
-        // water surface elevation is lower than the current lake (whose
-        // wse, assuming an outlet is found, would be equal to _node_'s
-        // elevation). It can sometimes happen that the target lake's wse is
-        // exactly equal in elevation to _node_, in which case
-        // the point is not considered an outlet---if it were, infinite loops
-        // could result. (This fix added 4/98)
-        if( dn->getFloodStatus() == tLNode::kFlooded )
-        {
-          // Iterate "downstream" through the "old" lake until reaching the
-          // outlet, then test its elevation. If the elevation is exactly
-          // equal to _node_, skip the rest and go on to the next iteration.
-          an = dn;
-          while( an->getFloodStatus() != tLNode::kNotFlooded )
-            an = an->getDownstrmNbr();
-          if( an->getZ()==node->getZ() ) continue;
-        }
-        
-        // Assign the new max slope and set the flow edge accordingly
-        maxslp = ce->getSlope();
-        node->setFlowEdg( ce );
-        // std::cout << "Node " << node->getID() << " flows to "
-        //      << node->getDownstrmNbr()->getID() << std::endl;
-      }
+    {
+      // Assign the new max slope and the outlet edge accordingly
+      maxslp = ce->getSlope();
+      outletEdg = ce;
+    }
   } while( ( ce=ce->getCCWEdg() ) != node->getEdg() );
-  
-  return BOOL( maxslp > 0 );
+
+  return outletEdg;
 }
 
 
@@ -2552,197 +2870,258 @@ bool tStreamNet::FlowDirBreaksMeanderChannel( tLNode * theNode, tEdge * potentia
  **
  **  SortNodesByNetOrder:
  **
- **  This function sorts the list of nodes according to their order in the
- **  network (upstream to downstream), in preparation for computing erosion &
- **  deposition. (Note that this is only necessary when the sediment output
- **  from a given node depends on the input, e.g. for mixed bedrock-alluvial
- **  mode in which case the channel type [br or alluvial] depends on the
- **  difference between sediment influx and carrying capacity). The sorting
- **  algorithm is based on the "cascade" algorithm of Braun and Sambridge
- **  (Basin Research, 1997, vol. 9, p. 27).
- **    The single-direction sorting algorithm works by initially assigning a
- **  tracer (like a packet of water) to each node. At each iteration, a tracer
- **  from each node issent downstream. Any nodes that have zero tracers left
- **  are moved to the bottom of the list (a FIFO stack), so that for example
- **  the very first node moved will be the first node on the list when the
- **  sorting is completed. The process continues until no unsorted nodes
- **  remain.
+ **  This function orders the active nodes according to their position in
+ **  the network (upstream to downstream), in preparation for computing
+ **  erosion & deposition. (Note that this is only necessary when the
+ **  sediment output from a given node depends on the input, e.g. for mixed
+ **  bedrock-alluvial mode in which case the channel type [br or alluvial]
+ **  depends on the difference between sediment influx and carrying
+ **  capacity). The node list itself is left alone: the order is stored in
+ **  mNetOrder, and is visited with a tNetOrderIter.
+ **    The single-direction order is the flow stack of BuildFlowStack, read
+ **  from the top, so that every node comes before its downstream neighbour.
+ **  Sinks come after the nodes that drain into them, but do not pass
+ **  anything on.
  **    The multi-flow option was added to allow for multiple flow directions
- **  and kinematic-wave routing. The algorithm is slightly different. At
- **  each pass, the unsorted nodes are "de-flagged" by setting their
- **  tracer variables to zero. Then each unsorted node flags _all_ of the
- **  adjacent nodes that are downhill by setting their tracer to 1 (this
- **  is accomplished through a call to ActivateSortTracer). Finally, any
- **  unflagged nodes are moved to the back of the list, and the process
- **  is repeated until all nodes have been sorted.
+ **  and kinematic-wave routing. Here a node must come before all of its
+ **  lower neighbours (across edges where flow is allowed), so the order is
+ **  found with a topological sort (Kahn, 1962) on that graph.
+ **    Both are O(N). The order is only rebuilt when flow directions have
+ **  changed (see FlowDirsChanged) or when the other kind of order is asked
+ **  for.
  **
  **  Modifications:
  **   - adapted from previous CHILD code by GT, 12/97
  **   - multiflow sort capability added 1/2000, GT
- **
- **  TODO: it is possible that the "flagging" method, as opposed to the
- **  "tracer movement" method, is more efficient even for single-flow
- **  routing. The added cost lies in unflagging the unsorted nodes at
- **  each pass. However, the gain comes from the fact that you never have
- **  multiple "tracers" at a node that need to be removed one by one.
- **  The two methods should be tested and compared.
+ **   - tracer "cascade" sort (Braun and Sambridge, 1997), which moved nodes
+ **     on the node list and took one pass per node along the longest flow
+ **     path, replaced with O(N) ordering into an index array
  **
  \*****************************************************************************/
 void tStreamNet::SortNodesByNetOrder( bool optMultiFlow )
 {
-  int nThisPass;                      // Number moved in current iteration
-  int i;
-  bool done;
-  tLNode * cn;
   tMesh< tLNode >::nodeList_t *nodeList = meshPtr->getNodeList();
-  int nUnsortedNodes = nodeList->getActiveSize();  // Number not yet sorted
-  tMesh< tLNode >::nodeListIter_t listIter( nodeList );
+  if( mNetOrderValid && mNetOrderMulti == optMultiFlow &&
+      static_cast<int>(mNetOrder.size()) == nodeList->getActiveSize() )
+    return;
   if(0) std::cout << "SortNodesByNetOrder, optMultiFlow=" << optMultiFlow << std::endl;
   
-  //test
-  /*std::cout << "BEFORE: " << std::endl;
-   for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
-   std::cout << cn->getID() << " " << cn->getZ() << " " << cn->getDrArea() << std::endl;*/
-  
-  // Iterate: move tracers downstream and sort until no nodes with tracers
-  // are left. The only difference with the multiflow option is that we
-  // call MoveTracersDownstreamMulti to send tracers down to all lower
-  // elevation nodes, not just the steepest
   if( !optMultiFlow )
   {
-    // Assign initial tracers: use "qs" field, which contains garbage at
-    // this stage.
-    int debug_int = 0;
+    if( !mFlowStackValid ) BuildFlowStack();
+    mNetOrder.assign( mFlowStack.rbegin(), mFlowStack.rend() );
+  }
+  
+  else  // For multiple flow directions (e.g., kinematic wave)
+  {
+    tMesh< tLNode >::nodeListIter_t listIter( nodeList );
+    tLNode *cn;
+    int nActive = 0, maxID = -1;
     for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
     {
-      cn->ActivateSortTracer();
-      if(0) 
-      {
-        debug_int++;
-        if( cn->getBoundaryFlag()!=kNonBoundary )
-        {
-          std::cout << "Warning: there's a boundary node in the active part of the list.\n";
-          std::cout << "The offender is:\n";
-          cn->TellAll();
-        }
-      }
+      ++nActive;
+      if( cn->getID() > maxID ) maxID = cn->getID();
     }
     
-    if(0) std::cout << "we found " << debug_int << " interior nodes; the list thinks it has " << nUnsortedNodes << " of them\n" << std::flush;
-    
-    do
+    // Count the higher neighbours of each node
+    std::vector< int > nHigher( maxID+1, 0 );
+    for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
     {
-      if(0) std::cout << "position 1\n" << std::flush;
-      
-      // Send tracers downstream
-      cn = listIter.FirstP();
-      for( i=1; i<=nUnsortedNodes; i++ )
+      tSpkIter sI( cn );
+      for( tEdge *ce = sI.FirstP(); !sI.AtEnd(); ce = sI.NextP() )
       {
-        assert( cn!=0 );
-        if(0) std::cout << "position 1a\n" << std::flush;
-        cn->MoveSortTracerDownstream();
-        if(0) std::cout << "position 1b\n" << std::flush;
-        cn = listIter.NextP();
+        tLNode *dn = static_cast<tLNode *>( ce->getDestinationPtrNC() );
+        if( dn->getZ() < cn->getZ() && ce->FlowAllowed() &&
+            dn->getBoundaryFlag() == kNonBoundary )
+          ++nHigher[ dn->getID() ];
       }
-      
-      if(0) std::cout << "position 2\n" << std::flush;
-      
-      // Scan for any nodes that have no tracers, and move them to the
-      // bottom of the list.
-      tMesh<tLNode>::nodeListNode_t  *nodeToMove;
-      nThisPass = 0;
-      done = true;
-      cn = listIter.FirstP();
-      for( i=1; i<=nUnsortedNodes; i++ )
-      {
-        if( cn->NoMoreTracers() ) // If no tracers, move node to bottom
-        {
-          nodeToMove = listIter.NodePtr();
-          cn = listIter.NextP();
-          nodeList->moveToActiveBack( nodeToMove );
-          nThisPass++;
-        }
-        else
-        {
-          cn = listIter.NextP();
-          done = false;
-        }
-      }
-      
-      nUnsortedNodes -= nThisPass;
-      
-      if(0) 
+    }
+    
+    // Start from the nodes with no higher neighbours, and add each node
+    // once all of its higher neighbours have been added
+    mNetOrder.clear();
+    mNetOrder.reserve( nActive );
+    for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
+      if( nHigher[ cn->getID() ] == 0 )
+        mNetOrder.push_back( cn );
+    for( size_t i=0; i<mNetOrder.size(); ++i )
+    {
+      cn = mNetOrder[i];
+      tSpkIter sI( cn );
+      for( tEdge *ce = sI.FirstP(); !sI.AtEnd(); ce = sI.NextP() )
       {
-        std::cout << "NO. UNSORTED: " << nUnsortedNodes << std::endl;
-        for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
-          std::cout << cn->getPermID() << " " << cn->getQ() << " " << cn->getQs()
-          << std::endl;
+        tLNode *dn = static_cast<tLNode *>( ce->getDestinationPtrNC() );
+        if( dn->getZ() < cn->getZ() && ce->FlowAllowed() &&
+            dn->getBoundaryFlag() == kNonBoundary &&
+            --nHigher[ dn->getID() ] == 0 )
+          mNetOrder.push_back( dn );
       }
-      
-    } while( !done );
+    }
+    // Elevation strictly decreases along every link, so there are no loops
+    assert( static_cast<int>(mNetOrder.size()) == nActive );
   }
   
-  else  // For multiple flow directions (e.g., kinematic wave)
-    do
-    {
-      // Reinitialize by unflagging the nodes
-      cn = listIter.FirstP();
-      for( i=1; i<=nUnsortedNodes; i++ )
-      {
-        assert( cn!=0 );
-        cn->DeactivateSortTracer();
-        cn = listIter.NextP();
-      }
-      
-      // Send tracers downstream
-      cn = listIter.FirstP();
-      for( i=1; i<=nUnsortedNodes; i++ )
-      {
-        assert( cn!=0 );
-        cn->FlagDownhillNodes();
-        cn = listIter.NextP();
-      }
-      
-      // Scan for any nodes that are unflagged, and move them to the
-      // bottom of the list.
-      tMesh<tLNode>::nodeListNode_t *nodeToMove;
-      nThisPass = 0;
-      done = true;
-      cn = listIter.FirstP();
-      for( i=1; i<=nUnsortedNodes; i++ )
-      {
-        if( cn->NoMoreTracers() )  // If no tracers, move node to bottom
-        {
-          nodeToMove = listIter.NodePtr();
-          cn = listIter.NextP();
-          nodeList->moveToActiveBack( nodeToMove );
-          nThisPass++;
-        }
-        else
-        {
-          cn = listIter.NextP();
-          done = false;
-        }
-      }
-      
-      nUnsortedNodes -= nThisPass;
-      
-      /*std::cout << "NO. UNSORTED: " << nUnsortedNodes << std::endl;
-       for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
-       std::cout << cn->getID() << " " << cn->getZ() << " " << cn->getQs()
-       << " " << cn->getDrArea() << " " << std::endl;*/
-      
-    } while( !done );
+  mNetOrderValid = true;
+  mNetOrderMulti = optMultiFlow;
+  mBasinsValid = false;
+}
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::SortNodesByBasin
+ **
+ **  Groups the nodes of the (single-direction) network order by drainage
+ **  basin, for erosion routines that treat the basins separately, e.g.,
+ **  on several threads (see tErosion::DetachErode). A node is in the same
+ **  basin as the node it drains to, so that the nodes a basin's nodes
+ **  send sediment to, or read elevations and rates from, are in the basin
+ **  too: this joins the trees of nodes that drain to the same boundary
+ **  node, and the tree of nodes draining to a sink with the tree of the
+ **  node that the sink points to. The basins are found with a union-find
+ **  on the node IDs. The nodes are then listed basin by basin in
+ **  mBasinOrder, keeping the network order within each basin: basin b
+ **  is mBasinOrder[ mBasinStart[b] ] to mBasinOrder[ mBasinStart[b+1]-1 ],
+ **  and is visited with tNetOrderIter( net, b ). The basins are numbered
+ **  in the network order of their first nodes. O(N); only redone when
+ **  the network order has changed.
+ **
+ **  Modifies: mBasinOrder, mBasinStart, mBasinsValid
+ **  Calls: SortNodesByNetOrder
+ **
+ \*****************************************************************************/
+void tStreamNet::SortNodesByBasin()
+{
+  SortNodesByNetOrder();
+  if( mBasinsValid ) return;
   
-  /*std::cout << "AFTER: " << std::endl;
-   cn = listIter.FirstP();
-   std::cout << "First node:\n";
-   cn->TellAll();
-   for( cn=listIter.FirstP(); listIter.IsActive(); cn=listIter.NextP() )
-   std::cout << cn->getID() << " " << cn->getZ() << " " << cn->getDrArea() << std::endl;
-   std::cout << "Leaving Sort\n" << flush;*/
+  tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() );
+  int maxID = -1;
+  for( tLNode *cn=ni.FirstP(); !( ni.AtEnd() ); cn=ni.NextP() )
+    if( cn->getID() > maxID ) maxID = cn->getID();
   
+  // Join each node with the node it drains to
+  std::vector< int > root( maxID+1 );
+  for( int id=0; id<=maxID; ++id )
+    root[id] = id;
+  auto FindRoot = [&root]( int id ) {
+    while( root[id] != id )
+      id = root[id] = root[ root[id] ];
+    return id;
+  };
+  const int nnodes = static_cast<int>(mNetOrder.size());
+  for( int i=0; i<nnodes; ++i )
+  {
+    const int r = FindRoot( mNetOrder[i]->getID() );
+    const int rd = FindRoot( mNetOrder[i]->getDownstrmNbr()->getID() );
+    if( r != rd ) root[r] = rd;
+  }
   
+  // Number the basins, count their nodes, and list the nodes by basin
+  std::vector< int > basinOfRoot( maxID+1, -1 );
+  std::vector< int > basin( nnodes );
+  mBasinStart.assign( 1, 0 );
+  for( int i=0; i<nnodes; ++i )
+  {
+    const int r = FindRoot( mNetOrder[i]->getID() );
+    if( basinOfRoot[r] < 0 )
+    {
+      basinOfRoot[r] = static_cast<int>(mBasinStart.size()) - 1;
+      mBasinStart.push_back( 0 );
+    }
+    basin[i] = basinOfRoot[r];
+    ++mBasinStart[ basin[i]+1 ];
+  }
+  const int nbasins = getNumBasins();
+  for( int b=0; b<nbasins; ++b )
+    mBasinStart[b+1] += mBasinStart[b];
+  std::vector< int > next( mBasinStart.begin(), mBasinStart.end()-1 );
+  mBasinOrder.resize( nnodes );
+  for( int i=0; i<nnodes; ++i )
+    mBasinOrder[ next[ basin[i] ]++ ] = mNetOrder[i];
+  mBasinsValid = true;
+}
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::FlowDirsChanged
+ **
+ **  Marks the flow stack and network order as out of date. Called by the
+ **  functions that set flow directions.
+ **
+ \*****************************************************************************/
+void tStreamNet::FlowDirsChanged()
+{
+  mFlowStackValid = false;
+  mNetOrderValid = false;
+}
+
+
+/*****************************************************************************\
+ **
+ **  tStreamNet::WriteCheckpoint, ReadCheckpoint
+ **
+ **  Save and restore the hydrologic state that varies during a run (the
+ **  rainfall rate, transmissivity, infiltration capacity and soil store)
+ **  and the inlet. The flow directions are part of the node state, which
+ **  the mesh restores first; the flow stack and network order are then
+ **  rebuilt when next needed.
+ **
+ \*****************************************************************************/
+void tStreamNet::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  std::vector< double > d(7);
+  d[0] = rainrate;
+  d[1] = trans;
+  d[2] = infilt;
+  d[3] = soilStore;
+  d[4] = inlet.inDrArea;
+  d[5] = inlet.inSedLoad;
+  d[6] = inlet.inletSlope;
+  ckp.Write( "net", d );
+  ckp.Write( "net.inlet", static_cast<long>(
+               inlet.innode != 0 ? inlet.innode->getID() : -1 ) );
+  std::vector< double > loads( inlet.inSedLoadm.getSize() );
+  for( size_t i=0; i<loads.size(); ++i )
+    loads[i] = inlet.inSedLoadm[i];
+  ckp.Write( "net.inletload", loads );
+  std::vector< double > fractions( inlet.inletSedSizeFraction.getSize() );
+  for( size_t i=0; i<fractions.size(); ++i )
+    fractions[i] = inlet.inletSedSizeFraction[i];
+  ckp.Write( "net.inletfrac", fractions );
+}
+
+void tStreamNet::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  std::vector< double > d;
+  ckp.Read( "net", d );
+  std::vector< double > loads, fractions;
+  ckp.Read( "net.inletload", loads );
+  ckp.Read( "net.inletfrac", fractions );
+  if( d.size() != 7 || loads.size() != inlet.inSedLoadm.getSize() ||
+      fractions.size() != inlet.inletSedSizeFraction.getSize() )
+    ReportFatalError( "tStreamNet: bad network state in checkpoint." );
+  rainrate = d[0];
+  trans = d[1];
+  infilt = d[2];
+  soilStore = d[3];
+  inlet.inDrArea = d[4];
+  inlet.inSedLoad = d[5];
+  inlet.inletSlope = d[6];
+  for( size_t i=0; i<loads.size(); ++i )
+    inlet.inSedLoadm[i] = loads[i];
+  for( size_t i=0; i<fractions.size(); ++i )
+    inlet.inletSedSizeFraction[i] = fractions[i];
+
+  const long id = ckp.ReadInt( "net.inlet" );
+  inlet.innode = 0;
+  if( id >= 0 )
+  {
+    tMesh< tLNode >::nodeListIter_t ni( meshPtr->getNodeList() );
+    inlet.innode = ni.GetP( id );
+    if( inlet.innode == 0 )
+      ReportFatalError( "tStreamNet: inlet node of checkpoint not found." );
+  }
+  FlowDirsChanged();
 }
 
 
@@ -2785,10 +3164,8 @@ void tStreamNet::FindHydrGeom()
 {
   
   double kwdspow, kndspow, kddspow,
-  widpow, deppow, npow, qpsec;
-  double width, depth, rough=0.0, slope;
-  tLNode *cn;
-  tMesh< tLNode >::nodeListIter_t nIter( meshPtr->getNodeList() );
+  widpow, deppow, npow;
+  const std::vector< tLNode * > &nodes = meshPtr->getActiveNodePtrs();
   
   if(0) std::cout << "tStreamNet::FindHydrGeom()\n";
   
@@ -2829,17 +3206,18 @@ void tStreamNet::FindHydrGeom()
       npow = 0.0;
     }
     
-    // Now loop over nodes, using at-a-station power law to set
-    // width, depth & roughness
-    for( cn = nIter.FirstP(); nIter.IsActive(); cn = nIter.NextP() )
-    {
+    // Now loop over nodes (in parallel, see tThreadPool.h), using
+    // at-a-station power law to set width, depth & roughness
+    tThreadPool::ParallelFor( nodes.size(), [&]( long i ) {
+      tLNode *cn = nodes[i];
       //removed an if cn->Meanders(), so stuff calculated everywhere
       //if rainfall varies, find hydraulic width "at-a-station"
       //based on the channel width "downstream":
       if( cn->getQ()>0.0 )
       {
+        double width, depth, rough, slope;
         // Convert discharge from m3/yr to m3/s
-        qpsec = cn->getQ()/SECPERYEAR;
+        const double qpsec = cn->getQ()/SECPERYEAR;
         
         // Calculate width using either a discharge power law, or the
         // Finnegan slope-discharge equation
@@ -2865,22 +3243,18 @@ void tStreamNet::FindHydrGeom()
                                //cn->setHydrDepth( depth );
         cn->setHydrSlope( slope );
       }
-    }
+    } );
   }
   //if rainfall does not vary, set hydraulic geom. = channel geom.
   else
   {
-    for( cn = nIter.FirstP(); nIter.IsActive(); cn = nIter.NextP() )
-    {
-      width = cn->getChanWidth();
-      rough = cn->getChanRough();
-      depth = cn->getChanDepth();
-      slope = cn->getChanSlope();
-      cn->setHydrWidth( width );
-      cn->setHydrRough( rough );
-      cn->setHydrSlope( slope );
-      cn->setHydrDepth( depth );
-    }
+    tThreadPool::ParallelFor( nodes.size(), [&nodes]( long i ) {
+      tLNode *cn = nodes[i];
+      cn->setHydrWidth( cn->getChanWidth() );
+      cn->setHydrRough( cn->getChanRough() );
+      cn->setHydrSlope( cn->getChanSlope() );
+      cn->setHydrDepth( cn->getChanDepth() );
+    } );
   }
   
   if (0) //DEBUG
@@ -2928,21 +3302,22 @@ void tStreamNet::FindChanGeom()
     return;
   }
   
-  double qbf,      // Bankfull discharge in m3/s
-  width,       // Channel width, m
-  depth,       // Channel depth, m
-  rough;       // Roughness
-  double slope;
-  double lambda;
-  tLNode *cn;
-  tMesh< tLNode >::nodeListIter_t nIter( meshPtr->getNodeList() );
+  const std::vector< tLNode * > &nodes = meshPtr->getActiveNodePtrs();
   
   // the following modification made by gt, 3/99, to avoid hydraulic geom
   // errors during runs w/ long storms:
   //gt3/99 if (isdmn > 0 )  qbffactor = pmn * log(1.5 / isdmn);
   
-  for( cn = nIter.FirstP(); nIter.IsActive(); cn = nIter.NextP() )
-  {
+  // the nodes are done in parallel (see tThreadPool.h); the slope of a
+  // node depends on the elevations downstream, which do not change here
+  tThreadPool::ParallelFor( nodes.size(), [&]( long i ) {
+    tLNode *cn = nodes[i];
+    double qbf,      // Bankfull discharge in m3/s
+    width,       // Channel width, m
+    depth,       // Channel depth, m
+    rough;       // Roughness
+    double slope;
+    double lambda;
     //took out an if cn->Meanders() so stuff will be calculated at all nodes
     //gt3/99 qbf = cn->getDrArea() * qbffactor;
     // Here we compute bankfull discharge and use it to compute width, depth,
@@ -3016,7 +3391,7 @@ void tStreamNet::FindChanGeom()
 #endif
       ReportFatalError("negative slope in tStreamNet::FindChanGeom");
     }
-  }
+  } );
   if (0) //DEBUG
     std::cout << "done tStreamNet::FindChanGeom" << std::endl;
 }
@@ -3106,9 +3481,10 @@ void tStreamNet::RouteFlowKinWave( double rainrate_ )
   
   // Sort nodes uphill-to-downhill
   SortNodesByNetOrder( true );
+  tNetOrderIter netIter( *this );
   
   // Route flow and compute water depths
-  for( cn=niter.FirstP(); niter.IsActive(); cn=niter.NextP() )
+  for( cn=netIter.FirstP(); netIter.IsActive(); cn=netIter.NextP() )
   {
     // Add local runoff to total incoming discharge
     if( miOptFlowgen == k2DKinematicWave )
@@ -3248,6 +3624,7 @@ void tStreamNet::FindStreamLines( const tInputFile &infile,
   // must make stream net and do flow routing first.
   // read number of streamlines:
   int numStrmLines = infile.ReadInt( "NUM_STREAMLINES", 0 );
+  if( !lvFEs ) FlowDirsChanged();
   tMesh< tLNode >::nodeListIter_t nI( meshPtr->getNodeList() );
   for( int i=0; i<numStrmLines; ++i )
   {
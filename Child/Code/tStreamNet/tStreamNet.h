@@ -261,7 +261,9 @@ public:
     void ReInitFlowDirs();
     void FlowDirs();
     void DrainAreaVoronoi();
-//   void DrainAreaVoronoiMFD();
+    void DrainAreaVoronoiMFD();
+    void BuildFlowStack();
+    void BuildFlowOrderMFD();
     void FlowPathLength();
     void RouteFlowHydrographPeak();
     void MakeFlow( double tm );
@@ -271,8 +273,19 @@ public:
     void FlowBucket();
     void RouteFlowKinWave( double );
     void FillLakes();
-    bool FindLakeNodeOutlet( tLNode * ) const;
+    tEdge *FindLakeNodeOutlet( tLNode *, const std::vector< double > & ) const;
+    int getNumLakes() const { return static_cast<int>(mLakeOutlet.size()); }
+    int getLakeIndex( const tLNode * ) const;
+    double getLakeSpillElev( int lake ) const { return mLakeSpillElev[lake]; }
+    tLNode *getLakeOutlet( int lake ) const { return mLakeOutlet[lake]; }
     void SortNodesByNetOrder( bool optMultiFlow=false );
+    const std::vector< tLNode * > &getNetOrder() const { return mNetOrder; }
+    void SortNodesByBasin();
+    int getNumBasins() const
+    { return static_cast<int>(mBasinStart.size()) - 1; }
+    const std::vector< tLNode * > &getBasinOrder() const
+    { return mBasinOrder; }
+    int getBasinStart( int basin ) const { return mBasinStart[basin]; }
     //find hydraulic and channel geometries, respectively;
     //FindHydrGeom is contingent upon current storm conditions
     //and storm variability;
@@ -284,14 +297,20 @@ public:
     void ShowMeanderNeighbours(int) const;
   // find streamlines from points specified in input file:
   void FindStreamLines( const tInputFile &, tPtrList< tLNode > &, bool lvFEs = false );
+  // save and restore the state that varies during a run (see tCheckpoint.h)
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
 
 protected:
-    tLNode *BuildLakeList( tPtrList< tLNode > &, tLNode *);
-    void FillLakesFlowDirs(tPtrListIter< tLNode > &, tLNode *) const;
     inline static void RouteFlowArea( tLNode *, double );
     inline static void RouteRunoff( tLNode *, double, double );
     static void RouteError( tLNode * ) ATTRIBUTE_NORETURN;
-//   void RouteFlowAreaMultipleDirections( tLNode*, double );
+    void RouteFlowAreaMultipleDirections( tLNode*, double );
+    inline static tLNode *FlowReceiver( tLNode * );
+    static double MFDReceivers( tLNode *, std::vector< tLNode * > &,
+                                std::vector< double > & );
+    static void FlowLoopError( tLNode * ) ATTRIBUTE_NORETURN;
+    void FlowDirsChanged();
 	bool FlowDirBreaksMeanderChannel( tLNode *, tEdge * ) const;
 
     typedef enum {
@@ -330,11 +349,59 @@ protected:
     double mdHydrgrphShapeFac;  // "Fhs" for hydrograph peak method
     double mdFlowVelocity;      // Runoff velocity for computing travel time
   bool optVariableTransmissivity; // option for soil depth-dependent transmissivity
-//   bool optMultipleFlowDirections; // option for flow routing via MFD algorithm
+  bool optMultipleFlowDirections; // option for flow routing via MFD algorithm
+  bool optStackFlowAccum; // option for single-pass (stack) flow accumulation
+  std::vector< tLNode * > mFlowStack; // active nodes, receivers before donors
+  std::vector< int > mFlowRcvr; // stack index of each node's receiver, or -1
+  std::vector< tLNode * > mFlowOrderMFD; // MFD nodes, upstream to downstream
+  std::vector< tLNode * > mNetOrder; // active nodes, upstream to downstream
+  std::vector< tEdge * > mFlowEdg; // flow edge chosen by FlowDirs, by active node
+  std::vector< char > mFlowSink;   // whether that node is a sink
+  bool mFlowStackValid; // false once flow directions have changed
+  bool mNetOrderValid;  // ditto, for mNetOrder
+  bool mNetOrderMulti;  // whether mNetOrder is the multi-flow order
+  std::vector< tLNode * > mBasinOrder; // mNetOrder, grouped by basin
+  std::vector< int > mBasinStart; // position of each basin in mBasinOrder
+  bool mBasinsValid;    // false once mNetOrder has changed
+  std::vector< int > mLakeIndex; // lake of each node (by ID) or -1
+  std::vector< double > mLakeSpillElev; // water level of each lake
+  std::vector< tLNode * > mLakeOutlet;  // node each lake drains to
 
   void DebugShowNbrs( tLNode * theNode ) const;  // debugging function shows neighbor nodes
 };
 
+/**************************************************************************/
+/**
+**  @class tNetOrderIter
+**
+**  Iterates over the active nodes in the upstream-to-downstream order set
+**  by the last call to tStreamNet::SortNodesByNetOrder, using the same
+**  FirstP/NextP/IsActive calls as a node list iterator. Given a basin
+**  number, iterates over the nodes of that basin only, in the same order
+**  (see tStreamNet::SortNodesByBasin).
+**
+*/
+/**************************************************************************/
+class tNetOrderIter
+{
+  tNetOrderIter();
+public:
+  explicit tNetOrderIter( const tStreamNet &net ) :
+    first( net.getNetOrder().empty() ? 0 : &net.getNetOrder()[0] ),
+    last( first + net.getNetOrder().size() ), pos( first ) {}
+  tNetOrderIter( const tStreamNet &net, int basin ) :
+    first( &net.getBasinOrder()[0] + net.getBasinStart( basin ) ),
+    last( &net.getBasinOrder()[0] + net.getBasinStart( basin+1 ) ),
+    pos( first ) {}
+  tLNode *FirstP() { pos = first; return IsActive() ? *pos : 0; }
+  tLNode *NextP() { ++pos; return IsActive() ? *pos : 0; }
+  bool IsActive() const { return pos < last; }
+
+private:
+  tLNode * const *first, * const *last;  // range of nodes
+  tLNode * const *pos;
+};
+
 #endif
 
 
@@ -0,0 +1,172 @@
+/**************************************************************************/
+/**
+**  @file tThreadPool.cpp
+**
+**  @brief Functions for class tThreadPool.
+**
+**  See tThreadPool.h.
+*/
+/**************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <assert.h>
+#include "tThreadPool.h"
+
+namespace
+{
+  // a loop being run
+  struct tJob
+  {
+    void (*task)( void *, long, long, long );
+    void *arg;
+    long n, grain, nchunks;
+    std::atomic< long > next;  // next chunk to be taken
+    int nworkers;              // worker threads taking part
+  };
+
+  // The worker threads and the loop they are given. The workers are
+  // never stopped at the end of the run (the pool is not deleted), so
+  // that the program can exit from any thread, e.g. on a fatal error.
+  struct tWorkers
+  {
+    std::vector< std::thread > threads;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    tJob *job;                   // loop to take part in, or 0
+    unsigned long generation;    // no. of loops given so far
+    bool quit;
+
+    tWorkers() : threads(), mutex(), wake(), done(), job(0),
+                 generation(0), quit(false) {}
+  };
+
+  tWorkers *workers = 0;
+
+  // set on the worker threads, and on a thread running a loop, so that
+  // loops started within loops run on their own thread
+  thread_local bool inLoop = false;
+
+  // takes chunks of the job until none are left
+  void RunChunks( tJob &job )
+  {
+    long c;
+    while( ( c = job.next.fetch_add( 1 ) ) < job.nchunks )
+    {
+      const long begin = c * job.grain;
+      job.task( job.arg, c, begin, std::min( begin + job.grain, job.n ) );
+    }
+  }
+
+  void WorkerThread( tWorkers *w )
+  {
+    inLoop = true;
+    unsigned long seen = 0;
+    std::unique_lock< std::mutex > lock( w->mutex );
+    for(;;)
+    {
+      while( !w->quit && ( w->job == 0 || w->generation == seen ) )
+        w->wake.wait( lock );
+      if( w->quit ) return;
+      seen = w->generation;
+      tJob *job = w->job;
+      ++job->nworkers;
+      lock.unlock();
+      RunChunks( *job );
+      lock.lock();
+      if( --job->nworkers == 0 )
+        w->done.notify_all();
+    }
+  }
+}
+
+
+/**************************************************************************\
+**
+**  tThreadPool::SetNumThreads, getNumThreads
+**
+**  SetNumThreads stops the worker threads, if any, and starts nthreads-1
+**  new ones.
+**
+\**************************************************************************/
+void tThreadPool::SetNumThreads( int nthreads )
+{
+  assert( !inLoop );
+  if( nthreads < 1 ) nthreads = 1;
+  if( nthreads == getNumThreads() ) return;
+  if( workers != 0 )
+  {
+    {
+      std::lock_guard< std::mutex > lock( workers->mutex );
+      workers->quit = true;
+    }
+    workers->wake.notify_all();
+    for( size_t t=0; t<workers->threads.size(); ++t )
+      workers->threads[t].join();
+    delete workers;
+    workers = 0;
+  }
+  if( nthreads > 1 )
+  {
+    workers = new tWorkers;
+    for( int t=1; t<nthreads; ++t )
+      workers->threads.push_back( std::thread( WorkerThread, workers ) );
+  }
+}
+
+int tThreadPool::getNumThreads()
+{
+  return workers == 0 ? 1 : static_cast< int >( workers->threads.size() ) + 1;
+}
+
+
+/**************************************************************************\
+**
+**  tThreadPool::Run
+**
+**  Runs task for each chunk of grain items of [0,n): on the calling
+**  thread only if there are no workers, a single chunk, or if called
+**  within a loop; else on the calling thread and the workers. Returns
+**  when all chunks are done and the workers have left the loop.
+**
+\**************************************************************************/
+void tThreadPool::Run( long n, long grain, tTask task, void *arg )
+{
+  if( n <= 0 ) return;
+  if( grain < 1 ) grain = 1;
+  const long nchunks = ( n + grain - 1 ) / grain;
+  if( workers == 0 || nchunks == 1 || inLoop )
+  {
+    for( long c=0; c<nchunks; ++c )
+      task( arg, c, c * grain, std::min( ( c + 1 ) * grain, n ) );
+    return;
+  }
+
+  tJob job;
+  job.task = task;
+  job.arg = arg;
+  job.n = n;
+  job.grain = grain;
+  job.nchunks = nchunks;
+  job.next = 0;
+  job.nworkers = 0;
+  {
+    std::lock_guard< std::mutex > lock( workers->mutex );
+    workers->job = &job;
+    ++workers->generation;
+  }
+  workers->wake.notify_all();
+
+  inLoop = true;
+  RunChunks( job );
+  inLoop = false;
+
+  // no more workers may join; wait for those still at work
+  std::unique_lock< std::mutex > lock( workers->mutex );
+  workers->job = 0;
+  while( job.nworkers > 0 )
+    workers->done.wait( lock );
+}
@@ -0,0 +1,137 @@
+//-*-c++-*-
+
+/**************************************************************************/
+/**
+**  @file tThreadPool.h
+**
+**  @brief Header file for class tThreadPool.
+**
+**  tThreadPool runs the loops of the process modules over the nodes,
+**  edges and triangles of the mesh on several threads. The number of
+**  threads is given by the input option NUM_THREADS (default 1, i.e.,
+**  everything runs on the model's thread); the other threads are started
+**  once and wait for work between loops.
+**
+**  A loop over n items is cut into chunks of "grain" consecutive items.
+**  The calling thread and the pool's threads take chunks from a shared
+**  counter until none are left, so that a thread that finishes early
+**  takes over work that would otherwise wait for a busy thread. The
+**  call returns when all chunks are done.
+**
+**  ParallelFor runs a body for each item; the body must only change
+**  data that belong to its item (e.g., the node's own values, or the
+**  spokes of the node). ParallelReduce combines the values of the items
+**  chunk by chunk, then the results of the chunks in chunk order. Since
+**  the chunks do not depend on the number of threads, neither do the
+**  results, which are the same (to the last bit) as those of a run on
+**  one thread.
+**
+**  The mesh keeps the pointers to its elements in arrays for these
+**  loops (tMesh::getActiveNodePtrs, getEdgePtrs, getTrianglePtrs).
+**  A loop started within another runs on the thread that started it.
+*/
+/**************************************************************************/
+
+#ifndef TTHREADPOOL_H
+#define TTHREADPOOL_H
+
+#include <vector>
+
+/**************************************************************************/
+/**
+** @class tThreadPool
+**
+** The pool of threads shared by all modules (static members only).
+**
+*/
+/**************************************************************************/
+class tThreadPool
+{
+  tThreadPool();
+public:
+  enum { kDefaultGrain = 1024 };  // items per chunk
+
+  // sets the number of threads, including the calling one (at least 1);
+  // must not be called from within a loop
+  static void SetNumThreads( int );
+  static int getNumThreads();
+
+  // calls body( i ) for i = 0..n-1
+  template< class F >
+  static void ParallelFor( long n, const F &body,
+                           long grain = kDefaultGrain );
+  // returns combine( ...combine( combine( init, v0 ), v1 )..., vn-1 ),
+  // with vi = value( i ), the values being combined chunk by chunk
+  // (starting from identity in each chunk)
+  template< class T, class F, class C >
+  static T ParallelReduce( long n, T init, T identity, const F &value,
+                           const C &combine, long grain = kDefaultGrain );
+
+private:
+  typedef void (*tTask)( void *arg, long chunk, long begin, long end );
+  // runs task for each chunk of [0,n)
+  static void Run( long n, long grain, tTask, void *arg );
+
+  template< class F >
+  static void ForChunk( void *arg, long chunk, long begin, long end );
+  template< class T, class F, class C >
+  struct tReduction
+  {
+    const F *value;
+    const C *combine;
+    T identity;
+    std::vector< T > partial;  // result of each chunk
+  };
+  template< class T, class F, class C >
+  static void ReduceChunk( void *arg, long chunk, long begin, long end );
+};
+
+
+/**************************************************************************\
+**
+**  tThreadPool::ParallelFor, ParallelReduce
+**
+\**************************************************************************/
+template< class F >
+void tThreadPool::ForChunk( void *arg, long, long begin, long end )
+{
+  const F &body = *static_cast< const F * >( arg );
+  for( long i=begin; i<end; ++i )
+    body( i );
+}
+
+template< class F >
+inline void tThreadPool::ParallelFor( long n, const F &body, long grain )
+{
+  Run( n, grain, &ForChunk< F >,
+       const_cast< void * >( static_cast< const void * >( &body ) ) );
+}
+
+template< class T, class F, class C >
+void tThreadPool::ReduceChunk( void *arg, long chunk, long begin, long end )
+{
+  tReduction< T, F, C > &r = *static_cast< tReduction< T, F, C > * >( arg );
+  T v = r.identity;
+  for( long i=begin; i<end; ++i )
+    v = (*r.combine)( v, (*r.value)( i ) );
+  r.partial[chunk] = v;
+}
+
+template< class T, class F, class C >
+T tThreadPool::ParallelReduce( long n, T init, T identity, const F &value,
+                               const C &combine, long grain )
+{
+  if( n <= 0 ) return init;
+  if( grain < 1 ) grain = 1;
+  tReduction< T, F, C > r;
+  r.value = &value;
+  r.combine = &combine;
+  r.identity = identity;
+  r.partial.assign( ( n + grain - 1 ) / grain, identity );
+  Run( n, grain, &ReduceChunk< T, F, C >, &r );
+  for( size_t c=0; c<r.partial.size(); ++c )
+    init = combine( init, r.partial[c] );
+  return init;
+}
+
+#endif
@@ -22,6 +22,8 @@
 #include "tUplift.h"
 #include "../errors/errors.h"
 #include "../Mathutil/mathutil.h"
+#include "../tCheckpoint/tCheckpoint.h"
+#include "../tThreadPool/tThreadPool.h"
 
 
 /************************************************************************\
@@ -69,7 +71,19 @@ tUplift::tUplift_t tUplift::DecodeType(int type){
 }
 
 tUplift::tUplift( const tInputFile &infile ) :
-duration(0.)
+duration(0.),
+rate(0.),
+faultPosition(0.),
+slipRate(0.),
+foldParam(0.),
+miCurUpliftMapNum(0),
+mdNextUpliftMapTime(0.),
+create_initial_bump_(false),
+mdCumulativeSlip(0.),
+mdElapsedTime(0.),
+mdFoldNose(0.),
+mdFBFElapsedTime(-1.),
+mdFBF2ElapsedTime(-1.)
 {
   int typeCode_;
   
@@ -346,7 +360,8 @@ void tUplift::DoUplift( tMesh<tLNode> *mp, double delt, double currentTime )
 **  tUplift::UpliftUniform
 **
 **  Uniform uplift at a constant rate across the entire domain (but not
-**  including boundaries).
+**  including boundaries). The nodes are done in parallel (see
+**  tThreadPool.h).
 **
 **  Inputs:  mp -- pointer to the mesh
 **           delt -- duration of uplift
@@ -355,19 +370,17 @@ void tUplift::DoUplift( tMesh<tLNode> *mp, double delt, double currentTime )
 void tUplift::UpliftUniform( tMesh<tLNode> *mp, double delt, double currentTime )
 {
    assert( mp!=0 );
-   tLNode *cn;
-   tMesh<tLNode>::nodeListIter_t ni( mp->getNodeList() );
+   const std::vector< tLNode * > &nodes = mp->getActiveNodePtrs();
    rate = rate_ts.calc( currentTime );
    const double rise = rate*delt;
 
    if (0) //DEBUG
      std::cout << "****UPLIFTUNI: " << rise << std::endl;
 
-   for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
-   {
-      cn->ChangeZ( rise );
-      cn->setUplift( rate );
-   }
+   tThreadPool::ParallelFor( nodes.size(), [&]( long i ) {
+      nodes[i]->ChangeZ( rise );
+      nodes[i]->setUplift( rate );
+   } );
 }
 
 
@@ -431,12 +444,11 @@ void tUplift::StrikeSlip( tMesh<tLNode> *mp, double delt, double currentTime )
   tMesh<tLNode>::nodeListIter_t ni( mp->getNodeList() );
   slipRate = slipRate_ts.calc( currentTime );
   double slip = slipRate*delt;
-  static double cumulative_displacement = 0;
   
-  cumulative_displacement += slip;
+  mdCumulativeSlip += slip;
   
   if(1) std::cout << "StrikeSlip by " << slip << "; cum displacement is " 
-    << cumulative_displacement << std::endl;
+    << mdCumulativeSlip << std::endl;
   
   if ( 1 )
   {
@@ -469,7 +481,7 @@ void tUplift::StrikeSlip( tMesh<tLNode> *mp, double delt, double currentTime )
     // If we're not wrapping, we'll convert any nodes "exposed to the edge" by
     // strike-slip motion to open boundaries
     if( !opt_wrap_boundaries_ 
-       && (cn->getX()+slip) > (positionParam1 + cumulative_displacement)
+       && (cn->getX()+slip) > (positionParam1 + mdCumulativeSlip)
        && cn->getY() > (faultPosition-buffer_width_) 
        && cn->getY() < (faultPosition+buffer_width_) 
        && cn->getBoundaryFlag()==kNonBoundary )
@@ -582,6 +594,7 @@ void tUplift::StrikeSlip( tMesh<tLNode> *mp, double delt, double currentTime )
         {
           mp->getNodeList()->moveToBack( cn );
           cn->setBoundaryFlag( kClosedBoundary );
+          mp->MarkForVoronoiUpdate( cn );
           // Debug
           if(1) 
           {
@@ -604,6 +617,7 @@ void tUplift::StrikeSlip( tMesh<tLNode> *mp, double delt, double currentTime )
         {
           mp->getNodeList()->moveToBack( cn );
           cn->setBoundaryFlag( kClosedBoundary );
+          mp->MarkForVoronoiUpdate( cn );
           // Debug
           if(1) 
           {
@@ -625,6 +639,7 @@ void tUplift::StrikeSlip( tMesh<tLNode> *mp, double delt, double currentTime )
         {
           mp->getNodeList()->moveToActiveBack( ni.NodePtr() );
           cn->setBoundaryFlag( kNonBoundary );
+          mp->MarkForVoronoiUpdate( cn );
           cn->setFlowEdg( cn->getEdg() );  // we need to assign a temporary (arbitrary) flow edge so tOutput doesn't crash when trying to calculate a slope
           // Debug
           if(1) 
@@ -732,7 +747,6 @@ void tUplift::CosineWarp2D( tMesh<tLNode> *mp, double delt )
    tLNode *cn;
    tMesh<tLNode>::nodeListIter_t ni( mp->getNodeList() );
    double uprate;
-   static double elapsedTime = 0;
 
    // For each node, the uplift rate is the uplift rate constant ("rate") times
    // the cosine function in the y- and (if lateral y-directed tightening has
@@ -742,7 +756,7 @@ void tUplift::CosineWarp2D( tMesh<tLNode> *mp, double delt )
    // by the parameter "foldParam2"; if uplift is positive, the rate is
    // multiplied by this factor. "positionParam1" is used to store the
    // x-location of the anticline.
-   if( elapsedTime >= deformStartTime1 )
+   if( mdElapsedTime >= deformStartTime1 )
    {
       for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
       {
@@ -763,7 +777,7 @@ void tUplift::CosineWarp2D( tMesh<tLNode> *mp, double delt )
          cn->ChangeZ( uprate*delt );
       }
    }
-   elapsedTime += delt;
+   mdElapsedTime += delt;
 
    // The "tightening" of the folds through time is simulated by
    // progressively decreasing the fold wavelength. (Here the variable
@@ -801,7 +815,7 @@ void tUplift::CosineWarp2D( tMesh<tLNode> *mp, double delt )
 **           delt -- duration of uplift
 **
 \************************************************************************/
-void tUplift::PropagatingFold( tMesh<tLNode> *mp, double delt ) const
+void tUplift::PropagatingFold( tMesh<tLNode> *mp, double delt )
 {
    assert( mp!=0 );
    tLNode *cn;
@@ -809,18 +823,17 @@ void tUplift::PropagatingFold( tMesh<tLNode> *mp, double delt ) const
    double uprate;
    const double northEdge = foldParam2 + 0.5*foldParam;
    const double southEdge = northEdge - foldParam;
-   static double foldNose = 0.0;
    const double twoPiLam = TWOPI/foldParam;
 
    // Advance the fold nose
-   foldNose += slipRate*delt;
+   mdFoldNose += slipRate*delt;
 
    // For each node, the uplift rate is the uplift rate constant ("rate") times
    // the cosine function in y. The variable "foldParam2" is the location
    // of the fold axis in meters relative to y=0.
    for( cn=ni.FirstP(); ni.IsActive(); cn=ni.NextP() )
    {
-     if( cn->getX()<=foldNose && cn->getY()<=northEdge && cn->getY()>=southEdge )
+     if( cn->getX()<=mdFoldNose && cn->getY()<=northEdge && cn->getY()>=southEdge )
        {
 	 uprate = rate2 * 0.5 * ( cos( twoPiLam*(foldParam2-cn->getY()) )+1.0);
 	 cn->ChangeZ( uprate*delt );
@@ -909,13 +922,15 @@ void tUplift::TwoSideDifferential( tMesh<tLNode> *mp, double delt ) const
 **           delt -- duration of uplift
 **
 \************************************************************************/
-void tUplift::FaultBendFold( tMesh<tLNode> *mp, double delt ) const
+void tUplift::FaultBendFold( tMesh<tLNode> *mp, double delt )
 {
    assert( mp!=0 );
    tLNode *cn;
    tMesh<tLNode>::nodeListIter_t ni( mp->getNodeList() );
    double slip = slipRate*delt;
-   static double elapsedTime = delt;
+   // (the elapsed time is set to the first time step, and kept)
+   if( mdFBFElapsedTime < 0.0 ) mdFBFElapsedTime = delt;
+   const double elapsedTime = mdFBFElapsedTime;
 
 
    for( cn=ni.FirstP(); !(ni.AtEnd()); cn=ni.NextP() )
@@ -1035,13 +1050,15 @@ void tUplift::FaultBendFold( tMesh<tLNode> *mp, double delt ) const
 **           delt -- duration of uplift
 **
 \************************************************************************/
-void tUplift::FaultBendFold2( tMesh<tLNode> *mp, double delt ) const
+void tUplift::FaultBendFold2( tMesh<tLNode> *mp, double delt )
 {
    assert( mp!=0 );
    tLNode *cn;
    tMesh<tLNode>::nodeListIter_t ni( mp->getNodeList() );
    double slip = slipRate*delt;
-   static double elapsedTime = delt;
+   // (the elapsed time starts at the first time step)
+   if( mdFBF2ElapsedTime < 0.0 ) mdFBF2ElapsedTime = delt;
+   const double elapsedTime = mdFBF2ElapsedTime;
    /* Redefinitions so faultPosition and flatDepth are measured with respect
    to where fault intersects z=0 (faultPosition) and depth below z=0. */
    //double faultPosition = faultPosition - meanElevation/tan(rampDip);
@@ -1078,7 +1095,7 @@ void tUplift::FaultBendFold2( tMesh<tLNode> *mp, double delt ) const
       }
    }
 
-   elapsedTime += delt;
+   mdFBF2ElapsedTime += delt;
 }
 
 
@@ -1570,3 +1587,55 @@ double tUplift::getRate() const
    return rate;
 }
 
+
+/************************************************************************\
+**
+**  tUplift::WriteCheckpoint, ReadCheckpoint
+**
+**  Save and restore the parameters that change during a run (rates and
+**  positions that follow time series or move with the deformation), and
+**  the progress of the time-dependent uplift types.
+**
+\************************************************************************/
+
+void tUplift::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+   std::vector<double> d(10);
+   d[0] = rate;
+   d[1] = faultPosition;
+   d[2] = slipRate;
+   d[3] = foldParam;
+   d[4] = mdNextUpliftMapTime;
+   d[5] = mdCumulativeSlip;
+   d[6] = mdElapsedTime;
+   d[7] = mdFoldNose;
+   d[8] = mdFBFElapsedTime;
+   d[9] = mdFBF2ElapsedTime;
+   ckp.Write( "uplift", d );
+   std::vector<long> i(2);
+   i[0] = miCurUpliftMapNum;
+   i[1] = create_initial_bump_;
+   ckp.Write( "uplift.i", i );
+}
+
+void tUplift::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+   std::vector<double> d;
+   std::vector<long> i;
+   ckp.Read( "uplift", d );
+   ckp.Read( "uplift.i", i );
+   if( d.size() != 10 || i.size() != 2 )
+      ReportFatalError( "tUplift: bad uplift state in checkpoint." );
+   rate = d[0];
+   faultPosition = d[1];
+   slipRate = d[2];
+   foldParam = d[3];
+   mdNextUpliftMapTime = d[4];
+   mdCumulativeSlip = d[5];
+   mdElapsedTime = d[6];
+   mdFoldNose = d[7];
+   mdFBFElapsedTime = d[8];
+   mdFBF2ElapsedTime = d[9];
+   miCurUpliftMapNum = static_cast<int>( i[0] );
+   create_initial_bump_ = i[1] != 0;
+}
@@ -49,16 +49,19 @@ public:
   void DoUplift( tMesh<tLNode> *mp, double delt, double current_time );
   double getDuration() const;
   double getRate() const;
+  // save and restore the state that varies during a run (see tCheckpoint.h)
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
 private:
   void UpliftUniform( tMesh<tLNode> *mp, double delt, double currentTime );
   void BlockUplift( tMesh<tLNode> *mp, double delt, double currentTime );
   void StrikeSlip( tMesh<tLNode> *mp, double delt, double currentTime );
   void FoldPropErf( tMesh<tLNode> *mp, double delt );
   void CosineWarp2D( tMesh<tLNode> *mp, double delt );
-  void PropagatingFold( tMesh<tLNode> *mp, double delt ) const;
+  void PropagatingFold( tMesh<tLNode> *mp, double delt );
   void TwoSideDifferential( tMesh<tLNode> *mp, double delt ) const;
-  void FaultBendFold( tMesh<tLNode> *mp, double delt ) const;
-  void FaultBendFold2( tMesh<tLNode> *mp, double delt ) const;
+  void FaultBendFold( tMesh<tLNode> *mp, double delt );
+  void FaultBendFold2( tMesh<tLNode> *mp, double delt );
   void NormalFaultTiltAccel( tMesh<tLNode> *mp, double delt, double currentTime ) const;
   void LinearUplift( tMesh<tLNode> *mp, double delt );
   void PowerLawUplift( tMesh<tLNode> *mp, double delt );
@@ -143,6 +146,11 @@ private:
   double bump_amplitude_;  // Max amplitude of Gaussian bump (m)
   double bump_wavelength_squared_; // Square of wavelength of Gaussian bump (m)
   bool create_initial_bump_;  // Option to create an initial bump in topo
+  double mdCumulativeSlip;   // Total strike-slip displacement so far
+  double mdElapsedTime;      // Time since start of 2D cosine warping
+  double mdFoldNose;         // Position of nose of propagating fold
+  double mdFBFElapsedTime;   // Elapsed times for fault-bend folds
+  double mdFBF2ElapsedTime;  //   (negative until the first time step)
   
 private:
   tUplift();
@@ -158,7 +166,11 @@ decayParam(orig.decayParam), timeParam1(orig.timeParam1), width(orig.width),
 dupdy(orig.dupdy), optincrease(orig.optincrease), miNumUpliftMaps(orig.miNumUpliftMaps), 
 mUpliftMapTimes(orig.mUpliftMapTimes), miCurUpliftMapNum(orig.miCurUpliftMapNum), 
 mdNextUpliftMapTime(orig.mdNextUpliftMapTime), 
-mdUpliftFrontGradient(orig.mdUpliftFrontGradient)
+mdUpliftFrontGradient(orig.mdUpliftFrontGradient),
+create_initial_bump_(orig.create_initial_bump_),
+mdCumulativeSlip(orig.mdCumulativeSlip), mdElapsedTime(orig.mdElapsedTime),
+mdFoldNose(orig.mdFoldNose), mdFBFElapsedTime(orig.mdFBFElapsedTime),
+mdFBF2ElapsedTime(orig.mdFBF2ElapsedTime)
 {
   strcat( mUpliftMapFilename, orig.mUpliftMapFilename );
 }
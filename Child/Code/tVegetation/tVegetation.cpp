@@ -27,6 +27,8 @@
 #include "../globalFns.h"
 #include "../tRunTimer/tRunTimer.h"
 #include "../tStorm/tStorm.h"
+#include "../tOutput/tBinaryOutput.h"
+#include "../tCheckpoint/tCheckpoint.h"
 
 /*
 **  Functions for tFire objects.
@@ -119,7 +121,7 @@ tFire::tFire( const tInputFile &infile, tRunTimer* tPtr
 	   infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
 	   strcat( fname, THEEXT );
 #undef THEEXT
-	   firefs.open( fname );
+	   tOutputFiles::Open( firefs, fname );
 	   if( !firefs.good() )
 	     std::cerr << "Warning: unable to create fire data file '"
 		       << fname << "'\n";
@@ -148,7 +150,7 @@ void tFire::TurnOnOutput( const tInputFile& infile )
      infile.ReadItem( fname, sizeof(fname)-sizeof(THEEXT), "OUTFILENAME" );
      strcat( fname, THEEXT );
 #undef THEEXT
-     firefs.open( fname );
+     tOutputFiles::Open( firefs, fname );
      if( !firefs.good() )
        std::cerr << "Warning: unable to create fire data file '"
 		 << fname << "'\n";
@@ -977,3 +979,120 @@ void tVegetation::GrowVegetation(  tMesh<class tLNode> *meshPtr,
       }
 }
 
+
+
+/**************************************************************************\
+**
+**  WriteCheckpoint, ReadCheckpoint
+**
+**  Save and restore the state of fires (time of the next fire, and the
+**  random number generator for random fires) and of the forest (the
+**  cohesion parameters, which may be changed during a run, and the
+**  random number generator for blowdown). The trees are saved with the
+**  nodes.
+**
+\**************************************************************************/
+
+void tFire::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  std::vector<double> d(3);
+  d[0] = ifrdurMean;
+  d[1] = ifrdur;
+  d[2] = time_to_burn;
+  ckp.Write( "veg.fire", d );
+  if( rand )
+    rand->WriteCheckpoint( ckp, "veg.fire.rand" );
+}
+
+void tFire::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  std::vector<double> d;
+  ckp.Read( "veg.fire", d );
+  if( d.size() != 3 )
+    ReportFatalError( "tFire: bad fire state in checkpoint." );
+  ifrdurMean = d[0];
+  ifrdur = d[1];
+  time_to_burn = d[2];
+  if( rand )
+    rand->ReadCheckpoint( ckp, "veg.fire.rand" );
+}
+
+void tForest::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  std::vector<double> d(3);
+  d[0] = MVRC;
+  d[1] = MLRC;
+  d[2] = RSPartition;
+  ckp.Write( "veg.forest", d );
+  if( rand )
+    rand->WriteCheckpoint( ckp, "veg.forest.rand" );
+}
+
+void tForest::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  std::vector<double> d;
+  ckp.Read( "veg.forest", d );
+  if( d.size() != 3 )
+    ReportFatalError( "tForest: bad forest state in checkpoint." );
+  MVRC = d[0];
+  MLRC = d[1];
+  RSPartition = d[2];
+  if( rand )
+    rand->ReadCheckpoint( ckp, "veg.forest.rand" );
+}
+
+void tVegetation::WriteCheckpoint( tCheckpointWriter &ckp ) const
+{
+  if( fire ) fire->WriteCheckpoint( ckp );
+  if( forest ) forest->WriteCheckpoint( ckp );
+}
+
+void tVegetation::ReadCheckpoint( const tCheckpointReader &ckp )
+{
+  if( fire ) fire->ReadCheckpoint( ckp );
+  if( forest ) forest->ReadCheckpoint( ckp );
+}
+
+void tVegCover::WriteState( std::vector<double> &d,
+                            std::vector<long> &l ) const
+{
+  d.push_back( mdVeg );
+  l.push_back( trees != 0 );
+  if( trees )
+    {
+      d.push_back( trees->getRootStrength() );
+      d.push_back( trees->getRootStrengthLat() );
+      d.push_back( trees->getRootStrengthVert() );
+      d.push_back( trees->getRootGrowth() );
+      d.push_back( trees->getRootDecay() );
+      d.push_back( trees->getMaxRootStrength() );
+      d.push_back( trees->getMaxHeightStand() );
+      d.push_back( trees->getMaxDiamStand() );
+      d.push_back( trees->getBioMassStand() );
+      d.push_back( trees->getMaxHeightDown() );
+      d.push_back( trees->getBioMassDown() );
+      d.push_back( trees->getStandDeathTime() );
+    }
+}
+
+void tVegCover::ReadState( const double *&d, const long *&l )
+{
+  mdVeg = *d++;
+  if( *l++ == 0 )
+    return;
+  if( trees == 0 )
+    ReportFatalError( "tVegCover: checkpoint has trees where the model has "
+		      "none." );
+  trees->setRootStrength( *d++ );
+  trees->setRootStrengthLat( *d++ );
+  trees->setRootStrengthVert( *d++ );
+  trees->setRootGrowth( *d++ );
+  trees->setRootDecay( *d++ );
+  trees->setMaxRootStrength( *d++ );
+  trees->setMaxHeightStand( *d++ );
+  trees->setMaxDiamStand( *d++ );
+  trees->setBioMassStand( *d++ );
+  trees->setMaxHeightDown( *d++ );
+  trees->setBioMassDown( *d++ );
+  trees->setStandDeathTime( *d++ );
+}
@@ -47,6 +47,7 @@
 #include "../tInputFile/tInputFile.h"
 #include "../Mathutil/mathutil.h"
 #include <iosfwd>
+#include <vector>
 //#include "../tMesh/tMesh.h"
 class tLNode;
 template<class tLNode> class tMesh;
@@ -54,6 +55,8 @@ class tVegetation;
 class tTrees;
 class tStorm;
 class tRunTimer;
+class tCheckpointWriter;
+class tCheckpointReader;
 
 class tFire
 {
@@ -69,6 +72,8 @@ public:
   void setTimePtr( tRunTimer* ptr ) {timePtr = ptr;}
   void TurnOnOutput( const tInputFile& );
   void TurnOffOutput();
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
  
 private:
   bool optRandom;   
@@ -146,6 +151,9 @@ public:
   int MaxNumBlowDown( tTrees* );
   void TreeFall( tTrees* );
 
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
+
 private:
   tMesh<tLNode> *mesh;
   tStorm *storm;
@@ -188,6 +196,10 @@ class tVegetation
    void ErodeVegetation( tMesh<class tLNode> *, double ) const;
   tFire* FirePtr() {return fire;}
   tForest* ForestPtr() {return forest;}
+  // save and restore the fire and forest state (see tCheckpoint.h); the
+  // vegetation at the nodes is saved with the mesh
+  void WriteCheckpoint( tCheckpointWriter & ) const;
+  void ReadCheckpoint( const tCheckpointReader & );
 
   private:
   bool optGrassSimple; // option for simple grass
@@ -289,6 +301,9 @@ class tVegCover
    double getVeg() const;
   tTrees* getTrees() const {return trees;}
   void setTrees( tTrees* ptr ) {trees = ptr;}
+  // append the state to / read it from checkpoint arrays (see tLNode)
+  void WriteState( std::vector<double> &, std::vector<long> & ) const;
+  void ReadState( const double *&, const long *& );
    
   private:
    double mdVeg;
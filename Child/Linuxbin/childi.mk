@@ -6,6 +6,10 @@ include gccmac.mk
 #include bcc.mk
 #include PC-lint/pclint.mk
 
+# the triangulator, the output writer and the thread pool use threads
+CFLAGS += -pthread
+LIBS += -pthread
+
 EXENAME = child$(EXEEXT)
 
 OBJECTS = \
@@ -19,8 +23,11 @@ OBJECTS = \
  predicates.$(OBJEXT) tVegetation.$(OBJEXT) tListInputData.$(OBJEXT) \
  tStratGrid.$(OBJEXT) tOption.$(OBJEXT) \
  tTimeSeries.$(OBJEXT) ParamMesh_t.$(OBJEXT) TipperTriangulator.$(OBJEXT) \
- TipperTriangulatorError.$(OBJEXT) tWaterSedTracker.$(OBJEXT) \
- tLithologyManager.$(OBJEXT)
+ TipperTriangulatorError.$(OBJEXT) tMeshArrays.$(OBJEXT) \
+ tMeshIndex.$(OBJEXT) tAsyncOutput.$(OBJEXT) tBinaryOutput.$(OBJEXT) \
+ tCheckpoint.$(OBJEXT) tThreadPool.$(OBJEXT) \
+ tWaterSedTracker.$(OBJEXT) \
+ tLithologyManager.$(OBJEXT) tSparseMatrix.$(OBJEXT)
 
 all : $(EXENAME)
 .PHONY : all clean
@@ -52,6 +59,9 @@ tListInputData.$(OBJEXT): $(PT)/tListInputData/tListInputData.cpp
 tLithologyManager.$(OBJEXT): $(PT)/tLithologyManager/tLithologyManager.cpp
 	$(CXX) $(CFLAGS) $(PT)/tLithologyManager/tLithologyManager.cpp
 
+tSparseMatrix.$(OBJEXT): $(PT)/tSparseMatrix/tSparseMatrix.cpp
+	$(CXX) $(CFLAGS) $(PT)/tSparseMatrix/tSparseMatrix.cpp
+
 tOption.$(OBJEXT): $(PT)/tOption/tOption.cpp
 	$(CXX) $(CFLAGS) $(PT)/tOption/tOption.cpp
 
@@ -85,6 +95,24 @@ tEolian.$(OBJEXT): $(PT)/tEolian/tEolian.cpp
 ParamMesh_t.$(OBJEXT): $(PT)/tMesh/ParamMesh_t.cpp
 	$(CXX) $(CFLAGS) $(PT)/tMesh/ParamMesh_t.cpp
 
+tMeshArrays.$(OBJEXT): $(PT)/tMesh/tMeshArrays.cpp
+	$(CXX) $(CFLAGS) $(PT)/tMesh/tMeshArrays.cpp
+
+tMeshIndex.$(OBJEXT): $(PT)/tMesh/tMeshIndex.cpp
+	$(CXX) $(CFLAGS) $(PT)/tMesh/tMeshIndex.cpp
+
+tAsyncOutput.$(OBJEXT): $(PT)/tOutput/tAsyncOutput.cpp
+	$(CXX) $(CFLAGS) $(PT)/tOutput/tAsyncOutput.cpp
+
+tBinaryOutput.$(OBJEXT): $(PT)/tOutput/tBinaryOutput.cpp
+	$(CXX) $(CFLAGS) $(PT)/tOutput/tBinaryOutput.cpp
+
+tCheckpoint.$(OBJEXT): $(PT)/tCheckpoint/tCheckpoint.cpp
+	$(CXX) $(CFLAGS) $(PT)/tCheckpoint/tCheckpoint.cpp
+
+tThreadPool.$(OBJEXT): $(PT)/tThreadPool/tThreadPool.cpp
+	$(CXX) $(CFLAGS) $(PT)/tThreadPool/tThreadPool.cpp
+
 TipperTriangulator.$(OBJEXT): $(PT)/tMesh/TipperTriangulator.cpp
 	$(CXX) $(CFLAGS) $(PT)/tMesh/TipperTriangulator.cpp
 
@@ -139,6 +167,7 @@ HFILES = \
 	$(PT)/tArray/tArray.cpp \
 	$(PT)/tArray/tArray.h \
 	$(PT)/tArray/tArray2.h \
+	$(PT)/tCheckpoint/tCheckpoint.h \
 	$(PT)/tEolian/tEolian.h \
 	$(PT)/tFloodplain/tFloodplain.h \
 	$(PT)/tInputFile/tInputFile.h \
@@ -153,18 +182,25 @@ HFILES = \
 	$(PT)/tMesh/heapsort.h \
 	$(PT)/tMesh/tMesh.cpp \
 	$(PT)/tMesh/tMesh.h \
+	$(PT)/tMesh/tMeshArrays.h \
+	$(PT)/tMesh/tMeshIndex.h \
 	$(PT)/tMesh/tMesh2.cpp \
 	$(PT)/tMeshList/tMeshList.h \
 	$(PT)/tOption/tOption.h \
+	$(PT)/tOutput/tAsyncOutput.h \
+	$(PT)/tOutput/tBinaryOutput.h \
 	$(PT)/tOutput/tOutput.cpp \
 	$(PT)/tOutput/tOutput.h \
+	$(PT)/tPool/tPool.h \
 	$(PT)/tPtrList/tPtrList.h \
 	$(PT)/tRunTimer/tRunTimer.h \
+	$(PT)/tSparseMatrix/tSparseMatrix.h \
 	$(PT)/tStorm/tStorm.h \
 	$(PT)/tStratGrid/tStratGrid.h \
 	$(PT)/tStreamMeander/meander.h \
 	$(PT)/tStreamMeander/tStreamMeander.h \
 	$(PT)/tStreamNet/tStreamNet.h \
+	$(PT)/tThreadPool/tThreadPool.h \
 	$(PT)/tTimeSeries/tTimeSeries.h \
 	$(PT)/tUplift/tUplift.h \
 	$(PT)/tVegetation/tVegetation.h \
@@ -174,6 +210,12 @@ HFILES = \
 ParamMesh_t.$(OBJEXT): $(HFILES)
 TipperTriangulator.$(OBJEXT) : $(HFILES)
 TipperTriangulatorError.$(OBJEXT) : $(HFILES)
+tMeshArrays.$(OBJEXT) : $(HFILES)
+tMeshIndex.$(OBJEXT) : $(HFILES)
+tAsyncOutput.$(OBJEXT) : $(HFILES)
+tBinaryOutput.$(OBJEXT) : $(HFILES)
+tCheckpoint.$(OBJEXT) : $(HFILES)
+tThreadPool.$(OBJEXT) : $(HFILES)
 childInterface.$(OBJEXT) : $(HFILES)
 childInterfaceDriver.$(OBJEXT) : $(HFILES)
 erosion.$(OBJEXT): $(HFILES)
@@ -191,6 +233,7 @@ tLNode.$(OBJEXT): $(HFILES)
 tListInputData.$(OBJEXT): $(HFILES)
 tOption.$(OBJEXT): $(HFILES)
 tRunTimer.$(OBJEXT): $(HFILES)
+tSparseMatrix.$(OBJEXT): $(HFILES)
 tStorm.$(OBJEXT) : $(HFILES)
 tStratGrid.$(OBJEXT) : $(HFILES)
 tStreamMeander.$(OBJEXT): $(HFILES)